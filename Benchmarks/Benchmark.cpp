@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include "Benchmark.hpp"
+
+static void WriteEscaped(std::ofstream& file, const std::string& text)
+{
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			file << '\\';
+		file << c;
+	}
+}
+
+static double Percentile(const std::vector<double>& sorted, double percentile)
+{
+	size_t rank = (size_t)std::ceil(percentile * sorted.size());
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+BenchmarkStatistics Benchmark::ComputeStatistics(std::vector<double> samples)
+{
+	BenchmarkStatistics statistics = {};
+	if (samples.empty())
+		return statistics;
+
+	std::sort(samples.begin(), samples.end());
+
+	statistics.Mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	statistics.Median = Percentile(samples, 0.5);
+	statistics.P99 = Percentile(samples, 0.99);
+	statistics.Min = samples.front();
+	statistics.Max = samples.back();
+
+	if (samples.size() > 1)
+	{
+		double sum = 0.0;
+		for (double sample : samples)
+			sum += (sample - statistics.Mean) * (sample - statistics.Mean);
+
+		statistics.StdDev = std::sqrt(sum / (samples.size() - 1));
+	}
+
+	return statistics;
+}
+
+double Benchmark::ToMilliseconds(sf::Uint64 begin, sf::Uint64 end)
+{
+	return (end - begin) / 1000000.0;
+}
+
+bool Benchmark::WriteJson(const std::string& filePath, const std::string& deviceName, const std::vector<BenchmarkResult>& results)
+{
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+		return false;
+
+	file.precision(6);
+	file << std::fixed;
+
+	file << "{\n\t\"device\": \"";
+	WriteEscaped(file, deviceName);
+	file << "\",\n\t\"results\": [";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		BenchmarkStatistics statistics = ComputeStatistics(result.Samples);
+
+		file << (i == 0 ? "\n" : ",\n") << "\t\t{\n\t\t\t\"name\": \"";
+		WriteEscaped(file, result.Name);
+		file << "\",\n\t\t\t\"unit\": \"";
+		WriteEscaped(file, result.Unit);
+		file << "\",\n\t\t\t\"iterations\": " << result.Samples.size()
+			<< ",\n\t\t\t\"mean\": " << statistics.Mean
+			<< ",\n\t\t\t\"p50\": " << statistics.Median
+			<< ",\n\t\t\t\"p99\": " << statistics.P99
+			<< ",\n\t\t\t\"stddev\": " << statistics.StdDev
+			<< ",\n\t\t\t\"min\": " << statistics.Min
+			<< ",\n\t\t\t\"max\": " << statistics.Max;
+
+		file << ",\n\t\t\t\"metrics\": {";
+		for (size_t j = 0; j < result.Metrics.size(); j++)
+		{
+			file << (j == 0 ? " \"" : ", \"");
+			WriteEscaped(file, result.Metrics[j].first);
+			file << "\": " << result.Metrics[j].second;
+		}
+		file << (result.Metrics.empty() ? "}" : " }");
+
+		// Raw samples so runs can be compared statistically
+		file << ",\n\t\t\t\"samples\": [";
+		for (size_t j = 0; j < result.Samples.size(); j++)
+			file << (j == 0 ? "" : ", ") << result.Samples[j];
+		file << "]\n\t\t}";
+	}
+
+	file << "\n\t]\n}\n";
+	return (bool)file;
+}
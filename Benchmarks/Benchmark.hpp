@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SFML/Config.hpp>
+
+struct BenchmarkStatistics
+{
+	double Mean = 0.0;
+	double Median = 0.0;
+	double P99 = 0.0;
+	double StdDev = 0.0;
+	double Min = 0.0;
+	double Max = 0.0;
+};
+
+struct BenchmarkResult
+{
+	std::string Name = {};
+	std::string Unit = "ms";
+	std::vector<double> Samples = {};
+
+	// Scenario specific values (throughput, bind counts, ...)
+	std::vector<std::pair<std::string, double>> Metrics = {};
+};
+
+struct BenchmarkConfig
+{
+	sf::Uint32 Iterations = 100;
+	sf::Uint32 WarmupIterations = 10;
+	sf::Uint32 Width = 1280;
+	sf::Uint32 Height = 720;
+};
+
+struct BenchmarkScenario
+{
+	std::string Name = {};
+	bool NeedsDevice = true;
+	std::function<void(const BenchmarkConfig&, std::vector<BenchmarkResult>&)> Run = {};
+};
+
+class Benchmark
+{
+public:
+	// Every scenario, defined in Scenarios.cpp
+	static const std::vector<BenchmarkScenario>& GetScenarios();
+
+	// Percentiles use the nearest rank, the deviation is the sample standard deviation
+	static BenchmarkStatistics ComputeStatistics(std::vector<double> samples);
+
+	// Milliseconds between two Profiler::GetTime() values
+	static double ToMilliseconds(sf::Uint64 begin, sf::Uint64 end);
+
+	static bool WriteJson(const std::string& filePath, const std::string& deviceName, const std::vector<BenchmarkResult>& results);
+private:
+	Benchmark();
+	Benchmark(const Benchmark&);
+};
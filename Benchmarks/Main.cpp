@@ -0,0 +1,102 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "Benchmark.hpp"
+#include "RenderingDevice.hpp"
+
+static void PrintUsage()
+{
+	std::cout << "Usage: Benchmarks [options]\n"
+		<< "  --output <file>      JSON results (default BenchmarkResults.json)\n"
+		<< "  --filter <text>      Only run scenarios whose name contains text\n"
+		<< "  --iterations <n>     Measured iterations per scenario (default 100)\n"
+		<< "  --warmup <n>         Unmeasured iterations per scenario (default 10)\n"
+		<< "  --size <w> <h>       Offscreen target size (default 1280 720)\n"
+		<< "  --list               Print scenario names\n";
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkConfig config = {};
+	std::string outputPath = "BenchmarkResults.json";
+	std::string filter = {};
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+			outputPath = argv[++i];
+		else if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+			filter = argv[++i];
+		else if (std::strcmp(argv[i], "--iterations") == 0 && hasValue)
+			config.Iterations = (sf::Uint32)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue)
+			config.WarmupIterations = (sf::Uint32)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			config.Width = (sf::Uint32)std::strtoul(argv[++i], nullptr, 10);
+			config.Height = (sf::Uint32)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--list") == 0)
+		{
+			for (const BenchmarkScenario& scenario : Benchmark::GetScenarios())
+				std::cout << scenario.Name << "\n";
+			return 0;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (config.Iterations == 0 || config.Width == 0 || config.Height == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string deviceName = "Unknown";
+	std::vector<BenchmarkResult> results = {};
+
+	// Every scenario gets a fresh headless device so they do not influence each other
+	for (const BenchmarkScenario& scenario : Benchmark::GetScenarios())
+	{
+		if (!filter.empty() && scenario.Name.find(filter) == std::string::npos)
+			continue;
+
+		std::cout << "Running " << scenario.Name << "...\n";
+
+		if (scenario.NeedsDevice)
+		{
+			if (!RenderingDevice::InitializeHeadless(sf::Vector2u(config.Width, config.Height)))
+				return 1;
+
+			deviceName = RenderingDevice::GetPhysicalDevice().getProperties().deviceName.data();
+		}
+
+		scenario.Run(config, results);
+
+		if (scenario.NeedsDevice)
+			RenderingDevice::Terminate();
+	}
+
+	std::printf("\n%-32s %10s %10s %10s %10s\n", "Scenario", "Mean", "P50", "P99", "StdDev");
+	for (const BenchmarkResult& result : results)
+	{
+		BenchmarkStatistics statistics = Benchmark::ComputeStatistics(result.Samples);
+		std::printf("%-32s %10.3f %10.3f %10.3f %10.3f %s\n", result.Name.c_str(), statistics.Mean, statistics.Median, statistics.P99, statistics.StdDev, result.Unit.c_str());
+	}
+
+	if (!Benchmark::WriteJson(outputPath, deviceName, results))
+	{
+		std::cerr << "Failed to write " << outputPath << "\n";
+		return 1;
+	}
+
+	std::cout << "\nResults written to " << outputPath << "\n";
+	return 0;
+}
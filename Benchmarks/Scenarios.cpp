@@ -0,0 +1,975 @@
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "Benchmark.hpp"
+#include "BarrierTracker.hpp"
+#include "CommandList.hpp"
+#include "DrawQueue.hpp"
+#include "GpuQueries.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+#include "RenderLayers.hpp"
+#include "RenderingDevice.hpp"
+
+static constexpr sf::Uint32 DRAW_CALLS = 10000;
+static constexpr sf::Uint32 SPRITE_INSTANCES = 100000;
+static constexpr size_t UPLOAD_SIZE = 16 * 1024 * 1024;
+static constexpr sf::Uint32 STREAMING_TEXTURE_SIZE = 1024;
+static constexpr sf::Uint32 STREAMING_BUFFERS = 2; // Matches the frames in flight, a buffer is free again once BeginFrame returns
+static constexpr sf::Uint32 PARALLEL_DRAW_CALLS = 50000;
+static constexpr std::array<sf::Uint32, 5> PARALLEL_THREAD_COUNTS = { 1, 2, 4, 8, 16 };
+static constexpr sf::Uint32 SORT_KEYS = 1000000;
+static constexpr sf::Uint32 DRAW_QUEUE_ITEMS = 20000;
+static constexpr sf::Uint32 DRAW_QUEUE_SHADERS = 8;
+static constexpr sf::Uint32 DRAW_QUEUE_VERTEX_BUFFERS = 4;
+static constexpr sf::Uint32 MAX_COLD_PIPELINE_SAMPLES = 10;
+static constexpr sf::Uint32 OVERDRAW_LAYERS = 32;
+static constexpr sf::Uint32 OVERDRAW_SHADERS = 4;
+static constexpr sf::Uint32 TRANSIENT_LAYERS = 8;
+static constexpr sf::Uint32 DAMAGE_LAYERS = 16;
+static constexpr sf::Int32 DAMAGE_RECT_SIZE = 64;
+static constexpr sf::Uint32 LAYER_DRAW_CALLS = 2000;
+
+static const char* VERTEX_SHADER_PATH = "Resources/vert.spv";
+static const char* FRAGMENT_SHADER_PATH = "Resources/frag.spv";
+
+// Runs one job per worker and waits for all of them, threads are kept alive between frames
+class WorkerPool
+{
+public:
+	WorkerPool(sf::Uint32 threadCount)
+	{
+		for (sf::Uint32 i = 0; i < threadCount; i++)
+			m_Threads.emplace_back([this, i]() { Work(i); });
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_Start.notify_all();
+
+		for (std::thread& thread : m_Threads)
+			thread.join();
+	}
+
+	void Run(const std::function<void(sf::Uint32)>& job)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Job = job;
+		m_Remaining = (sf::Uint32)m_Threads.size();
+		m_Generation++;
+		m_Start.notify_all();
+		m_Done.wait(lock, [this]() { return m_Remaining == 0; });
+	}
+private:
+	void Work(sf::Uint32 threadIndex)
+	{
+		sf::Uint64 generation = 0;
+		while (true)
+		{
+			std::function<void(sf::Uint32)> job = {};
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Start.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+				if (m_Stop)
+					return;
+
+				generation = m_Generation;
+				job = m_Job;
+			}
+
+			job(threadIndex);
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (--m_Remaining == 0)
+				m_Done.notify_one();
+		}
+	}
+private:
+	std::vector<std::thread> m_Threads = {};
+	std::mutex m_Mutex = {};
+	std::condition_variable m_Start = {};
+	std::condition_variable m_Done = {};
+	std::function<void(sf::Uint32)> m_Job = {};
+	sf::Uint64 m_Generation = 0;
+	sf::Uint32 m_Remaining = 0;
+	bool m_Stop = false;
+};
+
+// Small geometry keeps the software rasterizer from dominating the CPU-side numbers
+static std::vector<sf::Vector3f> MakeTriangle(float size)
+{
+	return {
+		sf::Vector3f(0.0f, -size, 0.0f),
+		sf::Vector3f(size,  size, 0.0f),
+		sf::Vector3f(-size, size, 0.0f)
+	};
+}
+
+static std::vector<sf::Vector3f> MakeQuad(float size, float depth = 0.0f)
+{
+	return {
+		sf::Vector3f(-size, -size, depth),
+		sf::Vector3f(size, -size, depth),
+		sf::Vector3f(size,  size, depth),
+		sf::Vector3f(-size, -size, depth),
+		sf::Vector3f(size,  size, depth),
+		sf::Vector3f(-size, size, depth)
+	};
+}
+
+static void SetFullViewport()
+{
+	vk::Extent2D extent = RenderingDevice::GetSwapchainExtent();
+	RenderingDevice::SetViewport(sf::Vector2f(0.0f, 0.0f), sf::Vector2f((float)extent.width, (float)extent.height));
+	RenderingDevice::SetScissors(sf::Vector2i(0, 0), sf::Vector2i((int)extent.width, (int)extent.height));
+}
+
+// Times whole frames: at steady state the fence wait makes this max(CPU, GPU) per frame
+static void MeasureFrames(const BenchmarkConfig& config, BenchmarkResult& result, const std::function<void()>& frame)
+{
+	for (sf::Uint32 i = 0; i < config.WarmupIterations + config.Iterations; i++)
+	{
+		sf::Uint64 begin = Profiler::GetTime();
+		frame();
+		sf::Uint64 end = Profiler::GetTime();
+
+		if (i >= config.WarmupIterations)
+			result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	RenderingDevice::GetDevice().waitIdle();
+}
+
+static double PerSecond(double count, const BenchmarkResult& result)
+{
+	double mean = Benchmark::ComputeStatistics(result.Samples).Mean;
+	return mean > 0.0 ? count / (mean / 1000.0) : 0.0;
+}
+
+static void RunDrawCalls(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	VulkanBuffer vertexBuffer = RenderingDevice::CreateVertexBuffer(MakeTriangle(0.01f));
+
+	BenchmarkResult result = {};
+	result.Name = "draw_calls";
+
+	MeasureFrames(config, result, [&]()
+	{
+		RenderingDevice::BeginRenderPass();
+		SetFullViewport();
+		RenderingDevice::BindShader(shader);
+		RenderingDevice::BindVertexBuffer(vertexBuffer);
+		for (sf::Uint32 i = 0; i < DRAW_CALLS; i++)
+			RenderingDevice::Draw(3);
+		RenderingDevice::EndRenderPass();
+		RenderingDevice::Present();
+	});
+
+	result.Metrics.push_back({ "draws_per_frame", DRAW_CALLS });
+	result.Metrics.push_back({ "draws_per_second", PerSecond(DRAW_CALLS, result) });
+	results.push_back(result);
+
+	RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	RenderingDevice::DestroyShader(shader);
+}
+
+static void RunInstancedSprites(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	VulkanBuffer vertexBuffer = RenderingDevice::CreateVertexBuffer(MakeQuad(0.01f));
+
+	BenchmarkResult result = {};
+	result.Name = "instanced_sprites";
+
+	// The pipeline has no per-instance input, so every instance covers the same quad
+	MeasureFrames(config, result, [&]()
+	{
+		RenderingDevice::BeginRenderPass();
+		SetFullViewport();
+		RenderingDevice::BindShader(shader);
+		RenderingDevice::BindVertexBuffer(vertexBuffer);
+		RenderingDevice::Draw(6, SPRITE_INSTANCES);
+		RenderingDevice::EndRenderPass();
+		RenderingDevice::Present();
+	});
+
+	result.Metrics.push_back({ "instances_per_frame", SPRITE_INSTANCES });
+	result.Metrics.push_back({ "instances_per_second", PerSecond(SPRITE_INSTANCES, result) });
+	results.push_back(result);
+
+	RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	RenderingDevice::DestroyShader(shader);
+}
+
+static void RunUploadBandwidth(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	std::vector<sf::Vector3f> vertices(UPLOAD_SIZE / sizeof(sf::Vector3f), sf::Vector3f(1.0f, 2.0f, 3.0f));
+
+	BenchmarkResult result = {};
+	result.Name = "upload_bandwidth";
+
+	// Buffer creation, mapping & copy; the destroy waits for the device and is not timed
+	for (sf::Uint32 i = 0; i < config.WarmupIterations + config.Iterations; i++)
+	{
+		sf::Uint64 begin = Profiler::GetTime();
+		VulkanBuffer vertexBuffer = RenderingDevice::CreateVertexBuffer(vertices);
+		sf::Uint64 end = Profiler::GetTime();
+
+		RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+
+		if (i >= config.WarmupIterations)
+			result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	double bytes = (double)(vertices.size() * sizeof(sf::Vector3f));
+	result.Metrics.push_back({ "bytes_per_upload", bytes });
+	result.Metrics.push_back({ "megabytes_per_second", PerSecond(bytes / 1000000.0, result) });
+	results.push_back(result);
+}
+
+// Each sample creates its own device so nothing is cached in the driver. Mesa also keeps an on-disk
+// shader cache, set MESA_SHADER_CACHE_DISABLE=true for truly cold numbers.
+static void RunPipelineCreationCold(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	BenchmarkResult result = {};
+	result.Name = "pipeline_creation_cold";
+
+	sf::Uint32 samples = std::min(config.Iterations, MAX_COLD_PIPELINE_SAMPLES);
+	for (sf::Uint32 i = 0; i < samples; i++)
+	{
+		if (!RenderingDevice::InitializeHeadless(sf::Vector2u(config.Width, config.Height)))
+			return;
+
+		sf::Uint64 begin = Profiler::GetTime();
+		VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+		sf::Uint64 end = Profiler::GetTime();
+
+		RenderingDevice::DestroyShader(shader);
+		RenderingDevice::Terminate();
+
+		result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	results.push_back(result);
+}
+
+static void RunPipelineCreationWarm(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	BenchmarkResult result = {};
+	result.Name = "pipeline_creation_warm";
+
+	// The first creation is always part of the warmup
+	for (sf::Uint32 i = 0; i < std::max(config.WarmupIterations, 1u) + config.Iterations; i++)
+	{
+		sf::Uint64 begin = Profiler::GetTime();
+		VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+		sf::Uint64 end = Profiler::GetTime();
+
+		RenderingDevice::DestroyShader(shader);
+
+		if (i >= std::max(config.WarmupIterations, 1u))
+			result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	results.push_back(result);
+}
+
+static void RunSwapchainRecreate(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	BenchmarkResult result = {};
+	result.Name = "swapchain_recreate";
+
+	// Headless this rebuilds the offscreen images, plus the render pass & framebuffers without dynamic rendering
+	for (sf::Uint32 i = 0; i < config.WarmupIterations + config.Iterations; i++)
+	{
+		sf::Uint64 begin = Profiler::GetTime();
+		RenderingDevice::RecreateSwapchain();
+		sf::Uint64 end = Profiler::GetTime();
+
+		if (i >= config.WarmupIterations)
+			result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	result.Metrics.push_back({ "dynamic_rendering", RenderingDevice::UsesDynamicRendering() ? 1.0 : 0.0 });
+	results.push_back(result);
+}
+
+static void RunTextureStreaming(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	vk::Device device = RenderingDevice::GetDevice();
+	vk::DeviceSize size = (vk::DeviceSize)STREAMING_TEXTURE_SIZE * STREAMING_TEXTURE_SIZE * 4;
+
+	// Device local texture
+	vk::ImageCreateInfo imageCreateInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, vk::Format::eR8G8B8A8Unorm, vk::Extent3D(STREAMING_TEXTURE_SIZE, STREAMING_TEXTURE_SIZE, 1), 1, 1, vk::SampleCountFlagBits::e1,
+		vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive);
+	vk::Image image = device.createImage(imageCreateInfo);
+
+	vk::MemoryRequirements imageRequirements = device.getImageMemoryRequirements(image);
+	vk::DeviceMemory imageMemory = device.allocateMemory(vk::MemoryAllocateInfo(imageRequirements.size, RenderingDevice::FindMemoryType(imageRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal)));
+	device.bindImageMemory(image, imageMemory, 0);
+	BarrierTracker::RegisterImage(image, vk::ImageAspectFlagBits::eColor);
+
+	// Persistently mapped staging buffers, one per frame in flight
+	std::array<vk::Buffer, STREAMING_BUFFERS> stagingBuffers = {};
+	std::array<vk::DeviceMemory, STREAMING_BUFFERS> stagingMemory = {};
+	std::array<void*, STREAMING_BUFFERS> stagingData = {};
+	for (sf::Uint32 i = 0; i < STREAMING_BUFFERS; i++)
+	{
+		stagingBuffers[i] = device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(), size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive));
+
+		vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(stagingBuffers[i]);
+		stagingMemory[i] = device.allocateMemory(vk::MemoryAllocateInfo(requirements.size, RenderingDevice::FindMemoryType(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)));
+		device.bindBufferMemory(stagingBuffers[i], stagingMemory[i], 0);
+		stagingData[i] = device.mapMemory(stagingMemory[i], 0, size);
+	}
+
+	std::vector<sf::Uint8> pixels((size_t)size);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (sf::Uint8)i;
+
+	BenchmarkResult result = {};
+	result.Name = "texture_streaming";
+
+	sf::Uint32 frameNumber = 0;
+	MeasureFrames(config, result, [&]()
+	{
+		RenderingDevice::BeginFrame();
+
+		sf::Uint32 index = frameNumber++ % STREAMING_BUFFERS;
+		std::memcpy(stagingData[index], pixels.data(), pixels.size());
+
+		vk::CommandBuffer commandBuffer = RenderingDevice::GetCommandBuffer();
+
+		// Whole texture is replaced, its previous contents are not needed
+		BarrierTracker::DiscardImage(image);
+		BarrierTracker::TransitionImage(image, ResourceUsage::TransferDst);
+		BarrierTracker::Flush(commandBuffer);
+
+		vk::BufferImageCopy region(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0), vk::Extent3D(STREAMING_TEXTURE_SIZE, STREAMING_TEXTURE_SIZE, 1));
+		commandBuffer.copyBufferToImage(stagingBuffers[index], image, vk::ImageLayout::eTransferDstOptimal, region);
+
+		BarrierTracker::TransitionImage(image, ResourceUsage::FragmentShaderRead);
+		BarrierTracker::Flush(commandBuffer);
+
+		RenderingDevice::BeginRenderPass();
+		RenderingDevice::EndRenderPass();
+		RenderingDevice::EndFrame();
+		RenderingDevice::Present();
+	});
+
+	result.Metrics.push_back({ "bytes_per_frame", (double)size });
+	result.Metrics.push_back({ "megabytes_per_second", PerSecond(size / 1000000.0, result) });
+	results.push_back(result);
+
+	BarrierTracker::UnregisterImage(image);
+	device.destroyImage(image);
+	device.freeMemory(imageMemory);
+
+	for (sf::Uint32 i = 0; i < STREAMING_BUFFERS; i++)
+	{
+		device.unmapMemory(stagingMemory[i]);
+		device.destroyBuffer(stagingBuffers[i]);
+		device.freeMemory(stagingMemory[i]);
+	}
+}
+
+static void RunParallelRecording(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	VulkanBuffer vertexBuffer = RenderingDevice::CreateVertexBuffer(MakeTriangle(0.01f));
+
+	for (sf::Uint32 threadCount : PARALLEL_THREAD_COUNTS)
+	{
+		RenderingDevice::SetRecordingThreadCount(threadCount);
+		WorkerPool workers(threadCount);
+
+		BenchmarkResult result = {};
+		result.Name = "parallel_recording_" + std::to_string(threadCount) + "_threads";
+
+		MeasureFrames(config, result, [&]()
+		{
+			RenderingDevice::BeginRenderPass(vk::SubpassContents::eSecondaryCommandBuffers);
+
+			workers.Run([&](sf::Uint32 threadIndex)
+			{
+				sf::Uint32 draws = PARALLEL_DRAW_CALLS / threadCount + (threadIndex == 0 ? PARALLEL_DRAW_CALLS % threadCount : 0);
+
+				RenderingDevice::BeginSecondaryCommandBuffer(threadIndex);
+				SetFullViewport();
+				RenderingDevice::BindShader(shader);
+				RenderingDevice::BindVertexBuffer(vertexBuffer);
+				for (sf::Uint32 i = 0; i < draws; i++)
+					RenderingDevice::Draw(3);
+				RenderingDevice::EndSecondaryCommandBuffer();
+			});
+
+			RenderingDevice::ExecuteSecondaryCommandBuffers();
+			RenderingDevice::EndRenderPass();
+			RenderingDevice::Present();
+		});
+
+		result.Metrics.push_back({ "threads", threadCount });
+		result.Metrics.push_back({ "draws_per_frame", PARALLEL_DRAW_CALLS });
+		result.Metrics.push_back({ "draws_per_second", PerSecond(PARALLEL_DRAW_CALLS, result) });
+		results.push_back(result);
+	}
+
+	RenderingDevice::SetRecordingThreadCount(0);
+
+	// Same draws generated into one command list per thread, replayed in order on the main thread
+	for (sf::Uint32 threadCount : PARALLEL_THREAD_COUNTS)
+	{
+		WorkerPool workers(threadCount);
+		std::vector<CommandList> lists(threadCount);
+
+		BenchmarkResult result = {};
+		result.Name = "parallel_command_lists_" + std::to_string(threadCount) + "_threads";
+
+		MeasureFrames(config, result, [&]()
+		{
+			workers.Run([&](sf::Uint32 threadIndex)
+			{
+				sf::Uint32 draws = PARALLEL_DRAW_CALLS / threadCount + (threadIndex == 0 ? PARALLEL_DRAW_CALLS % threadCount : 0);
+
+				CommandList& list = lists[threadIndex];
+				list.Clear();
+				list.BindShader(shader);
+				list.BindVertexBuffer(vertexBuffer);
+				for (sf::Uint32 i = 0; i < draws; i++)
+					list.Draw(3);
+			});
+
+			RenderingDevice::BeginRenderPass();
+			SetFullViewport();
+			for (const CommandList& list : lists)
+				list.Replay();
+			RenderingDevice::EndRenderPass();
+			RenderingDevice::Present();
+		});
+
+		size_t bytes = 0;
+		for (const CommandList& list : lists)
+			bytes += list.GetSize();
+
+		result.Metrics.push_back({ "threads", threadCount });
+		result.Metrics.push_back({ "draws_per_frame", PARALLEL_DRAW_CALLS });
+		result.Metrics.push_back({ "draws_per_second", PerSecond(PARALLEL_DRAW_CALLS, result) });
+		result.Metrics.push_back({ "command_list_bytes", (double)bytes });
+		results.push_back(result);
+	}
+
+	RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	RenderingDevice::DestroyShader(shader);
+}
+
+static std::vector<DrawSortEntry> MakeSortEntries()
+{
+	std::mt19937_64 random(1234);
+
+	std::vector<DrawSortEntry> entries(SORT_KEYS);
+	for (sf::Uint32 i = 0; i < SORT_KEYS; i++)
+	{
+		entries[i].Key = random();
+		entries[i].Index = i;
+	}
+
+	return entries;
+}
+
+static void RunRadixSort(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	const std::vector<DrawSortEntry> source = MakeSortEntries();
+	std::vector<DrawSortEntry> entries = {};
+	std::vector<DrawSortEntry> scratch = {};
+
+	BenchmarkResult result = {};
+	result.Name = "radix_sort_1m";
+
+	for (sf::Uint32 i = 0; i < config.WarmupIterations + config.Iterations; i++)
+	{
+		entries = source;
+
+		sf::Uint64 begin = Profiler::GetTime();
+		DrawQueue::Sort(entries, scratch);
+		sf::Uint64 end = Profiler::GetTime();
+
+		if (i >= config.WarmupIterations)
+			result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	result.Metrics.push_back({ "keys", SORT_KEYS });
+	results.push_back(result);
+}
+
+static void RunStdStableSort(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	const std::vector<DrawSortEntry> source = MakeSortEntries();
+	std::vector<DrawSortEntry> entries = {};
+
+	BenchmarkResult result = {};
+	result.Name = "std_stable_sort_1m";
+
+	for (sf::Uint32 i = 0; i < config.WarmupIterations + config.Iterations; i++)
+	{
+		entries = source;
+
+		sf::Uint64 begin = Profiler::GetTime();
+		std::stable_sort(entries.begin(), entries.end(), [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.Key < b.Key; });
+		sf::Uint64 end = Profiler::GetTime();
+
+		if (i >= config.WarmupIterations)
+			result.Samples.push_back(Benchmark::ToMilliseconds(begin, end));
+	}
+
+	result.Metrics.push_back({ "keys", SORT_KEYS });
+	results.push_back(result);
+}
+
+static void RunDrawQueueBinds(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	std::vector<VulkanShader> shaders = {};
+	for (sf::Uint32 i = 0; i < DRAW_QUEUE_SHADERS; i++)
+		shaders.push_back(RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH));
+
+	std::vector<VulkanBuffer> vertexBuffers = {};
+	for (sf::Uint32 i = 0; i < DRAW_QUEUE_VERTEX_BUFFERS; i++)
+		vertexBuffers.push_back(RenderingDevice::CreateVertexBuffer(MakeTriangle(0.01f)));
+
+	// Random state per item, submitted in the same order every frame
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+	std::vector<DrawItem> items(DRAW_QUEUE_ITEMS);
+	for (DrawItem& item : items)
+	{
+		item.Shader = &shaders[random() % DRAW_QUEUE_SHADERS];
+		item.VertexBuffer = &vertexBuffers[random() % DRAW_QUEUE_VERTEX_BUFFERS];
+		item.Count = 3;
+		item.Depth = depth(random);
+	}
+
+	// What binding in submission order would have cost
+	sf::Uint32 unsortedPipelineBinds = 0;
+	sf::Uint32 unsortedVertexBufferBinds = 0;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		unsortedPipelineBinds += i == 0 || items[i].Shader != items[i - 1].Shader;
+		unsortedVertexBufferBinds += i == 0 || items[i].VertexBuffer != items[i - 1].VertexBuffer;
+	}
+
+	DrawQueue queue = {};
+
+	BenchmarkResult result = {};
+	result.Name = "draw_queue_binds";
+
+	MeasureFrames(config, result, [&]()
+	{
+		RenderingDevice::BeginRenderPass();
+		SetFullViewport();
+		for (const DrawItem& item : items)
+			queue.Submit(item);
+		queue.Flush();
+		RenderingDevice::EndRenderPass();
+		RenderingDevice::Present();
+	});
+
+	result.Metrics.push_back({ "draws_per_frame", DRAW_QUEUE_ITEMS });
+	result.Metrics.push_back({ "unsorted_pipeline_binds", unsortedPipelineBinds });
+	result.Metrics.push_back({ "unsorted_vertex_buffer_binds", unsortedVertexBufferBinds });
+	result.Metrics.push_back({ "sorted_pipeline_binds", queue.GetStats().PipelineBinds });
+	result.Metrics.push_back({ "sorted_vertex_buffer_binds", queue.GetStats().VertexBufferBinds });
+	results.push_back(result);
+
+	for (VulkanBuffer& vertexBuffer : vertexBuffers)
+		RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	for (VulkanShader& shader : shaders)
+		RenderingDevice::DestroyShader(shader);
+}
+
+static sf::Uint64 GetFragmentInvocations(const char* name)
+{
+	for (const PipelineStatisticsResult& statistics : GpuQueries::GetStatisticsResults())
+	{
+		if (statistics.Name == name)
+			return statistics.Statistics.FragmentShaderInvocations;
+	}
+
+	return 0;
+}
+
+static void RunDepthOverdraw(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	// Pipelines are built against the render pass, so depth has to be on before creating them
+	RenderingDevice::SetDepthBufferEnabled(true);
+
+	std::vector<VulkanShader> shaders = {};
+	for (sf::Uint32 i = 0; i < OVERDRAW_SHADERS; i++)
+		shaders.push_back(RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH));
+
+	// Full screen quads, submitted back to front like a painter's algorithm would
+	std::vector<VulkanBuffer> vertexBuffers = {};
+	std::vector<DrawItem> items = {};
+	vertexBuffers.reserve(OVERDRAW_LAYERS);
+	for (sf::Uint32 i = 0; i < OVERDRAW_LAYERS; i++)
+	{
+		sf::Uint32 layer = OVERDRAW_LAYERS - 1 - i;
+		float depth = (float)(layer + 1) / (OVERDRAW_LAYERS + 1);
+		vertexBuffers.push_back(RenderingDevice::CreateVertexBuffer(MakeQuad(1.0f, depth)));
+
+		DrawItem item = {};
+		item.Shader = &shaders[layer % OVERDRAW_SHADERS];
+		item.VertexBuffer = &vertexBuffers.back();
+		item.Count = 6;
+		item.Depth = depth;
+		items.push_back(item);
+	}
+
+	struct OverdrawVariant
+	{
+		const char* Name = nullptr;
+		bool Sorted = false;
+		DrawSortMode SortMode = DrawSortMode::StateFirst;
+	};
+
+	const std::array<OverdrawVariant, 3> variants = { {
+		{ "depth_overdraw_unsorted", false, DrawSortMode::StateFirst },
+		{ "depth_overdraw_state_first", true, DrawSortMode::StateFirst },
+		{ "depth_overdraw_depth_first", true, DrawSortMode::DepthFirst }
+	} };
+
+	DrawQueue queue = {};
+	sf::Uint64 unsortedInvocations = 0;
+
+	for (const OverdrawVariant& variant : variants)
+	{
+		queue.SetSortMode(variant.SortMode);
+
+		BenchmarkResult result = {};
+		result.Name = variant.Name;
+
+		MeasureFrames(config, result, [&]()
+		{
+			RenderingDevice::BeginRenderPass();
+			SetFullViewport();
+			{
+				GPU_STATISTICS_SCOPE(variant.Name);
+				for (const DrawItem& item : items)
+				{
+					if (variant.Sorted)
+					{
+						queue.Submit(item);
+						continue;
+					}
+
+					RenderingDevice::BindShader(*item.Shader);
+					RenderingDevice::BindVertexBuffer(*item.VertexBuffer);
+					RenderingDevice::Draw(item.Count);
+				}
+				queue.Flush();
+			}
+			RenderingDevice::EndRenderPass();
+			RenderingDevice::Present();
+		});
+
+		// Results of the last frames measured are the latest available
+		sf::Uint64 invocations = GetFragmentInvocations(variant.Name);
+		if (!variant.Sorted)
+			unsortedInvocations = invocations;
+
+		result.Metrics.push_back({ "draws_per_frame", OVERDRAW_LAYERS });
+		result.Metrics.push_back({ "pipeline_binds", variant.Sorted ? queue.GetStats().PipelineBinds : OVERDRAW_LAYERS });
+		if (GpuQueries::IsPipelineStatisticsSupported())
+		{
+			result.Metrics.push_back({ "fragment_invocations", (double)invocations });
+			result.Metrics.push_back({ "fragment_reduction", unsortedInvocations > 0 ? 1.0 - (double)invocations / unsortedInvocations : 0.0 });
+		}
+		results.push_back(result);
+	}
+
+	for (VulkanBuffer& vertexBuffer : vertexBuffers)
+		RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	for (VulkanShader& shader : shaders)
+		RenderingDevice::DestroyShader(shader);
+
+	RenderingDevice::SetDepthBufferEnabled(false);
+}
+
+static void RunTransientAttachments(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	// Depth & 4x MSAA, both transient: on tile based GPUs neither should ever be committed to memory
+	RenderingDevice::SetDepthBufferEnabled(true);
+	vk::SampleCountFlagBits sampleCount = RenderingDevice::SetSampleCount(vk::SampleCountFlagBits::e4);
+
+	VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+
+	std::vector<VulkanBuffer> vertexBuffers = {};
+	for (sf::Uint32 i = 0; i < TRANSIENT_LAYERS; i++)
+		vertexBuffers.push_back(RenderingDevice::CreateVertexBuffer(MakeQuad(1.0f, (float)(i + 1) / (TRANSIENT_LAYERS + 1))));
+
+	// The resolve overwrites the whole target, so the multisampled attachment does not need a clear either
+	RenderPassDesc desc = {};
+	desc.ColorLoadOp = vk::AttachmentLoadOp::eDontCare;
+
+	BenchmarkResult result = {};
+	result.Name = "transient_attachments";
+
+	MeasureFrames(config, result, [&]()
+	{
+		RenderingDevice::BeginRenderPass(desc);
+		SetFullViewport();
+		RenderingDevice::BindShader(shader);
+		for (VulkanBuffer& vertexBuffer : vertexBuffers)
+		{
+			RenderingDevice::BindVertexBuffer(vertexBuffer);
+			RenderingDevice::Draw(6);
+		}
+		RenderingDevice::EndRenderPass();
+		RenderingDevice::Present();
+	});
+
+	TransientAttachmentStats stats = RenderingDevice::GetTransientAttachmentStats();
+	result.Metrics.push_back({ "sample_count", (double)sampleCount });
+	result.Metrics.push_back({ "lazily_allocated", stats.LazilyAllocated ? 1.0 : 0.0 });
+	result.Metrics.push_back({ "transient_allocated_bytes", (double)stats.Allocated });
+	result.Metrics.push_back({ "transient_committed_bytes", (double)stats.Committed });
+	results.push_back(result);
+
+	for (VulkanBuffer& vertexBuffer : vertexBuffers)
+		RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	RenderingDevice::DestroyShader(shader);
+
+	RenderingDevice::SetSampleCount(vk::SampleCountFlagBits::e1);
+	RenderingDevice::SetDepthBufferEnabled(false);
+}
+
+static void RunDamageTracking(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+
+	std::vector<VulkanBuffer> vertexBuffers = {};
+	for (sf::Uint32 i = 0; i < DAMAGE_LAYERS; i++)
+		vertexBuffers.push_back(RenderingDevice::CreateVertexBuffer(MakeQuad(1.0f)));
+
+	// A small rect moving over an otherwise static image, like a blinking cursor or a ticking counter
+	for (bool damageTracking : { false, true })
+	{
+		RenderingDevice::SetDamageTrackingEnabled(damageTracking);
+
+		BenchmarkResult result = {};
+		result.Name = damageTracking ? "damage_incremental" : "damage_full_redraw";
+
+		vk::Extent2D extent = RenderingDevice::GetSwapchainExtent();
+		sf::Uint32 range = extent.width > (sf::Uint32)DAMAGE_RECT_SIZE ? extent.width - DAMAGE_RECT_SIZE : 1;
+		sf::Uint32 frame = 0;
+		double damageFraction = 0.0;
+
+		MeasureFrames(config, result, [&]()
+		{
+			sf::Int32 x = (sf::Int32)((frame++ * DAMAGE_RECT_SIZE) % range);
+			RenderingDevice::AddDamage(sf::Vector2i(x, 0), sf::Vector2i(DAMAGE_RECT_SIZE, DAMAGE_RECT_SIZE));
+
+			RenderingDevice::BeginRenderPass();
+			SetFullViewport();
+			RenderingDevice::BindShader(shader);
+			for (VulkanBuffer& vertexBuffer : vertexBuffers)
+			{
+				RenderingDevice::BindVertexBuffer(vertexBuffer);
+				RenderingDevice::Draw(6);
+			}
+
+			vk::Rect2D area = RenderingDevice::GetDamageArea();
+			damageFraction += (double)area.extent.width * area.extent.height / ((double)extent.width * extent.height);
+
+			RenderingDevice::EndRenderPass();
+			RenderingDevice::Present();
+		});
+
+		result.Metrics.push_back({ "damage_area_fraction", damageFraction / std::max<sf::Uint32>(frame, 1) });
+		result.Metrics.push_back({ "incremental_present", RenderingDevice::SupportsIncrementalPresent() ? 1.0 : 0.0 });
+		results.push_back(result);
+	}
+
+	RenderingDevice::SetDamageTrackingEnabled(false);
+
+	for (VulkanBuffer& vertexBuffer : vertexBuffers)
+		RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	RenderingDevice::DestroyShader(shader);
+}
+
+static void RunRenderGraph(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	vk::Format format = RenderingDevice::GetSwapchainFormat();
+	vk::Extent2D extent = RenderingDevice::GetSwapchainExtent();
+	vk::Extent2D halfExtent(std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u));
+	vk::Extent2D quarterExtent(std::max(extent.width / 4, 1u), std::max(extent.height / 4, 1u));
+
+	// Bloom-like chain: the scene is downsampled twice and upscaled into the swapchain image, the quarter target
+	// reuses the scene target's memory. Nothing reads the debug view, so its pass is culled.
+	RenderGraph graph;
+	RenderGraphResource sceneColor = graph.CreateImage("SceneColor", { extent.width, extent.height, format });
+	RenderGraphResource half = graph.CreateImage("Half", { halfExtent.width, halfExtent.height, format });
+	RenderGraphResource quarter = graph.CreateImage("Quarter", { quarterExtent.width, quarterExtent.height, format });
+	RenderGraphResource debugView = graph.CreateImage("DebugView", { extent.width, extent.height, format });
+	RenderGraphResource backbuffer = graph.ImportImage("Backbuffer", RenderingDevice::GetSwapchainImage(), RenderingDevice::GetSwapchainImageView(), format, extent);
+	graph.MarkOutput(backbuffer);
+
+	auto blit = [&graph](RenderGraphResource source, vk::Extent2D sourceExtent, RenderGraphResource destination, vk::Extent2D destinationExtent)
+	{
+		return [&graph, source, sourceExtent, destination, destinationExtent](vk::CommandBuffer commandBuffer)
+		{
+			vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+			std::array<vk::Offset3D, 2> sourceOffsets = { vk::Offset3D(0, 0, 0), vk::Offset3D(sourceExtent.width, sourceExtent.height, 1) };
+			std::array<vk::Offset3D, 2> destinationOffsets = { vk::Offset3D(0, 0, 0), vk::Offset3D(destinationExtent.width, destinationExtent.height, 1) };
+			vk::ImageBlit region(layers, sourceOffsets, layers, destinationOffsets);
+			commandBuffer.blitImage(graph.GetImage(source), vk::ImageLayout::eTransferSrcOptimal, graph.GetImage(destination), vk::ImageLayout::eTransferDstOptimal, region, vk::Filter::eLinear);
+		};
+	};
+
+	graph.AddPass("Scene", [&](RenderGraphBuilder& builder)
+	{
+		builder.SetColorAttachment(sceneColor, vk::AttachmentLoadOp::eClear, vk::ClearColorValue(std::array<float, 4>{ 0.1f, 0.2f, 0.3f, 1.0f }));
+	}, [](vk::CommandBuffer) {});
+
+	graph.AddPass("DebugView", [&](RenderGraphBuilder& builder)
+	{
+		builder.Read(sceneColor, RenderGraphAccess::TransferSrc);
+		builder.Write(debugView, RenderGraphAccess::TransferDst);
+	}, blit(sceneColor, extent, debugView, extent));
+
+	graph.AddPass("Downsample", [&](RenderGraphBuilder& builder)
+	{
+		builder.Read(sceneColor, RenderGraphAccess::TransferSrc);
+		builder.Write(half, RenderGraphAccess::TransferDst);
+	}, blit(sceneColor, extent, half, halfExtent));
+
+	graph.AddPass("DownsampleQuarter", [&](RenderGraphBuilder& builder)
+	{
+		builder.Read(half, RenderGraphAccess::TransferSrc);
+		builder.Write(quarter, RenderGraphAccess::TransferDst);
+	}, blit(half, halfExtent, quarter, quarterExtent));
+
+	graph.AddPass("Upscale", [&](RenderGraphBuilder& builder)
+	{
+		builder.Read(quarter, RenderGraphAccess::TransferSrc);
+		builder.Write(backbuffer, RenderGraphAccess::TransferDst);
+	}, blit(quarter, quarterExtent, backbuffer, extent));
+
+	// Where an overlay would be drawn, renders into the imported image
+	graph.AddPass("Overlay", [&](RenderGraphBuilder& builder)
+	{
+		builder.SetColorAttachment(backbuffer, vk::AttachmentLoadOp::eLoad);
+	}, [](vk::CommandBuffer) {});
+
+	graph.Compile();
+
+	BenchmarkResult result = {};
+	result.Name = "render_graph";
+
+	MeasureFrames(config, result, [&]()
+	{
+		RenderingDevice::BeginFrame();
+		graph.UpdateImportedImage(backbuffer, RenderingDevice::GetSwapchainImage(), RenderingDevice::GetSwapchainImageView());
+		graph.Execute(RenderingDevice::GetCommandBuffer());
+		RenderingDevice::EndFrame();
+		RenderingDevice::Present();
+	});
+
+	result.Metrics.push_back({ "passes", (double)graph.GetPassCount() });
+	result.Metrics.push_back({ "culled_passes", (double)graph.GetCulledPassCount() });
+	result.Metrics.push_back({ "barriers_per_frame", (double)RenderingDevice::GetFrameStats().LastFrame.Barriers });
+	result.Metrics.push_back({ "transient_memory_bytes", (double)graph.GetTransientMemorySize() });
+	results.push_back(result);
+
+	graph.Reset();
+}
+
+static void RunRenderLayers(const BenchmarkConfig& config, std::vector<BenchmarkResult>& results)
+{
+	VulkanShader shader = RenderingDevice::CreateShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	VulkanBuffer vertexBuffer = RenderingDevice::CreateVertexBuffer(MakeQuad(0.01f));
+
+	// Static content, e.g. a panel of text glyphs
+	auto drawStatic = [&]()
+	{
+		RenderingDevice::BindShader(shader);
+		RenderingDevice::BindVertexBuffer(vertexBuffer);
+		for (sf::Uint32 i = 0; i < LAYER_DRAW_CALLS; i++)
+			RenderingDevice::Draw(6);
+	};
+
+	vk::Extent2D extent = RenderingDevice::GetSwapchainExtent();
+	sf::Vector2u size(extent.width, extent.height);
+	RenderLayerId layer = RenderLayers::CreateLayer(size, drawStatic);
+
+	for (bool retained : { false, true })
+	{
+		BenchmarkResult result = {};
+		result.Name = retained ? "layers_retained" : "layers_redraw";
+
+		MeasureFrames(config, result, [&]()
+		{
+			RenderingDevice::BeginFrame();
+			if (retained)
+				RenderLayers::Prepare(layer);
+
+			// Dynamic content would be drawn on top of the composited layer
+			RenderingDevice::BeginRenderPass();
+			if (retained)
+				RenderLayers::Composite(layer, sf::Vector2i(0, 0));
+			SetFullViewport();
+			if (!retained)
+				drawStatic();
+			RenderingDevice::EndRenderPass();
+			RenderingDevice::EndFrame();
+			RenderingDevice::Present();
+		});
+
+		result.Metrics.push_back({ "draws_per_frame", (double)RenderingDevice::GetFrameStats().LastFrame.Draws });
+		if (retained)
+		{
+			RenderLayerStats stats = RenderLayers::GetStats();
+			result.Metrics.push_back({ "layer_renders", (double)stats.Renders });
+			result.Metrics.push_back({ "layer_memory_bytes", (double)stats.MemoryUsed });
+		}
+		results.push_back(result);
+	}
+
+	RenderLayers::DestroyLayer(layer);
+	RenderLayers::Terminate();
+	RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+	RenderingDevice::DestroyShader(shader);
+}
+
+const std::vector<BenchmarkScenario>& Benchmark::GetScenarios()
+{
+	static const std::vector<BenchmarkScenario> scenarios = {
+		{ "draw_calls", true, RunDrawCalls },
+		{ "instanced_sprites", true, RunInstancedSprites },
+		{ "upload_bandwidth", true, RunUploadBandwidth },
+		{ "pipeline_creation_cold", false, RunPipelineCreationCold },
+		{ "pipeline_creation_warm", true, RunPipelineCreationWarm },
+		{ "swapchain_recreate", true, RunSwapchainRecreate },
+		{ "texture_streaming", true, RunTextureStreaming },
+		{ "parallel_recording", true, RunParallelRecording },
+		{ "radix_sort_1m", false, RunRadixSort },
+		{ "std_stable_sort_1m", false, RunStdStableSort },
+		{ "draw_queue_binds", true, RunDrawQueueBinds },
+		{ "depth_overdraw", true, RunDepthOverdraw },
+		{ "transient_attachments", true, RunTransientAttachments },
+		{ "damage_tracking", true, RunDamageTracking },
+		{ "render_graph", true, RunRenderGraph },
+		{ "render_layers", true, RunRenderLayers }
+	};
+
+	return scenarios;
+}
@@ -1,17 +1,19 @@
 VULKAN_SDK = os.getenv("VULKAN_SDK")
 
+newoption {
+    trigger = "profile",
+    description = "Enable the CPU/GPU profiler in Release builds"
+}
+
 workspace "New-Workspace"
     architecture "x86_64"
     configurations { "Debug", "Release" }
 
-project "New-Project"
-    kind "ConsoleApp"
     language "C++"
+    cppdialect "C++17"
 
     targetdir "Binaries/%{cfg.system}-%{cfg.buildcfg}"
-    objdir "Binaries/%{cfg.system}-%{cfg.buildcfg}/Intermediates"
-
-    files { "Source/**.cpp" }
+    objdir "Binaries/%{cfg.system}-%{cfg.buildcfg}/Intermediates/%{prj.name}"
 
     filter { "system:Windows", "configurations:Debug" }
         includedirs { "Vendor", "$(VULKAN_SDK)/Include", "Source" }
@@ -43,17 +45,49 @@ project "New-Project"
             "sfml-network",
             "sfml-audio",
             "openal32",
-            "vulkan"
+            "vulkan",
+            "pthread"
         }
 
     filter "configurations:Debug"
         runtime "Debug"
         symbols "On"
         optimize "Off"
-        defines "DEBUG"
+        defines { "DEBUG", "ENABLE_PROFILER" }
 
     filter "configurations:Release"
         runtime "Release"
         symbols "Off"
         optimize "On"
         defines "NDEBUG"
+
+    filter { "configurations:Release", "options:profile" }
+        defines "ENABLE_PROFILER"
+
+    filter {}
+
+project "New-Project"
+    kind "ConsoleApp"
+
+    files { "Source/**.cpp" }
+
+-- Headless renderer benchmarks, run from the repository root so Resources/ is found
+project "Benchmarks"
+    kind "ConsoleApp"
+
+    files { "Source/**.cpp", "Benchmarks/**.cpp" }
+    removefiles { "Source/Main.cpp" }
+    includedirs { "Benchmarks" }
+
+-- Compares two benchmark result files, exits non-zero on a significant regression
+project "BenchmarkCompare"
+    kind "ConsoleApp"
+
+    files { "Tools/BenchmarkCompare/**.cpp" }
+
+-- Replays a trace written by TraceCapture on a headless device
+project "TraceReplay"
+    kind "ConsoleApp"
+
+    files { "Source/**.cpp", "Tools/TraceReplay/**.cpp" }
+    removefiles { "Source/Main.cpp" }
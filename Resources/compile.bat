@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe layer.vert -o layer_vert.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe layer.frag -o layer_frag.spv
 pause
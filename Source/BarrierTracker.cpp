@@ -0,0 +1,402 @@
+#include <cassert>
+#include <unordered_map>
+#include <vector>
+
+#include "BarrierTracker.hpp"
+
+struct UsageInfo
+{
+	vk::PipelineStageFlags2 Stages = {};
+	vk::AccessFlags2 Access = {};
+	vk::ImageLayout Layout = vk::ImageLayout::eUndefined;
+	bool Write = {};
+};
+
+struct SubresourceState
+{
+	vk::ImageLayout Layout = vk::ImageLayout::eUndefined;
+	vk::PipelineStageFlags2 WriteStages = {};
+	vk::AccessFlags2 WriteAccess = {};
+	vk::PipelineStageFlags2 ReadStages = {};
+	vk::AccessFlags2 ReadAccess = {};
+
+	bool operator==(const SubresourceState& other) const
+	{
+		return Layout == other.Layout
+			&& WriteStages == other.WriteStages
+			&& WriteAccess == other.WriteAccess
+			&& ReadStages == other.ReadStages
+			&& ReadAccess == other.ReadAccess;
+	}
+};
+
+struct ImageState
+{
+	vk::ImageAspectFlags Aspect = {};
+	sf::Uint32 MipLevels = {};
+	sf::Uint32 ArrayLayers = {};
+	std::vector<SubresourceState> Subresources = {};
+};
+
+static std::unordered_map<VkImage, ImageState>				s_Images = {};
+static std::unordered_map<VkBuffer, SubresourceState>		s_Buffers = {};
+static std::vector<vk::ImageMemoryBarrier2>					s_ImageBarriers = {};
+static std::vector<vk::BufferMemoryBarrier2>				s_BufferBarriers = {};
+
+static std::unordered_map<VkImage, ImageState>				s_SavedImages = {};
+static std::unordered_map<VkBuffer, SubresourceState>		s_SavedBuffers = {};
+
+static UsageInfo GetUsageInfo(ResourceUsage usage)
+{
+	using Stage = vk::PipelineStageFlagBits2;
+	using Access = vk::AccessFlagBits2;
+
+	switch (usage)
+	{
+	case ResourceUsage::Undefined:				return { Stage::eNone, Access::eNone, vk::ImageLayout::eUndefined, false };
+	case ResourceUsage::General:				return { Stage::eAllCommands, Access::eMemoryRead | Access::eMemoryWrite, vk::ImageLayout::eGeneral, true };
+	case ResourceUsage::TransferSrc:			return { Stage::eTransfer, Access::eTransferRead, vk::ImageLayout::eTransferSrcOptimal, false };
+	case ResourceUsage::TransferDst:			return { Stage::eTransfer, Access::eTransferWrite, vk::ImageLayout::eTransferDstOptimal, true };
+	case ResourceUsage::VertexShaderRead:		return { Stage::eVertexShader, Access::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal, false };
+	case ResourceUsage::FragmentShaderRead:		return { Stage::eFragmentShader, Access::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal, false };
+	case ResourceUsage::ComputeShaderRead:		return { Stage::eComputeShader, Access::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal, false };
+	case ResourceUsage::ComputeStorageRead:		return { Stage::eComputeShader, Access::eShaderRead, vk::ImageLayout::eGeneral, false };
+	case ResourceUsage::ComputeStorageWrite:	return { Stage::eComputeShader, Access::eShaderRead | Access::eShaderWrite, vk::ImageLayout::eGeneral, true };
+	case ResourceUsage::ColorAttachment:		return { Stage::eColorAttachmentOutput, Access::eColorAttachmentRead | Access::eColorAttachmentWrite, vk::ImageLayout::eColorAttachmentOptimal, true };
+	case ResourceUsage::DepthAttachment:		return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite, vk::ImageLayout::eDepthStencilAttachmentOptimal, true };
+	case ResourceUsage::DepthRead:				return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests | Stage::eFragmentShader, Access::eDepthStencilAttachmentRead | Access::eShaderRead, vk::ImageLayout::eDepthStencilReadOnlyOptimal, false };
+	case ResourceUsage::VertexBuffer:			return { Stage::eVertexInput, Access::eVertexAttributeRead, vk::ImageLayout::eUndefined, false };
+	case ResourceUsage::IndexBuffer:			return { Stage::eVertexInput, Access::eIndexRead, vk::ImageLayout::eUndefined, false };
+	case ResourceUsage::UniformBuffer:			return { Stage::eVertexShader | Stage::eFragmentShader | Stage::eComputeShader, Access::eUniformRead, vk::ImageLayout::eUndefined, false };
+	case ResourceUsage::IndirectBuffer:			return { Stage::eDrawIndirect, Access::eIndirectCommandRead, vk::ImageLayout::eUndefined, false };
+	case ResourceUsage::HostRead:				return { Stage::eHost, Access::eHostRead, vk::ImageLayout::eGeneral, false };
+	case ResourceUsage::HostWrite:				return { Stage::eHost, Access::eHostWrite, vk::ImageLayout::eGeneral, true };
+	case ResourceUsage::Present:				return { Stage::eBottomOfPipe, Access::eNone, vk::ImageLayout::ePresentSrcKHR, false };
+	}
+
+	return {};
+}
+
+// Returns true and fills the masks if the new usage needs a barrier, updates the state either way
+static bool ApplyUsage(SubresourceState& state, const UsageInfo& info, bool isImage, vk::PipelineStageFlags2& srcStages, vk::AccessFlags2& srcAccess)
+{
+	bool layoutChange = isImage && state.Layout != info.Layout;
+	bool needsBarrier = false;
+
+	if (info.Write || layoutChange)
+	{
+		// Write-after-read only needs an execution dependency, write-after-write & layout changes need the memory one too
+		srcStages = state.WriteStages | state.ReadStages;
+		srcAccess = state.WriteAccess;
+		needsBarrier = srcStages || layoutChange;
+
+		state.Layout = info.Layout;
+		state.WriteStages = info.Stages;
+		state.WriteAccess = info.Write ? info.Access : vk::AccessFlags2();
+		state.ReadStages = info.Write ? vk::PipelineStageFlags2() : info.Stages;
+		state.ReadAccess = info.Write ? vk::AccessFlags2() : info.Access;
+	}
+	else
+	{
+		// Read-after-read is free unless the last write is not yet visible to this stage. Usages without any access
+		// (presentation) only need the layout.
+		bool visible = !(info.Stages & ~state.ReadStages) && !(info.Access & ~state.ReadAccess);
+		srcStages = state.WriteStages;
+		srcAccess = state.WriteAccess;
+		needsBarrier = state.WriteStages && !visible && info.Access;
+
+		state.ReadStages |= info.Stages;
+		state.ReadAccess |= info.Access;
+	}
+
+	return needsBarrier;
+}
+
+void BarrierTracker::RegisterImage(vk::Image image, vk::ImageAspectFlags aspect, sf::Uint32 mipLevels, sf::Uint32 arrayLayers, vk::ImageLayout layout)
+{
+	ImageState imageState = {};
+	imageState.Aspect = aspect;
+	imageState.MipLevels = mipLevels;
+	imageState.ArrayLayers = arrayLayers;
+	imageState.Subresources.resize(mipLevels * arrayLayers);
+
+	for (SubresourceState& state : imageState.Subresources)
+		state.Layout = layout;
+
+	s_Images[image] = imageState;
+}
+
+void BarrierTracker::UnregisterImage(vk::Image image)
+{
+	s_Images.erase(image);
+}
+
+void BarrierTracker::UnregisterBuffer(vk::Buffer buffer)
+{
+	s_Buffers.erase(buffer);
+}
+
+void BarrierTracker::TransitionImage(vk::Image image, ResourceUsage usage, sf::Uint32 baseMipLevel, sf::Uint32 levelCount, sf::Uint32 baseArrayLayer, sf::Uint32 layerCount)
+{
+	auto it = s_Images.find(image);
+	assert(it != s_Images.end());
+	ImageState& imageState = it->second;
+
+	if (levelCount == vk::RemainingMipLevels)
+		levelCount = imageState.MipLevels - baseMipLevel;
+	if (layerCount == vk::RemainingArrayLayers)
+		layerCount = imageState.ArrayLayers - baseArrayLayer;
+
+	UsageInfo info = GetUsageInfo(usage);
+
+	// Subresources sharing the same previous state are merged into one barrier (runs of layers, then runs of mips)
+	size_t firstBarrier = s_ImageBarriers.size();
+
+	for (sf::Uint32 mip = baseMipLevel; mip < baseMipLevel + levelCount; mip++)
+	{
+		sf::Uint32 layer = baseArrayLayer;
+		while (layer < baseArrayLayer + layerCount)
+		{
+			SubresourceState previous = imageState.Subresources[mip * imageState.ArrayLayers + layer];
+
+			sf::Uint32 runLength = 1;
+			while (layer + runLength < baseArrayLayer + layerCount && imageState.Subresources[mip * imageState.ArrayLayers + layer + runLength] == previous)
+				runLength++;
+
+			vk::PipelineStageFlags2 srcStages = {};
+			vk::AccessFlags2 srcAccess = {};
+			bool needsBarrier = false;
+
+			for (sf::Uint32 i = 0; i < runLength; i++)
+				needsBarrier = ApplyUsage(imageState.Subresources[mip * imageState.ArrayLayers + layer + i], info, true, srcStages, srcAccess);
+
+			if (needsBarrier)
+			{
+				vk::ImageSubresourceRange range(imageState.Aspect, mip, 1, layer, runLength);
+
+				bool merged = false;
+				for (size_t i = firstBarrier; i < s_ImageBarriers.size() && !merged; i++)
+				{
+					vk::ImageMemoryBarrier2& barrier = s_ImageBarriers[i];
+					vk::ImageSubresourceRange& other = barrier.subresourceRange;
+
+					if (barrier.srcStageMask == srcStages && barrier.srcAccessMask == srcAccess && barrier.oldLayout == previous.Layout
+						&& other.baseArrayLayer == layer && other.layerCount == runLength && other.baseMipLevel + other.levelCount == mip)
+					{
+						other.levelCount++;
+						merged = true;
+					}
+				}
+
+				if (!merged)
+				{
+					s_ImageBarriers.push_back(vk::ImageMemoryBarrier2(srcStages,
+						srcAccess,
+						info.Stages,
+						info.Access,
+						previous.Layout,
+						info.Layout,
+						vk::QueueFamilyIgnored,
+						vk::QueueFamilyIgnored,
+						image,
+						range));
+				}
+			}
+
+			layer += runLength;
+		}
+	}
+}
+
+void BarrierTracker::TransitionBuffer(vk::Buffer buffer, ResourceUsage usage, vk::DeviceSize offset, vk::DeviceSize size)
+{
+	SubresourceState& state = s_Buffers[buffer];
+	UsageInfo info = GetUsageInfo(usage);
+
+	vk::PipelineStageFlags2 srcStages = {};
+	vk::AccessFlags2 srcAccess = {};
+
+	if (ApplyUsage(state, info, false, srcStages, srcAccess))
+	{
+		s_BufferBarriers.push_back(vk::BufferMemoryBarrier2(srcStages,
+			srcAccess,
+			info.Stages,
+			info.Access,
+			vk::QueueFamilyIgnored,
+			vk::QueueFamilyIgnored,
+			buffer,
+			offset,
+			size));
+	}
+}
+
+void BarrierTracker::DiscardImage(vk::Image image)
+{
+	auto it = s_Images.find(image);
+	assert(it != s_Images.end());
+
+	for (SubresourceState& state : it->second.Subresources)
+		state.Layout = vk::ImageLayout::eUndefined;
+}
+
+static void MergeAliased(SubresourceState& state, const SubresourceState& previous)
+{
+	state.Layout = vk::ImageLayout::eUndefined;
+	state.WriteStages |= previous.WriteStages | previous.ReadStages;
+	state.WriteAccess |= previous.WriteAccess;
+}
+
+void BarrierTracker::AliasImage(vk::Image image, vk::Image previous)
+{
+	auto it = s_Images.find(image);
+	assert(it != s_Images.end());
+
+	// Accesses of every subresource of the previous image may overlap any subresource of this one
+	SubresourceState previousState = {};
+	auto previousIt = s_Images.find(previous);
+	if (previousIt != s_Images.end())
+	{
+		for (const SubresourceState& state : previousIt->second.Subresources)
+			MergeAliased(previousState, state);
+	}
+
+	for (SubresourceState& state : it->second.Subresources)
+		MergeAliased(state, previousState);
+}
+
+void BarrierTracker::AliasBuffer(vk::Buffer buffer, vk::Buffer previous)
+{
+	auto previousIt = s_Buffers.find(previous);
+	if (previousIt == s_Buffers.end())
+		return;
+
+	// Inserting may rehash, element references stay valid unlike iterators
+	const SubresourceState& previousState = previousIt->second;
+	MergeAliased(s_Buffers[buffer], previousState);
+}
+
+void BarrierTracker::SetImageState(vk::Image image, vk::ImageLayout layout, ResourceUsage lastUsage)
+{
+	auto it = s_Images.find(image);
+	assert(it != s_Images.end());
+
+	UsageInfo info = GetUsageInfo(lastUsage);
+
+	SubresourceState lastState = {};
+	lastState.Layout = layout;
+	if (info.Write)
+	{
+		lastState.WriteStages = info.Stages;
+		lastState.WriteAccess = info.Access;
+	}
+	else
+	{
+		lastState.ReadStages = info.Stages;
+		lastState.ReadAccess = info.Access;
+	}
+
+	for (SubresourceState& state : it->second.Subresources)
+		state = lastState;
+}
+
+void BarrierTracker::SaveState()
+{
+	s_SavedImages = s_Images;
+	s_SavedBuffers = s_Buffers;
+}
+
+void BarrierTracker::RestoreState()
+{
+	for (auto& [image, imageState] : s_Images)
+	{
+		auto saved = s_SavedImages.find(image);
+		if (saved != s_SavedImages.end())
+		{
+			imageState.Subresources = saved->second.Subresources;
+			continue;
+		}
+
+		for (SubresourceState& state : imageState.Subresources)
+			state = {};
+	}
+
+	for (auto& [buffer, state] : s_Buffers)
+	{
+		auto saved = s_SavedBuffers.find(buffer);
+		state = saved != s_SavedBuffers.end() ? saved->second : SubresourceState();
+	}
+
+	s_SavedImages.clear();
+	s_SavedBuffers.clear();
+	s_ImageBarriers.clear();
+	s_BufferBarriers.clear();
+}
+
+void BarrierTracker::Flush(vk::CommandBuffer commandBuffer)
+{
+	if (s_ImageBarriers.empty() && s_BufferBarriers.empty())
+		return;
+
+	FrameStats stats = {};
+	stats.Barriers = s_ImageBarriers.size() + s_BufferBarriers.size();
+	RenderingDevice::AddFrameStats(stats);
+
+	if (RenderingDevice::SupportsSynchronization2())
+	{
+		vk::DependencyInfo dependencyInfo(vk::DependencyFlags(), nullptr, s_BufferBarriers, s_ImageBarriers);
+		commandBuffer.pipelineBarrier2(dependencyInfo, RenderingDevice::GetDispatch());
+	}
+	else
+	{
+		// Legacy path: the tracker only uses stage & access bits that share their values with the original flags
+		vk::PipelineStageFlags srcStages = {};
+		vk::PipelineStageFlags dstStages = {};
+		std::vector<vk::ImageMemoryBarrier> imageBarriers = {};
+		std::vector<vk::BufferMemoryBarrier> bufferBarriers = {};
+
+		for (const vk::ImageMemoryBarrier2& barrier : s_ImageBarriers)
+		{
+			srcStages |= vk::PipelineStageFlags((VkPipelineStageFlags)(VkPipelineStageFlags2)barrier.srcStageMask);
+			dstStages |= vk::PipelineStageFlags((VkPipelineStageFlags)(VkPipelineStageFlags2)barrier.dstStageMask);
+			imageBarriers.push_back(vk::ImageMemoryBarrier(vk::AccessFlags((VkAccessFlags)(VkAccessFlags2)barrier.srcAccessMask),
+				vk::AccessFlags((VkAccessFlags)(VkAccessFlags2)barrier.dstAccessMask),
+				barrier.oldLayout,
+				barrier.newLayout,
+				barrier.srcQueueFamilyIndex,
+				barrier.dstQueueFamilyIndex,
+				barrier.image,
+				barrier.subresourceRange));
+		}
+
+		for (const vk::BufferMemoryBarrier2& barrier : s_BufferBarriers)
+		{
+			srcStages |= vk::PipelineStageFlags((VkPipelineStageFlags)(VkPipelineStageFlags2)barrier.srcStageMask);
+			dstStages |= vk::PipelineStageFlags((VkPipelineStageFlags)(VkPipelineStageFlags2)barrier.dstStageMask);
+			bufferBarriers.push_back(vk::BufferMemoryBarrier(vk::AccessFlags((VkAccessFlags)(VkAccessFlags2)barrier.srcAccessMask),
+				vk::AccessFlags((VkAccessFlags)(VkAccessFlags2)barrier.dstAccessMask),
+				barrier.srcQueueFamilyIndex,
+				barrier.dstQueueFamilyIndex,
+				barrier.buffer,
+				barrier.offset,
+				barrier.size));
+		}
+
+		if (!srcStages)
+			srcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+		if (!dstStages)
+			dstStages = vk::PipelineStageFlagBits::eBottomOfPipe;
+
+		commandBuffer.pipelineBarrier(srcStages, dstStages, vk::DependencyFlags(), nullptr, bufferBarriers, imageBarriers);
+	}
+
+	s_ImageBarriers.clear();
+	s_BufferBarriers.clear();
+}
+
+vk::ImageLayout BarrierTracker::GetImageLayout(vk::Image image, sf::Uint32 mipLevel, sf::Uint32 arrayLayer)
+{
+	auto it = s_Images.find(image);
+	assert(it != s_Images.end());
+
+	return it->second.Subresources[mipLevel * it->second.ArrayLayers + arrayLayer].Layout;
+}
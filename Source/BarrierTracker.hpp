@@ -0,0 +1,65 @@
+#pragma once
+
+#include "RenderingDevice.hpp"
+
+enum class ResourceUsage
+{
+	Undefined,
+	General,
+	TransferSrc,
+	TransferDst,
+	VertexShaderRead,
+	FragmentShaderRead,
+	ComputeShaderRead,
+	ComputeStorageRead,
+	ComputeStorageWrite,
+	ColorAttachment,
+	DepthAttachment,
+	DepthRead,
+	VertexBuffer,
+	IndexBuffer,
+	UniformBuffer,
+	IndirectBuffer,
+	HostRead,
+	HostWrite,
+	Present
+};
+
+// Tracks layout, last access & stage of every registered resource (per mip level and array layer for images).
+// Transitions are queued and recorded as one batched barrier into the caller's command buffer by Flush().
+// Images are registered by their owner, which has to transition them through the tracker only. The device registers
+// its own images (swapchain, scene, render & transient targets), render graphs their transient resources.
+// Main thread only, the state is not synchronized with the recording threads.
+class BarrierTracker
+{
+public:
+	static void RegisterImage(vk::Image image, vk::ImageAspectFlags aspect, sf::Uint32 mipLevels = 1, sf::Uint32 arrayLayers = 1, vk::ImageLayout layout = vk::ImageLayout::eUndefined);
+	// Safe for images that were never registered, the device calls it for every image it destroys
+	static void UnregisterImage(vk::Image image);
+	static void UnregisterBuffer(vk::Buffer buffer);
+
+	static void TransitionImage(vk::Image image, ResourceUsage usage, sf::Uint32 baseMipLevel = 0, sf::Uint32 levelCount = vk::RemainingMipLevels, sf::Uint32 baseArrayLayer = 0, sf::Uint32 layerCount = vk::RemainingArrayLayers);
+	static void TransitionBuffer(vk::Buffer buffer, ResourceUsage usage, vk::DeviceSize offset = 0, vk::DeviceSize size = vk::WholeSize);
+
+	// Previous contents are not needed, next transition starts from an undefined layout
+	static void DiscardImage(vk::Image image);
+	// The resource takes over memory the previous one used, its next transition also waits for the previous accesses
+	static void AliasImage(vk::Image image, vk::Image previous);
+	static void AliasBuffer(vk::Buffer buffer, vk::Buffer previous);
+
+	// Work the tracker did not record left the image in this layout (e.g. a render pass' final layout, or the acquire
+	// semaphore waited on at a stage), the next transition waits for the stages & access of the given usage
+	static void SetImageState(vk::Image image, vk::ImageLayout layout, ResourceUsage lastUsage);
+
+	// Undoes the transitions made in between, for command buffers that are dropped instead of submitted. Resources
+	// registered in between are reset to the undefined layout.
+	static void SaveState();
+	static void RestoreState();
+
+	static void Flush(vk::CommandBuffer commandBuffer);
+
+	static vk::ImageLayout GetImageLayout(vk::Image image, sf::Uint32 mipLevel = 0, sf::Uint32 arrayLayer = 0);
+private:
+	BarrierTracker();
+	BarrierTracker(const BarrierTracker&);
+};
@@ -0,0 +1,165 @@
+#include <cassert>
+#include <cstring>
+
+#include "CommandList.hpp"
+
+CommandList::CommandList(size_t reserveBytes)
+{
+	m_Data.resize((reserveBytes + ALIGNMENT - 1) / ALIGNMENT);
+}
+
+void CommandList::BindShader(const VulkanShader& vulkanShader)
+{
+	BindShaderCommand& command = Push<BindShaderCommand>(CommandType::BindShader);
+	command.PipelineLayout = vulkanShader.PipelineLayout;
+	command.Pipeline = vulkanShader.Pipeline;
+}
+
+void CommandList::BindVertexBuffer(const VulkanBuffer& vertexBuffer)
+{
+	BindVertexBufferCommand& command = Push<BindVertexBufferCommand>(CommandType::BindVertexBuffer);
+	command.Buffer = vertexBuffer.Buffer;
+}
+
+void CommandList::BindDescriptorSet(const VulkanShader& vulkanShader, vk::DescriptorSet descriptorSet, sf::Uint32 setIndex)
+{
+	BindDescriptorSetCommand& command = Push<BindDescriptorSetCommand>(CommandType::BindDescriptorSet);
+	command.SetIndex = setIndex;
+	command.PipelineLayout = vulkanShader.PipelineLayout;
+	command.Pipeline = vulkanShader.Pipeline;
+	command.DescriptorSet = descriptorSet;
+}
+
+void CommandList::PushConstants(const VulkanShader& vulkanShader, const void* data, sf::Uint32 size, sf::Uint32 offset)
+{
+	PushConstantsCommand& command = Push<PushConstantsCommand>(CommandType::PushConstants, size);
+	command.Offset = offset;
+	command.Size = size;
+	command.PipelineLayout = vulkanShader.PipelineLayout;
+	command.Pipeline = vulkanShader.Pipeline;
+	std::memcpy((sf::Uint8*)&command + GetCommandSize<PushConstantsCommand>(), data, size);
+}
+
+void CommandList::SetViewport(sf::Vector2f position, sf::Vector2f size)
+{
+	SetViewportCommand& command = Push<SetViewportCommand>(CommandType::SetViewport);
+	command.X = position.x;
+	command.Y = position.y;
+	command.Width = size.x;
+	command.Height = size.y;
+}
+
+void CommandList::SetScissors(sf::Vector2i offset, sf::Vector2i extent)
+{
+	SetScissorsCommand& command = Push<SetScissorsCommand>(CommandType::SetScissors);
+	command.X = offset.x;
+	command.Y = offset.y;
+	command.Width = extent.x;
+	command.Height = extent.y;
+}
+
+void CommandList::Draw(sf::Uint32 count, sf::Uint32 instanceCount, sf::Uint32 firstVertex, sf::Uint32 firstInstance)
+{
+	DrawCommand& command = Push<DrawCommand>(CommandType::Draw);
+	command.VertexCount = count;
+	command.InstanceCount = instanceCount;
+	command.FirstVertex = firstVertex;
+	command.FirstInstance = firstInstance;
+}
+
+void CommandList::Append(const CommandList& other)
+{
+	if (m_Size + other.m_Size > m_Data.size() * ALIGNMENT)
+		m_Data.resize((m_Size + other.m_Size) / ALIGNMENT);
+
+	std::memcpy((sf::Uint8*)m_Data.data() + m_Size, other.m_Data.data(), other.m_Size);
+	m_Size += other.m_Size;
+	m_CommandCount += other.m_CommandCount;
+}
+
+void CommandList::Clear()
+{
+	// Keeps the arena, so steady state recording never allocates
+	m_Size = 0;
+	m_CommandCount = 0;
+}
+
+void CommandList::Replay() const
+{
+	const sf::Uint8* data = (const sf::Uint8*)m_Data.data();
+	const sf::Uint8* end = data + m_Size;
+
+	while (data < end)
+	{
+		switch (*(const CommandType*)data)
+		{
+		case CommandType::BindShader:
+		{
+			const BindShaderCommand& command = *(const BindShaderCommand*)data;
+			VulkanShader vulkanShader = { command.PipelineLayout, command.Pipeline };
+			RenderingDevice::BindShader(vulkanShader);
+			data += GetCommandSize<BindShaderCommand>();
+			break;
+		}
+		case CommandType::BindVertexBuffer:
+		{
+			const BindVertexBufferCommand& command = *(const BindVertexBufferCommand*)data;
+			VulkanBuffer vertexBuffer = { command.Buffer, nullptr };
+			RenderingDevice::BindVertexBuffer(vertexBuffer);
+			data += GetCommandSize<BindVertexBufferCommand>();
+			break;
+		}
+		case CommandType::BindDescriptorSet:
+		{
+			const BindDescriptorSetCommand& command = *(const BindDescriptorSetCommand*)data;
+			VulkanShader vulkanShader = { command.PipelineLayout, command.Pipeline };
+			RenderingDevice::BindDescriptorSet(vulkanShader, command.DescriptorSet, command.SetIndex);
+			data += GetCommandSize<BindDescriptorSetCommand>();
+			break;
+		}
+		case CommandType::PushConstants:
+		{
+			const PushConstantsCommand& command = *(const PushConstantsCommand*)data;
+			VulkanShader vulkanShader = { command.PipelineLayout, command.Pipeline };
+			RenderingDevice::PushConstants(vulkanShader, data + GetCommandSize<PushConstantsCommand>(), command.Size, command.Offset);
+			data += GetCommandSize<PushConstantsCommand>() + Align(command.Size);
+			break;
+		}
+		case CommandType::SetViewport:
+		{
+			const SetViewportCommand& command = *(const SetViewportCommand*)data;
+			RenderingDevice::SetViewport(sf::Vector2f(command.X, command.Y), sf::Vector2f(command.Width, command.Height));
+			data += GetCommandSize<SetViewportCommand>();
+			break;
+		}
+		case CommandType::SetScissors:
+		{
+			const SetScissorsCommand& command = *(const SetScissorsCommand*)data;
+			RenderingDevice::SetScissors(sf::Vector2i(command.X, command.Y), sf::Vector2i((int)command.Width, (int)command.Height));
+			data += GetCommandSize<SetScissorsCommand>();
+			break;
+		}
+		case CommandType::Draw:
+		{
+			const DrawCommand& command = *(const DrawCommand*)data;
+			RenderingDevice::Draw(command.VertexCount, command.InstanceCount, command.FirstVertex, command.FirstInstance);
+			data += GetCommandSize<DrawCommand>();
+			break;
+		}
+		default:
+			// A corrupt arena, the size of the record is unknown
+			assert(false);
+			return;
+		}
+	}
+}
+
+size_t CommandList::GetSize() const
+{
+	return m_Size;
+}
+
+sf::Uint32 CommandList::GetCommandCount() const
+{
+	return m_CommandCount;
+}
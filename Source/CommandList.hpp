@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+enum class CommandType : sf::Uint32
+{
+	BindShader,
+	BindVertexBuffer,
+	BindDescriptorSet,
+	PushConstants,
+	SetViewport,
+	SetScissors,
+	Draw
+};
+
+// Records are plain data so the arena can be filled on any thread and copied around freely
+
+struct BindShaderCommand
+{
+	CommandType Type;
+	VkPipelineLayout PipelineLayout;
+	VkPipeline Pipeline;
+};
+
+struct BindVertexBufferCommand
+{
+	CommandType Type;
+	VkBuffer Buffer;
+};
+
+struct BindDescriptorSetCommand
+{
+	CommandType Type;
+	sf::Uint32 SetIndex;
+	VkPipelineLayout PipelineLayout;
+	VkPipeline Pipeline;
+	VkDescriptorSet DescriptorSet;
+};
+
+// Followed by Size bytes of constants, padded to the record alignment
+struct PushConstantsCommand
+{
+	CommandType Type;
+	sf::Uint32 Offset;
+	sf::Uint32 Size;
+	VkPipelineLayout PipelineLayout;
+	VkPipeline Pipeline;
+};
+
+struct SetViewportCommand
+{
+	CommandType Type;
+	float X, Y, Width, Height;
+};
+
+struct SetScissorsCommand
+{
+	CommandType Type;
+	sf::Int32 X, Y;
+	sf::Uint32 Width, Height;
+};
+
+struct DrawCommand
+{
+	CommandType Type;
+	sf::Uint32 VertexCount;
+	sf::Uint32 InstanceCount;
+	sf::Uint32 FirstVertex;
+	sf::Uint32 FirstInstance;
+};
+
+// Linear arena of commands, filled by game/simulation code on any thread and replayed on the render thread.
+// A single list is not thread-safe, use one list per thread and Append() or replay them in order.
+class CommandList
+{
+public:
+	CommandList(size_t reserveBytes = 64 * 1024);
+
+	void BindShader(const VulkanShader& vulkanShader);
+	void BindVertexBuffer(const VulkanBuffer& vertexBuffer);
+	void BindDescriptorSet(const VulkanShader& vulkanShader, vk::DescriptorSet descriptorSet, sf::Uint32 setIndex = 0);
+	void PushConstants(const VulkanShader& vulkanShader, const void* data, sf::Uint32 size, sf::Uint32 offset = 0);
+
+	void SetViewport(sf::Vector2f position, sf::Vector2f size);
+	void SetScissors(sf::Vector2i offset, sf::Vector2i extent);
+
+	void Draw(sf::Uint32 count, sf::Uint32 instanceCount = 1, sf::Uint32 firstVertex = 0, sf::Uint32 firstInstance = 0);
+
+	void Append(const CommandList& other);
+	void Clear();
+
+	// Render thread only, records into the calling thread's command buffer
+	void Replay() const;
+
+	size_t GetSize() const;
+	sf::Uint32 GetCommandCount() const;
+private:
+	static constexpr size_t ALIGNMENT = sizeof(sf::Uint64);
+
+	static constexpr size_t Align(size_t size)
+	{
+		return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	// Every record starts on an 8 byte boundary so handles can be read in place
+	template<typename T>
+	static constexpr size_t GetCommandSize()
+	{
+		return Align(sizeof(T));
+	}
+
+	// Payload bytes are reserved right after the record
+	template<typename T>
+	T& Push(CommandType type, size_t payloadSize = 0)
+	{
+		size_t size = GetCommandSize<T>() + Align(payloadSize);
+		if (m_Size + size > m_Data.size() * ALIGNMENT)
+			m_Data.resize(std::max(m_Data.size() * 2, (m_Size + size) / ALIGNMENT));
+
+		T* command = new ((sf::Uint8*)m_Data.data() + m_Size) T();
+		command->Type = type;
+
+		m_Size += size;
+		m_CommandCount++;
+		return *command;
+	}
+private:
+	std::vector<sf::Uint64> m_Data = {};
+	size_t m_Size = {};
+	sf::Uint32 m_CommandCount = {};
+};
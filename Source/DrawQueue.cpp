@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "DrawQueue.hpp"
+
+static constexpr sf::Uint32 RADIX_BITS = 8;
+static constexpr sf::Uint32 RADIX_BUCKETS = 1 << RADIX_BITS;
+static constexpr sf::Uint32 RADIX_PASSES = 64 / RADIX_BITS;
+
+void DrawQueue::Submit(const DrawItem& item)
+{
+	sf::Uint16 pipelineId = GetPipelineId(item.Shader->Pipeline);
+	sf::Uint16 textureId = GetTextureId(item.Texture);
+
+	DrawSortEntry entry = {};
+	entry.Key = MakeKey(item.Layer, item.Translucent, item.Depth, pipelineId, textureId, m_SortMode);
+	entry.Index = (sf::Uint32)m_Items.size();
+
+	m_Items.push_back(item);
+	m_Entries.push_back(entry);
+}
+
+void DrawQueue::Flush()
+{
+	Sort(m_Entries, m_Scratch);
+
+	m_Stats = {};
+
+	const DrawItem* previous = nullptr;
+	for (const DrawSortEntry& entry : m_Entries)
+	{
+		const DrawItem& item = m_Items[entry.Index];
+
+		// Only emit what changed from the previous item
+		if (!previous || previous->Shader->Pipeline != item.Shader->Pipeline)
+		{
+			RenderingDevice::BindShader(*item.Shader);
+			m_Stats.PipelineBinds++;
+		}
+
+		if (item.Texture && (!previous || previous->Texture != item.Texture || previous->Shader->PipelineLayout != item.Shader->PipelineLayout))
+		{
+			RenderingDevice::BindDescriptorSet(*item.Shader, item.Texture);
+			m_Stats.TextureBinds++;
+		}
+
+		if (!previous || previous->VertexBuffer->Buffer != item.VertexBuffer->Buffer)
+		{
+			RenderingDevice::BindVertexBuffer(*item.VertexBuffer);
+			m_Stats.VertexBufferBinds++;
+		}
+
+		RenderingDevice::Draw(item.Count, item.InstanceCount, item.FirstVertex, item.FirstInstance);
+		m_Stats.Draws++;
+
+		previous = &item;
+	}
+
+	Clear();
+}
+
+void DrawQueue::Clear()
+{
+	m_Items.clear();
+	m_Entries.clear();
+	m_PipelineIds.clear();
+	m_TextureIds.clear();
+}
+
+void DrawQueue::SetSortMode(DrawSortMode sortMode)
+{
+	m_SortMode = sortMode;
+}
+
+DrawSortMode DrawQueue::GetSortMode() const
+{
+	return m_SortMode;
+}
+
+sf::Uint32 DrawQueue::GetSize() const
+{
+	return (sf::Uint32)m_Items.size();
+}
+
+const DrawQueueStats& DrawQueue::GetStats() const
+{
+	return m_Stats;
+}
+
+sf::Uint64 DrawQueue::MakeKey(sf::Uint8 layer, bool translucent, float depth, sf::Uint16 pipelineId, sf::Uint16 textureId, DrawSortMode sortMode)
+{
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+	sf::Uint64 key = (sf::Uint64)layer << 56;
+
+	if (!translucent && sortMode == DrawSortMode::StateFirst)
+	{
+		// Group by state first, then front to back so early depth rejects hidden fragments
+		sf::Uint64 quantizedDepth = (sf::Uint64)(depth * ((1 << 23) - 1));
+		key |= (sf::Uint64)pipelineId << 39;
+		key |= (sf::Uint64)textureId << 23;
+		key |= quantizedDepth;
+	}
+	else if (!translucent)
+	{
+		// Front to back across pipelines, state only breaks ties
+		sf::Uint64 quantizedDepth = (sf::Uint64)(depth * ((1 << 23) - 1));
+		key |= quantizedDepth << 32;
+		key |= (sf::Uint64)pipelineId << 16;
+		key |= (sf::Uint64)textureId;
+	}
+	else
+	{
+		// Blending needs back to front, state only breaks ties
+		sf::Uint64 quantizedDepth = (sf::Uint64)((1.0f - depth) * ((1 << 24) - 1));
+		key |= (sf::Uint64)1 << 55;
+		key |= quantizedDepth << 31;
+		key |= (sf::Uint64)pipelineId << 15;
+		key |= (sf::Uint64)(textureId & 0x7FFF);
+	}
+
+	return key;
+}
+
+void DrawQueue::Sort(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch)
+{
+	size_t count = entries.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+
+	// Build every histogram in a single read of the keys
+	std::array<std::array<sf::Uint32, RADIX_BUCKETS>, RADIX_PASSES> histograms = {};
+	for (const DrawSortEntry& entry : entries)
+	{
+		for (sf::Uint32 pass = 0; pass < RADIX_PASSES; pass++)
+			histograms[pass][(entry.Key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+	}
+
+	DrawSortEntry* source = entries.data();
+	DrawSortEntry* destination = scratch.data();
+
+	for (sf::Uint32 pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		std::array<sf::Uint32, RADIX_BUCKETS>& histogram = histograms[pass];
+
+		// All keys share this digit, the pass would not move anything
+		sf::Uint32 firstDigit = (source[0].Key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+		if (histogram[firstDigit] == count)
+			continue;
+
+		// Exclusive prefix sum turns counts into write offsets
+		sf::Uint32 offset = 0;
+		for (sf::Uint32& bucket : histogram)
+		{
+			sf::Uint32 bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			sf::Uint32 digit = (source[i].Key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+			destination[histogram[digit]++] = source[i];
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != entries.data())
+		std::memcpy(entries.data(), source, count * sizeof(DrawSortEntry));
+}
+
+sf::Uint16 DrawQueue::GetPipelineId(vk::Pipeline pipeline)
+{
+	auto it = m_PipelineIds.find(pipeline);
+	if (it != m_PipelineIds.end())
+		return it->second;
+
+	sf::Uint16 id = (sf::Uint16)m_PipelineIds.size();
+	m_PipelineIds[pipeline] = id;
+	return id;
+}
+
+sf::Uint16 DrawQueue::GetTextureId(vk::DescriptorSet texture)
+{
+	if (!texture)
+		return 0;
+
+	auto it = m_TextureIds.find(texture);
+	if (it != m_TextureIds.end())
+		return it->second;
+
+	// Zero is reserved for untextured draws
+	sf::Uint16 id = (sf::Uint16)m_TextureIds.size() + 1;
+	m_TextureIds[texture] = id;
+	return id;
+}
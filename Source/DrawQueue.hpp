@@ -0,0 +1,81 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+struct DrawItem
+{
+	VulkanShader* Shader = {};
+	VulkanBuffer* VertexBuffer = {};
+	vk::DescriptorSet Texture = {};
+
+	sf::Uint32 Count = 0;
+	sf::Uint32 InstanceCount = 1;
+	sf::Uint32 FirstVertex = 0;
+	sf::Uint32 FirstInstance = 0;
+
+	sf::Uint8 Layer = 0;
+	bool Translucent = false;
+	float Depth = 0.0f; // Normalized [0, 1], 0 is closest to the camera
+};
+
+struct DrawSortEntry
+{
+	sf::Uint64 Key = 0;
+	sf::Uint32 Index = 0;
+};
+
+// Order of opaque draws, translucent draws are always sorted back to front
+enum class DrawSortMode
+{
+	StateFirst,	// Fewest pipeline & texture binds, depth only orders draws sharing state
+	DepthFirst	// Strictly front to back so early depth testing rejects the most fragments
+};
+
+// State changes issued by the last Flush()
+struct DrawQueueStats
+{
+	sf::Uint32 Draws = 0;
+	sf::Uint32 PipelineBinds = 0;
+	sf::Uint32 TextureBinds = 0;
+	sf::Uint32 VertexBufferBinds = 0;
+};
+
+// Collects draws for a frame, sorts them by a packed 64-bit key and emits them with minimal state changes.
+//
+// Key layout (most significant first):
+//   layer:8 | translucent:1 | opaque, StateFirst: pipeline:16 | texture:16 | depth:23 (front to back)
+//                           | opaque, DepthFirst: depth:23 (front to back) | pipeline:16 | texture:16
+//                           | translucent:        depth:24 (back to front) | pipeline:16 | texture:15
+class DrawQueue
+{
+public:
+	void Submit(const DrawItem& item);
+	void Flush();
+	void Clear();
+
+	// Applies to draws submitted afterwards
+	void SetSortMode(DrawSortMode sortMode);
+	DrawSortMode GetSortMode() const;
+
+	sf::Uint32 GetSize() const;
+	const DrawQueueStats& GetStats() const;
+
+	static sf::Uint64 MakeKey(sf::Uint8 layer, bool translucent, float depth, sf::Uint16 pipelineId, sf::Uint16 textureId, DrawSortMode sortMode = DrawSortMode::StateFirst);
+
+	// LSD radix sort on the key, 8 bits per pass; passes where every key has the same digit are skipped
+	static void Sort(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch);
+private:
+	sf::Uint16 GetPipelineId(vk::Pipeline pipeline);
+	sf::Uint16 GetTextureId(vk::DescriptorSet texture);
+private:
+	std::vector<DrawItem> m_Items = {};
+	std::vector<DrawSortEntry> m_Entries = {};
+	std::vector<DrawSortEntry> m_Scratch = {};
+	std::unordered_map<VkPipeline, sf::Uint16> m_PipelineIds = {};
+	std::unordered_map<VkDescriptorSet, sf::Uint16> m_TextureIds = {};
+	DrawQueueStats m_Stats = {};
+	DrawSortMode m_SortMode = DrawSortMode::StateFirst;
+};
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cmath>
+
+#include "DynamicResolution.hpp"
+
+// Relative error ignored so the resolution does not jitter around the target
+static constexpr double DEAD_BAND = 0.02;
+
+static DynamicResolutionSettings	s_Settings = {};
+static double						s_Area = 1.0;
+static double						s_PreviousError = 0.0;
+
+void DynamicResolution::Configure(const DynamicResolutionSettings& settings)
+{
+	s_Settings = settings;
+	s_Settings.MinScale = std::max(s_Settings.MinScale, 0.01f);
+	s_Settings.MaxScale = std::max(s_Settings.MaxScale, s_Settings.MinScale);
+	Reset();
+}
+
+const DynamicResolutionSettings& DynamicResolution::GetSettings()
+{
+	return s_Settings;
+}
+
+float DynamicResolution::Update(double gpuFrameTime)
+{
+	if (gpuFrameTime <= 0.0 || s_Settings.TargetFrameTime <= 0.0)
+		return GetScale();
+
+	// Positive when there is headroom left
+	double error = (s_Settings.TargetFrameTime - gpuFrameTime) / s_Settings.TargetFrameTime;
+	if (std::abs(error) < DEAD_BAND)
+		error = 0.0;
+
+	// Velocity form: clamping the output is all the anti windup needed
+	double change = s_Settings.ProportionalGain * (error - s_PreviousError) + s_Settings.IntegralGain * error;
+	s_PreviousError = error;
+
+	double minArea = (double)s_Settings.MinScale * s_Settings.MinScale;
+	double maxArea = (double)s_Settings.MaxScale * s_Settings.MaxScale;
+	s_Area = std::clamp(s_Area * (1.0 + change), minArea, maxArea);
+
+	return GetScale();
+}
+
+float DynamicResolution::GetScale()
+{
+	return (float)std::sqrt(s_Area);
+}
+
+void DynamicResolution::Reset()
+{
+	s_Area = (double)s_Settings.MaxScale * s_Settings.MaxScale;
+	s_PreviousError = 0.0;
+}
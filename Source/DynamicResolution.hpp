@@ -0,0 +1,28 @@
+#pragma once
+
+#include "RenderingDevice.hpp"
+
+struct DynamicResolutionSettings
+{
+	float MinScale = 0.5f;
+	float MaxScale = 1.0f;
+	double TargetFrameTime = 1000.0 / 60.0; // GPU time in ms
+	double ProportionalGain = 0.5;
+	double IntegralGain = 0.1;
+};
+
+// PI controller for the render scale, fed with the GPU time of the latest completed frame.
+// GPU time is assumed proportional to the pixel count, so the controller acts on the area (scale squared).
+class DynamicResolution
+{
+public:
+	static void Configure(const DynamicResolutionSettings& settings);
+	static const DynamicResolutionSettings& GetSettings();
+
+	static float Update(double gpuFrameTime);
+	static float GetScale();
+	static void Reset();
+private:
+	DynamicResolution();
+	DynamicResolution(const DynamicResolution&);
+};
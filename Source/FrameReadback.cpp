@@ -0,0 +1,538 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "BarrierTracker.hpp"
+#include "FrameReadback.hpp"
+#include "FrameScheduler.hpp"
+#include "Profiler.hpp"
+
+static constexpr sf::Uint32 READBACK_BUFFERS = 4;
+
+enum class SlotState
+{
+	Free,
+	Recorded,	// Copy submitted with the frame, waiting for its fence
+	Converting	// Worker reads the mapped memory
+};
+
+struct ReadbackRequest
+{
+	vk::Rect2D Region = {};
+	std::string FilePath = {}; // Screenshot when set
+	bool DropIfBusy = {};
+	std::promise<ReadbackImage> Image = {};
+	std::promise<bool> Saved = {};
+};
+
+struct ReadbackSlot
+{
+	vk::Buffer Buffer = {};
+	vk::DeviceMemory Memory = {};
+	vk::DeviceSize Capacity = {};
+	void* Data = {};
+	bool Coherent = {};
+
+	std::atomic<SlotState> State = { SlotState::Free };
+	sf::Uint32 FrameIndex = {};
+	vk::Extent2D Extent = {};
+	bool Bgra = {};
+	ReadbackRequest Request = {};
+};
+
+static bool										s_Initialized = {};
+static std::array<ReadbackSlot, READBACK_BUFFERS> s_Slots = {};
+static std::deque<ReadbackRequest>				s_Pending = {};
+static sf::Uint32								s_FrameIndex = {};
+
+// Single worker, jobs complete in request order
+static std::thread								s_Worker = {};
+static std::mutex								s_WorkerMutex = {};
+static std::condition_variable					s_WorkerCondition = {};
+static std::deque<std::function<void()>>		s_Jobs = {};
+static bool										s_WorkerStop = {};
+
+static void WorkerLoop()
+{
+	PROFILE_THREAD("Readback Worker");
+
+	while (true)
+	{
+		std::function<void()> job = {};
+		{
+			std::unique_lock<std::mutex> lock(s_WorkerMutex);
+			s_WorkerCondition.wait(lock, []() { return s_WorkerStop || !s_Jobs.empty(); });
+			if (s_Jobs.empty())
+				return;
+
+			job = std::move(s_Jobs.front());
+			s_Jobs.pop_front();
+		}
+
+		job();
+	}
+}
+
+static void PushJob(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_WorkerMutex);
+		s_Jobs.push_back(std::move(job));
+	}
+	s_WorkerCondition.notify_one();
+}
+
+static void Fail(ReadbackRequest& request)
+{
+	if (request.FilePath.empty())
+		request.Image.set_value({});
+	else
+		request.Saved.set_value(false);
+}
+
+// Host cached memory makes the CPU reads fast, plain host visible memory is the fallback
+static sf::Uint32 FindReadbackMemoryType(sf::Uint32 suitableTypes, bool& coherent)
+{
+	vk::PhysicalDeviceMemoryProperties memoryProperties = RenderingDevice::GetPhysicalDevice().getMemoryProperties();
+
+	const vk::MemoryPropertyFlags preferred[] = {
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached,
+		vk::MemoryPropertyFlagBits::eHostVisible
+	};
+
+	for (vk::MemoryPropertyFlags properties : preferred)
+	{
+		for (sf::Uint32 i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			vk::MemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+			if (suitableTypes & (1 << i) && (flags & properties) == properties)
+			{
+				coherent = (bool)(flags & vk::MemoryPropertyFlagBits::eHostCoherent);
+				return i;
+			}
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static void DestroySlotBuffer(ReadbackSlot& slot)
+{
+	if (!slot.Buffer)
+		return;
+
+	vk::Device device = RenderingDevice::GetDevice();
+	device.unmapMemory(slot.Memory);
+	device.destroyBuffer(slot.Buffer);
+	device.freeMemory(slot.Memory);
+
+	FrameStats stats = {};
+	stats.Frees = 1;
+	RenderingDevice::AddFrameStats(stats);
+
+	slot.Buffer = nullptr;
+	slot.Memory = nullptr;
+	slot.Data = nullptr;
+	slot.Capacity = 0;
+}
+
+// Buffers only grow, a free slot is never in use by the GPU so it can be replaced right away
+static bool EnsureSlotCapacity(ReadbackSlot& slot, vk::DeviceSize size)
+{
+	if (slot.Capacity >= size)
+		return true;
+
+	DestroySlotBuffer(slot);
+
+	vk::Device device = RenderingDevice::GetDevice();
+	slot.Buffer = device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(), size, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive));
+
+	vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(slot.Buffer);
+	sf::Uint32 memoryType = FindReadbackMemoryType(requirements.memoryTypeBits, slot.Coherent);
+	if (memoryType == UINT32_MAX)
+	{
+		device.destroyBuffer(slot.Buffer);
+		slot.Buffer = nullptr;
+		return false;
+	}
+
+	slot.Memory = device.allocateMemory(vk::MemoryAllocateInfo(requirements.size, memoryType));
+	device.bindBufferMemory(slot.Buffer, slot.Memory, 0);
+	slot.Data = device.mapMemory(slot.Memory, 0, vk::WholeSize);
+	slot.Capacity = size;
+
+	FrameStats stats = {};
+	stats.Allocations = 1;
+	RenderingDevice::AddFrameStats(stats);
+
+	return true;
+}
+
+static void ResolveSlot(ReadbackSlot& slot)
+{
+	if (!slot.Coherent)
+		RenderingDevice::GetDevice().invalidateMappedMemoryRanges(vk::MappedMemoryRange(slot.Memory, 0, vk::WholeSize));
+
+	slot.State = SlotState::Converting;
+	FrameScheduler::EndAnimation();
+
+	PushJob([&slot]()
+	{
+		PROFILE_SCOPE("ResolveReadback");
+
+		ReadbackImage image = {};
+		image.Size = sf::Vector2u(slot.Extent.width, slot.Extent.height);
+		image.Pixels.resize((size_t)slot.Extent.width * slot.Extent.height * 4);
+
+		const sf::Uint8* source = static_cast<const sf::Uint8*>(slot.Data);
+		if (slot.Bgra)
+			FrameReadback::ConvertBgraToRgba(source, image.Pixels.data(), image.Pixels.size() / 4);
+		else
+			std::memcpy(image.Pixels.data(), source, image.Pixels.size());
+
+		// Mapped memory is no longer read, the slot can take the next copy while encoding
+		ReadbackRequest request = std::move(slot.Request);
+		slot.State = SlotState::Free;
+
+		if (request.FilePath.empty())
+			request.Image.set_value(std::move(image));
+		else
+			request.Saved.set_value(FrameReadback::WritePng(request.FilePath, image));
+	});
+}
+
+void FrameReadback::Initialize(sf::Uint32 framesInFlight)
+{
+	// Slots are recycled by state, the ring only has to outlast the frames in flight
+	assert(READBACK_BUFFERS >= framesInFlight);
+
+	s_WorkerStop = false;
+	s_Worker = std::thread(WorkerLoop);
+	s_Initialized = true;
+}
+
+void FrameReadback::Terminate()
+{
+	if (!s_Initialized)
+		return;
+
+	// Device is idle, every recorded copy is complete
+	for (ReadbackSlot& slot : s_Slots)
+	{
+		if (slot.State == SlotState::Recorded)
+			ResolveSlot(slot);
+	}
+
+	for (ReadbackRequest& request : s_Pending)
+		Fail(request);
+	s_Pending.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(s_WorkerMutex);
+		s_WorkerStop = true;
+	}
+	s_WorkerCondition.notify_one();
+	s_Worker.join();
+
+	for (ReadbackSlot& slot : s_Slots)
+		DestroySlotBuffer(slot);
+
+	s_Initialized = false;
+}
+
+void FrameReadback::Flush()
+{
+	PROFILE_FUNCTION();
+
+	RenderingDevice::GetDevice().waitIdle();
+
+	for (ReadbackSlot& slot : s_Slots)
+	{
+		if (slot.State == SlotState::Recorded)
+			ResolveSlot(slot);
+	}
+}
+
+void FrameReadback::BeginFrame(sf::Uint32 frameIndex)
+{
+	s_FrameIndex = frameIndex;
+
+	for (ReadbackSlot& slot : s_Slots)
+	{
+		if (slot.State == SlotState::Recorded && slot.FrameIndex == frameIndex)
+			ResolveSlot(slot);
+	}
+}
+
+void FrameReadback::EndFrame(vk::CommandBuffer commandBuffer, vk::Image image, vk::Extent2D extent, vk::Format format)
+{
+	if (s_Pending.empty())
+		return;
+
+	PROFILE_FUNCTION();
+
+	// Image was not created with transfer source usage
+	if (!image)
+	{
+		for (ReadbackRequest& request : s_Pending)
+			Fail(request);
+		s_Pending.clear();
+		return;
+	}
+
+	bool transitioned = false;
+
+	// Requests that find no free slot wait for the next frame instead of stalling, or are dropped when they asked to
+	std::deque<ReadbackRequest> deferred = {};
+	size_t nextSlot = 0;
+
+	for (ReadbackRequest& request : s_Pending)
+	{
+		while (nextSlot < s_Slots.size() && s_Slots[nextSlot].State != SlotState::Free)
+			nextSlot++;
+
+		if (nextSlot == s_Slots.size())
+		{
+			if (request.DropIfBusy)
+				Fail(request);
+			else
+				deferred.push_back(std::move(request));
+			continue;
+		}
+
+		ReadbackSlot& slot = s_Slots[nextSlot];
+
+		// Clamp the region to the image, an empty region means all of it
+		vk::Rect2D region = request.Region;
+		if (region.extent.width == 0 || region.extent.height == 0)
+			region = vk::Rect2D(vk::Offset2D(0, 0), extent);
+
+		region.offset.x = std::min(std::max(region.offset.x, 0), (sf::Int32)extent.width);
+		region.offset.y = std::min(std::max(region.offset.y, 0), (sf::Int32)extent.height);
+		region.extent.width = std::min(region.extent.width, extent.width - region.offset.x);
+		region.extent.height = std::min(region.extent.height, extent.height - region.offset.y);
+
+		vk::DeviceSize size = (vk::DeviceSize)region.extent.width * region.extent.height * 4;
+		if (size == 0 || !EnsureSlotCapacity(slot, size))
+		{
+			Fail(request);
+			continue;
+		}
+
+		// The device transitions the image on to presentation afterwards
+		if (!transitioned)
+		{
+			BarrierTracker::TransitionImage(image, ResourceUsage::TransferSrc);
+			BarrierTracker::Flush(commandBuffer);
+			transitioned = true;
+		}
+
+		vk::BufferImageCopy copy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(region.offset.x, region.offset.y, 0), vk::Extent3D(region.extent.width, region.extent.height, 1));
+		commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, slot.Buffer, copy);
+
+		slot.Request = std::move(request);
+		slot.FrameIndex = s_FrameIndex;
+		slot.Extent = region.extent;
+		slot.Bgra = format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eB8G8R8A8Unorm;
+		slot.State = SlotState::Recorded;
+
+		// Resolved by the BeginFrame reusing the frame index, frames have to keep coming until then
+		FrameScheduler::BeginAnimation();
+	}
+
+	s_Pending = std::move(deferred);
+	if (!s_Pending.empty())
+		FrameScheduler::Invalidate();
+
+	if (!transitioned)
+		return;
+
+	// Copies become visible to the host once the frame fence signals
+	vk::MemoryBarrier toHost(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), toHost, nullptr, nullptr);
+
+	FrameStats stats = {};
+	stats.Barriers = 1;
+	RenderingDevice::AddFrameStats(stats);
+}
+
+std::future<ReadbackImage> FrameReadback::RequestReadback(vk::Rect2D region, bool dropIfBusy)
+{
+	ReadbackRequest request = {};
+	request.Region = region;
+	request.DropIfBusy = dropIfBusy;
+
+	std::future<ReadbackImage> future = request.Image.get_future();
+	// Copied from the next rendered frame, which has to come even when nothing changed
+	if (s_Initialized)
+	{
+		s_Pending.push_back(std::move(request));
+		FrameScheduler::Invalidate();
+	}
+	else
+		Fail(request);
+
+	return future;
+}
+
+std::future<bool> FrameReadback::RequestScreenshot(const std::string& filePath, vk::Rect2D region)
+{
+	ReadbackRequest request = {};
+	request.Region = region;
+	request.FilePath = filePath;
+
+	std::future<bool> future = request.Saved.get_future();
+	if (s_Initialized)
+	{
+		s_Pending.push_back(std::move(request));
+		FrameScheduler::Invalidate();
+	}
+	else
+		Fail(request);
+
+	return future;
+}
+
+void FrameReadback::ConvertBgraToRgba(const sf::Uint8* source, sf::Uint8* destination, size_t pixelCount)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	// Swap bytes 0 and 2 of every pixel, 4 pixels per iteration
+	const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i low = _mm_set1_epi32(0x000000FF);
+
+	for (; i + 4 <= pixelCount; i += 4)
+	{
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+		__m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), low);
+		__m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, low), 16);
+		__m128i result = _mm_or_si128(_mm_and_si128(pixels, greenAlpha), _mm_or_si128(red, blue));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), result);
+	}
+#endif
+
+	for (; i < pixelCount; i++)
+	{
+		destination[i * 4 + 0] = source[i * 4 + 2];
+		destination[i * 4 + 1] = source[i * 4 + 1];
+		destination[i * 4 + 2] = source[i * 4 + 0];
+		destination[i * 4 + 3] = source[i * 4 + 3];
+	}
+}
+
+static sf::Uint32 Crc32(sf::Uint32 crc, const sf::Uint8* data, size_t size)
+{
+	static const std::array<sf::Uint32, 256> table = []()
+	{
+		std::array<sf::Uint32, 256> values = {};
+		for (sf::Uint32 i = 0; i < 256; i++)
+		{
+			sf::Uint32 value = i;
+			for (sf::Uint32 bit = 0; bit < 8; bit++)
+				value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+			values[i] = value;
+		}
+		return values;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void AppendBigEndian(std::vector<sf::Uint8>& output, sf::Uint32 value)
+{
+	output.push_back((sf::Uint8)(value >> 24));
+	output.push_back((sf::Uint8)(value >> 16));
+	output.push_back((sf::Uint8)(value >> 8));
+	output.push_back((sf::Uint8)value);
+}
+
+static void WriteChunk(std::ofstream& file, const char type[4], const std::vector<sf::Uint8>& data)
+{
+	std::vector<sf::Uint8> chunk = {};
+	AppendBigEndian(chunk, (sf::Uint32)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	AppendBigEndian(chunk, Crc32(0, chunk.data() + 4, chunk.size() - 4));
+
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+// Screenshots favour encoding speed: the zlib stream uses stored (uncompressed) deflate blocks
+bool FrameReadback::WritePng(const std::string& filePath, const ReadbackImage& image)
+{
+	PROFILE_FUNCTION();
+
+	if (image.Pixels.empty())
+		return false;
+
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	static const sf::Uint8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<sf::Uint8> header = {};
+	AppendBigEndian(header, image.Size.x);
+	AppendBigEndian(header, image.Size.y);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, deflate, no interlace
+	WriteChunk(file, "IHDR", header);
+
+	// Every row starts with filter type 0
+	size_t rowSize = (size_t)image.Size.x * 4;
+	std::vector<sf::Uint8> raw = {};
+	raw.reserve((rowSize + 1) * image.Size.y);
+	for (sf::Uint32 y = 0; y < image.Size.y; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), image.Pixels.begin() + y * rowSize, image.Pixels.begin() + (y + 1) * rowSize);
+	}
+
+	static constexpr size_t MAX_STORED_BLOCK = 65535;
+
+	std::vector<sf::Uint8> data = { 0x78, 0x01 };
+	data.reserve(raw.size() + raw.size() / MAX_STORED_BLOCK * 5 + 16);
+
+	sf::Uint32 adlerA = 1;
+	sf::Uint32 adlerB = 0;
+	for (size_t offset = 0; offset < raw.size(); offset += MAX_STORED_BLOCK)
+	{
+		size_t size = std::min(MAX_STORED_BLOCK, raw.size() - offset);
+		bool last = offset + size >= raw.size();
+
+		data.push_back(last ? 1 : 0);
+		data.push_back((sf::Uint8)size);
+		data.push_back((sf::Uint8)(size >> 8));
+		data.push_back((sf::Uint8)~size);
+		data.push_back((sf::Uint8)(~size >> 8));
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+		for (size_t i = offset; i < offset + size; i++)
+		{
+			adlerA = (adlerA + raw[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+	}
+	AppendBigEndian(data, (adlerB << 16) | adlerA);
+
+	WriteChunk(file, "IDAT", data);
+	WriteChunk(file, "IEND", {});
+
+	return (bool)file;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+struct ReadbackImage
+{
+	sf::Vector2u Size = {};
+	std::vector<sf::Uint8> Pixels = {}; // RGBA8, rows top to bottom, empty when the readback failed
+};
+
+// Copies regions of the swapchain image into a ring of persistently mapped host cached buffers at the end of
+// the frame. Results are picked up once the frame's fence signalled (MAX_FRAMES_IN_FLIGHT frames later), so
+// nothing ever waits on the GPU. Swizzling and PNG encoding run on a worker thread.
+// Requests are made from the main thread; an empty region reads the whole image.
+class FrameReadback
+{
+public:
+	static void Initialize(sf::Uint32 framesInFlight);
+	static void Terminate();
+
+	// Called by RenderingDevice after the frame fence was waited on / before the frame's command buffer ends
+	static void BeginFrame(sf::Uint32 frameIndex);
+	static void EndFrame(vk::CommandBuffer commandBuffer, vk::Image image, vk::Extent2D extent, vk::Format format);
+
+	// Busy means every buffer of the ring is in use, the future then resolves empty right away
+	static std::future<ReadbackImage> RequestReadback(vk::Rect2D region = {}, bool dropIfBusy = false);
+	static std::future<bool> RequestScreenshot(const std::string& filePath, vk::Rect2D region = {});
+
+	// Waits for the device so every recorded copy resolves without further frames, for shutdown paths
+	static void Flush();
+
+	static void ConvertBgraToRgba(const sf::Uint8* source, sf::Uint8* destination, size_t pixelCount);
+	static bool WritePng(const std::string& filePath, const ReadbackImage& image);
+private:
+	FrameReadback();
+	FrameReadback(const FrameReadback&);
+};
@@ -0,0 +1,179 @@
+#include <atomic>
+
+#include "FrameScheduler.hpp"
+#include "Profiler.hpp"
+
+// Only bounds how late an invalidation from another thread is noticed while idle on demand
+static const sf::Time IDLE_POLL_INTERVAL = sf::milliseconds(10);
+
+static sf::WindowBase*			s_Window = nullptr;
+static RedrawMode				s_RedrawMode = RedrawMode::Continuous;
+static sf::Time					s_IdleTimeout = sf::milliseconds(250);
+static bool						s_PauseWhenUnfocused = true;
+
+static std::atomic<bool>		s_Invalidated = true;
+static std::atomic<sf::Int32>	s_Animations = 0;
+
+static bool						s_Focused = true;
+static bool						s_Minimized = false;
+
+static sf::Uint64				s_RenderedFrames = {};
+static sf::Uint64				s_SkippedWakeups = {};
+
+void FrameScheduler::Initialize(sf::WindowBase* window)
+{
+	s_Window = window;
+	s_Focused = window->hasFocus();
+	s_Invalidated = true;
+}
+
+void FrameScheduler::SetRedrawMode(RedrawMode mode)
+{
+	s_RedrawMode = mode;
+	Invalidate();
+}
+
+RedrawMode FrameScheduler::GetRedrawMode()
+{
+	return s_RedrawMode;
+}
+
+void FrameScheduler::SetIdleTimeout(sf::Time timeout)
+{
+	s_IdleTimeout = timeout;
+}
+
+void FrameScheduler::SetPauseWhenUnfocused(bool pause)
+{
+	s_PauseWhenUnfocused = pause;
+	Invalidate();
+}
+
+void FrameScheduler::Invalidate()
+{
+	s_Invalidated.store(true, std::memory_order_relaxed);
+}
+
+void FrameScheduler::BeginAnimation()
+{
+	s_Animations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameScheduler::EndAnimation()
+{
+	// The last animated frame has to be followed by one showing the final state
+	s_Animations.fetch_sub(1, std::memory_order_relaxed);
+	Invalidate();
+}
+
+bool FrameScheduler::IsPaused()
+{
+	// Win32 sends no resize event when minimizing, the client area just becomes empty
+	if (s_Window)
+	{
+		sf::Vector2u size = s_Window->getSize();
+		bool minimized = size.x == 0 || size.y == 0;
+		if (s_Minimized && !minimized)
+			Invalidate();
+		s_Minimized = minimized;
+	}
+
+	return s_Minimized || (s_PauseWhenUnfocused && !s_Focused);
+}
+
+bool FrameScheduler::IsFramePending()
+{
+	if (IsPaused())
+		return false;
+
+	if (s_RedrawMode == RedrawMode::Continuous)
+		return true;
+
+	return s_Invalidated.load(std::memory_order_relaxed) || s_Animations.load(std::memory_order_relaxed) > 0;
+}
+
+bool FrameScheduler::PollEvent(sf::WindowBase& window, sf::Event& event)
+{
+	PROFILE_FUNCTION();
+
+	if (window.pollEvent(event))
+	{
+		HandleEvent(event);
+		return true;
+	}
+
+	if (!window.isOpen() || IsFramePending())
+		return false;
+
+	// Nothing renders until an event resumes the window, invalidations made meanwhile are seen afterwards
+	if (IsPaused())
+	{
+		PROFILE_SCOPE("Paused");
+
+		if (!window.waitEvent(event))
+			return false;
+
+		HandleEvent(event);
+		return true;
+	}
+
+	PROFILE_SCOPE("Idle");
+
+	sf::Clock clock;
+	while (clock.getElapsedTime() < s_IdleTimeout)
+	{
+		sf::sleep(IDLE_POLL_INTERVAL);
+
+		if (window.pollEvent(event))
+		{
+			HandleEvent(event);
+			return true;
+		}
+
+		// Invalidated by another thread
+		if (IsFramePending())
+			return false;
+	}
+
+	s_SkippedWakeups++;
+	return false;
+}
+
+bool FrameScheduler::ShouldRenderFrame()
+{
+	if (!IsFramePending())
+		return false;
+
+	s_Invalidated.store(false, std::memory_order_relaxed);
+	s_RenderedFrames++;
+	return true;
+}
+
+sf::Uint64 FrameScheduler::GetRenderedFrames()
+{
+	return s_RenderedFrames;
+}
+
+sf::Uint64 FrameScheduler::GetSkippedWakeups()
+{
+	return s_SkippedWakeups;
+}
+
+void FrameScheduler::HandleEvent(const sf::Event& event)
+{
+	switch (event.type)
+	{
+	case sf::Event::Resized:
+		Invalidate();
+		break;
+	case sf::Event::LostFocus:
+		s_Focused = false;
+		break;
+	case sf::Event::GainedFocus:
+		s_Focused = true;
+		Invalidate();
+		break;
+	default:
+		break;
+	}
+}
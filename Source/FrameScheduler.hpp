@@ -0,0 +1,50 @@
+#pragma once
+
+#include <SFML/Window.hpp>
+
+enum class RedrawMode
+{
+	Continuous,		// A frame every loop iteration, paced by present only
+	OnDemand		// A frame only after an Invalidate() or while an animation runs
+};
+
+// Decides when the main loop renders. Subsystems call Invalidate() when what they show changed and
+// Begin/EndAnimation() around anything that has to advance every frame. Rendering pauses entirely while
+// the window is minimized (zero extent) or, unless disabled, unfocused; idle waits block in PollEvent.
+// RenderingDevice does not know about the scheduler, code adding damage between frames invalidates as well.
+class FrameScheduler
+{
+public:
+	static void Initialize(sf::WindowBase* window);
+
+	static void SetRedrawMode(RedrawMode mode);
+	static RedrawMode GetRedrawMode();
+
+	// How long PollEvent blocks at most on demand before returning to the loop without an event
+	static void SetIdleTimeout(sf::Time timeout);
+	static void SetPauseWhenUnfocused(bool pause);
+
+	// Thread safe, several invalidations before the next frame render it once
+	static void Invalidate();
+	static void BeginAnimation();
+	static void EndAnimation();
+
+	static bool IsPaused();
+	static bool IsFramePending();
+
+	// Like sf::WindowBase::pollEvent, but blocks while no frame is pending. While paused it waits for the next event,
+	// idle on demand the window is polled with short sleeps instead (SFML 2 has no waitEvent with a timeout).
+	// Returns false once a frame is pending or the timeout passed.
+	static bool PollEvent(sf::WindowBase& window, sf::Event& event);
+
+	// Consumes the pending invalidation, invalidations made while the frame records schedule the next one
+	static bool ShouldRenderFrame();
+
+	static sf::Uint64 GetRenderedFrames();
+	static sf::Uint64 GetSkippedWakeups();
+private:
+	FrameScheduler();
+	FrameScheduler(const FrameScheduler&);
+
+	static void HandleEvent(const sf::Event& event);
+};
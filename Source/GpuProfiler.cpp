@@ -0,0 +1,214 @@
+#include <cassert>
+
+#include "GpuProfiler.hpp"
+#include "Profiler.hpp"
+
+static constexpr sf::Uint32 MAX_QUERIES_PER_FRAME = 512;
+
+struct PendingScope
+{
+	const char* Name = {};
+	sf::Uint32 Depth = {};
+	sf::Uint32 BeginQuery = {};
+	sf::Uint32 EndQuery = UINT32_MAX;
+};
+
+struct ProfilerFrame
+{
+	vk::QueryPool QueryPool = {};
+	sf::Uint32 QueryCount = {};
+	std::vector<PendingScope> Scopes = {};
+	sf::Uint64 FrameNumber = {};
+	sf::Uint64 CpuTime = {};
+};
+
+static bool							s_Supported = {};
+static double						s_TimestampPeriod = {};
+static sf::Uint64					s_TimestampMask = {};
+static std::vector<ProfilerFrame>	s_Frames = {};
+static sf::Uint32					s_FrameIndex = {};
+static sf::Uint64					s_FrameNumber = {};
+static vk::CommandBuffer			s_CommandBuffer = {};
+static std::vector<sf::Uint32>		s_ScopeStack = {};
+
+static std::vector<GpuScopeResult>	s_Results = {};
+static double						s_FrameTime = {};
+static sf::Uint64					s_ResultsFrameNumber = {};
+static sf::Uint64					s_ResultsCpuTime = {};
+
+void GpuProfiler::Initialize(sf::Uint32 framesInFlight, sf::Uint32 queueFamilyIndex)
+{
+	vk::PhysicalDevice physicalDevice = RenderingDevice::GetPhysicalDevice();
+
+	sf::Uint32 validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+	s_Supported = validBits > 0;
+	if (!s_Supported)
+		return;
+
+	s_TimestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+	s_TimestampMask = validBits >= 64 ? UINT64_MAX : (((sf::Uint64)1 << validBits) - 1);
+
+	vk::QueryPoolCreateInfo queryPoolCreateInfo(vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, MAX_QUERIES_PER_FRAME);
+
+	s_Frames.resize(framesInFlight);
+	for (ProfilerFrame& frame : s_Frames)
+		frame.QueryPool = RenderingDevice::GetDevice().createQueryPool(queryPoolCreateInfo);
+}
+
+void GpuProfiler::Terminate()
+{
+	for (ProfilerFrame& frame : s_Frames)
+		RenderingDevice::GetDevice().destroyQueryPool(frame.QueryPool);
+
+	s_Frames.clear();
+	s_Results.clear();
+	s_Supported = false;
+}
+
+void GpuProfiler::BeginFrame(sf::Uint32 frameIndex, vk::CommandBuffer commandBuffer)
+{
+	if (!s_Supported)
+		return;
+
+	s_FrameIndex = frameIndex;
+	s_CommandBuffer = commandBuffer;
+
+	// The frame fence was waited on, so the previous use of this pool is complete
+	ReadResults(frameIndex);
+
+	ProfilerFrame& frame = s_Frames[frameIndex];
+	commandBuffer.resetQueryPool(frame.QueryPool, 0, MAX_QUERIES_PER_FRAME);
+	frame.QueryCount = 0;
+	frame.Scopes.clear();
+	frame.FrameNumber = s_FrameNumber++;
+	frame.CpuTime = Profiler::GetTime();
+
+	s_ScopeStack.clear();
+	BeginScope("Frame");
+}
+
+void GpuProfiler::EndFrame(vk::CommandBuffer commandBuffer)
+{
+	if (!s_Supported)
+		return;
+
+	// Close anything left open so every query gets written
+	while (!s_ScopeStack.empty())
+		EndScope();
+
+	s_CommandBuffer = nullptr;
+}
+
+void GpuProfiler::BeginScope(const char* name)
+{
+	if (!s_Supported || !s_CommandBuffer)
+		return;
+
+	ProfilerFrame& frame = s_Frames[s_FrameIndex];
+
+	// Every recorded scope still open owes an end query, reserve those before taking two more
+	sf::Uint32 openScopes = 0;
+	for (sf::Uint32 scopeIndex : s_ScopeStack)
+		openScopes += scopeIndex != UINT32_MAX ? 1 : 0;
+
+	// Out of queries, keep the stack balanced but do not record
+	if (frame.QueryCount + openScopes + 2 > MAX_QUERIES_PER_FRAME)
+	{
+		s_ScopeStack.push_back(UINT32_MAX);
+		return;
+	}
+
+	PendingScope scope = {};
+	scope.Name = name;
+	scope.Depth = (sf::Uint32)s_ScopeStack.size();
+	scope.BeginQuery = frame.QueryCount++;
+
+	s_CommandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.QueryPool, scope.BeginQuery);
+
+	s_ScopeStack.push_back((sf::Uint32)frame.Scopes.size());
+	frame.Scopes.push_back(scope);
+}
+
+void GpuProfiler::EndScope()
+{
+	if (!s_Supported || !s_CommandBuffer || s_ScopeStack.empty())
+		return;
+
+	sf::Uint32 scopeIndex = s_ScopeStack.back();
+	s_ScopeStack.pop_back();
+
+	if (scopeIndex == UINT32_MAX)
+		return;
+
+	ProfilerFrame& frame = s_Frames[s_FrameIndex];
+	PendingScope& scope = frame.Scopes[scopeIndex];
+	scope.EndQuery = frame.QueryCount++;
+
+	s_CommandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.QueryPool, scope.EndQuery);
+}
+
+bool GpuProfiler::IsSupported()
+{
+	return s_Supported;
+}
+
+const std::vector<GpuScopeResult>& GpuProfiler::GetResults()
+{
+	return s_Results;
+}
+
+double GpuProfiler::GetFrameTime()
+{
+	return s_FrameTime;
+}
+
+sf::Uint64 GpuProfiler::GetResultsFrameNumber()
+{
+	return s_ResultsFrameNumber;
+}
+
+sf::Uint64 GpuProfiler::GetResultsCpuTime()
+{
+	return s_ResultsCpuTime;
+}
+
+void GpuProfiler::ReadResults(sf::Uint32 frameIndex)
+{
+	ProfilerFrame& frame = s_Frames[frameIndex];
+	if (frame.QueryCount == 0)
+		return;
+
+	// Value & availability per query, never waits
+	vk::QueryResultFlags flags = vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability;
+	std::vector<sf::Uint64> data(frame.QueryCount * 2);
+	vk::Result result = RenderingDevice::GetDevice().getQueryPoolResults(frame.QueryPool, 0, frame.QueryCount, data.size() * sizeof(sf::Uint64), data.data(), 2 * sizeof(sf::Uint64), flags);
+	if (result != vk::Result::eSuccess && result != vk::Result::eNotReady)
+		return;
+
+	auto available = [&](sf::Uint32 query) { return data[query * 2 + 1] != 0; };
+	auto timestamp = [&](sf::Uint32 query) { return data[query * 2] & s_TimestampMask; };
+
+	// Keep the previous results if this frame is incomplete
+	for (const PendingScope& scope : frame.Scopes)
+	{
+		if (scope.EndQuery == UINT32_MAX || !available(scope.BeginQuery) || !available(scope.EndQuery))
+			return;
+	}
+
+	sf::Uint64 frameStart = timestamp(frame.Scopes.front().BeginQuery);
+
+	s_Results.clear();
+	for (const PendingScope& scope : frame.Scopes)
+	{
+		GpuScopeResult scopeResult = {};
+		scopeResult.Name = scope.Name;
+		scopeResult.Depth = scope.Depth;
+		scopeResult.BeginMs = ((timestamp(scope.BeginQuery) - frameStart) & s_TimestampMask) * s_TimestampPeriod / 1000000.0;
+		scopeResult.DurationMs = ((timestamp(scope.EndQuery) - timestamp(scope.BeginQuery)) & s_TimestampMask) * s_TimestampPeriod / 1000000.0;
+		s_Results.push_back(scopeResult);
+	}
+
+	s_FrameTime = s_Results.front().DurationMs;
+	s_ResultsFrameNumber = frame.FrameNumber;
+	s_ResultsCpuTime = frame.CpuTime;
+}
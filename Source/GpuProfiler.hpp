@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+struct GpuScopeResult
+{
+	std::string Name = {};
+	sf::Uint32 Depth = 0;
+	double BeginMs = 0.0; // Relative to the start of the frame
+	double DurationMs = 0.0;
+};
+
+// Timestamp queries around named scopes, one query pool per frame in flight.
+// Results of a frame are read back when its fence has signalled, so reading never stalls.
+// Scopes are recorded into the main thread's command buffer and must be opened outside secondary command buffers.
+class GpuProfiler
+{
+public:
+	static void Initialize(sf::Uint32 framesInFlight, sf::Uint32 queueFamilyIndex);
+	static void Terminate();
+
+	// Called by RenderingDevice with the frame's command buffer right after it began / before it ends
+	static void BeginFrame(sf::Uint32 frameIndex, vk::CommandBuffer commandBuffer);
+	static void EndFrame(vk::CommandBuffer commandBuffer);
+
+	static void BeginScope(const char* name);
+	static void EndScope();
+
+	static bool IsSupported();
+
+	// Latest frame with complete results, scopes in the order they were opened
+	static const std::vector<GpuScopeResult>& GetResults();
+	static double GetFrameTime();
+	static sf::Uint64 GetResultsFrameNumber();
+
+	// Profiler::GetTime() when the CPU began recording the frame the results belong to
+	static sf::Uint64 GetResultsCpuTime();
+private:
+	GpuProfiler();
+	GpuProfiler(const GpuProfiler&);
+
+	static void ReadResults(sf::Uint32 frameIndex);
+};
+
+struct GpuScope
+{
+	GpuScope(const char* name) { GpuProfiler::BeginScope(name); }
+	~GpuScope() { GpuProfiler::EndScope(); }
+};
+
+#define GPU_SCOPE_CONCAT_INNER(a, b) a##b
+#define GPU_SCOPE_CONCAT(a, b) GPU_SCOPE_CONCAT_INNER(a, b)
+#define GPU_SCOPE(name) GpuScope GPU_SCOPE_CONCAT(gpuScope, __LINE__)(name)
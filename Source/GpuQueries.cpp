@@ -0,0 +1,241 @@
+#include <cassert>
+#include <unordered_map>
+
+#include "GpuQueries.hpp"
+
+static constexpr sf::Uint32 MAX_STATISTICS_QUERIES_PER_FRAME = 64;
+static constexpr sf::Uint32 MAX_OCCLUSION_QUERIES_PER_FRAME = 4096;
+
+// Counters written per query, in the order of the flag bits, followed by availability
+static constexpr sf::Uint32 STATISTICS_COUNTERS = 6;
+
+static const vk::QueryPipelineStatisticFlags STATISTICS_FLAGS =
+	vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+	vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+	vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+	vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+	vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+	vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+struct QueryFrame
+{
+	vk::QueryPool StatisticsPool = {};
+	vk::QueryPool OcclusionPool = {};
+	std::vector<const char*> StatisticsNames = {};
+	std::vector<sf::Uint32> OcclusionIds = {};
+	sf::Uint64 FrameNumber = {};
+};
+
+static bool										s_StatisticsSupported = {};
+static bool										s_PreciseOcclusionSupported = {};
+static std::vector<QueryFrame>					s_Frames = {};
+static sf::Uint32								s_FrameIndex = {};
+static sf::Uint64								s_FrameNumber = {};
+static vk::CommandBuffer						s_CommandBuffer = {};
+static bool										s_StatisticsActive = {};
+static bool										s_OcclusionActive = {};
+
+static std::vector<PipelineStatisticsResult>	s_StatisticsResults = {};
+static std::unordered_map<sf::Uint32, OcclusionResult> s_OcclusionResults = {};
+
+void GpuQueries::Initialize(sf::Uint32 framesInFlight)
+{
+	const vk::PhysicalDeviceFeatures& features = RenderingDevice::GetEnabledFeatures();
+	s_StatisticsSupported = features.pipelineStatisticsQuery;
+	s_PreciseOcclusionSupported = features.occlusionQueryPrecise;
+
+	vk::Device device = RenderingDevice::GetDevice();
+	vk::QueryPoolCreateInfo statisticsCreateInfo(vk::QueryPoolCreateFlags(), vk::QueryType::ePipelineStatistics, MAX_STATISTICS_QUERIES_PER_FRAME, STATISTICS_FLAGS);
+	vk::QueryPoolCreateInfo occlusionCreateInfo(vk::QueryPoolCreateFlags(), vk::QueryType::eOcclusion, MAX_OCCLUSION_QUERIES_PER_FRAME);
+
+	s_Frames.resize(framesInFlight);
+	for (QueryFrame& frame : s_Frames)
+	{
+		if (s_StatisticsSupported)
+			frame.StatisticsPool = device.createQueryPool(statisticsCreateInfo);
+		frame.OcclusionPool = device.createQueryPool(occlusionCreateInfo);
+	}
+}
+
+void GpuQueries::Terminate()
+{
+	vk::Device device = RenderingDevice::GetDevice();
+	for (QueryFrame& frame : s_Frames)
+	{
+		if (frame.StatisticsPool)
+			device.destroyQueryPool(frame.StatisticsPool);
+		device.destroyQueryPool(frame.OcclusionPool);
+	}
+
+	s_Frames.clear();
+	s_StatisticsResults.clear();
+	s_OcclusionResults.clear();
+}
+
+void GpuQueries::BeginFrame(sf::Uint32 frameIndex, vk::CommandBuffer commandBuffer)
+{
+	if (s_Frames.empty())
+		return;
+
+	s_FrameIndex = frameIndex;
+	s_CommandBuffer = commandBuffer;
+
+	// Results of the frame that last used this slot, the pools are reset for reuse right after
+	ReadResults(frameIndex);
+
+	QueryFrame& frame = s_Frames[frameIndex];
+	if (frame.StatisticsPool)
+		commandBuffer.resetQueryPool(frame.StatisticsPool, 0, MAX_STATISTICS_QUERIES_PER_FRAME);
+	commandBuffer.resetQueryPool(frame.OcclusionPool, 0, MAX_OCCLUSION_QUERIES_PER_FRAME);
+
+	frame.StatisticsNames.clear();
+	frame.OcclusionIds.clear();
+	frame.FrameNumber = s_FrameNumber++;
+}
+
+void GpuQueries::EndFrame(vk::CommandBuffer commandBuffer)
+{
+	if (s_StatisticsActive)
+		EndStatistics();
+	if (s_OcclusionActive)
+		EndOcclusion();
+
+	s_CommandBuffer = nullptr;
+}
+
+void GpuQueries::BeginStatistics(const char* name)
+{
+	if (!s_StatisticsSupported || !s_CommandBuffer)
+		return;
+
+	assert(!s_StatisticsActive);
+
+	QueryFrame& frame = s_Frames[s_FrameIndex];
+	if (frame.StatisticsNames.size() == MAX_STATISTICS_QUERIES_PER_FRAME)
+		return;
+
+	s_CommandBuffer.beginQuery(frame.StatisticsPool, (sf::Uint32)frame.StatisticsNames.size(), vk::QueryControlFlags());
+	frame.StatisticsNames.push_back(name);
+	s_StatisticsActive = true;
+}
+
+void GpuQueries::EndStatistics()
+{
+	if (!s_StatisticsActive)
+		return;
+
+	QueryFrame& frame = s_Frames[s_FrameIndex];
+	s_CommandBuffer.endQuery(frame.StatisticsPool, (sf::Uint32)frame.StatisticsNames.size() - 1);
+	s_StatisticsActive = false;
+}
+
+void GpuQueries::BeginOcclusion(sf::Uint32 id, bool precise)
+{
+	if (s_Frames.empty() || !s_CommandBuffer)
+		return;
+
+	assert(!s_OcclusionActive);
+
+	QueryFrame& frame = s_Frames[s_FrameIndex];
+	if (frame.OcclusionIds.size() == MAX_OCCLUSION_QUERIES_PER_FRAME)
+		return;
+
+	// Without precise occlusion the result is only zero or non-zero
+	vk::QueryControlFlags flags = precise && s_PreciseOcclusionSupported ? vk::QueryControlFlags(vk::QueryControlFlagBits::ePrecise) : vk::QueryControlFlags();
+	s_CommandBuffer.beginQuery(frame.OcclusionPool, (sf::Uint32)frame.OcclusionIds.size(), flags);
+	frame.OcclusionIds.push_back(id);
+	s_OcclusionActive = true;
+}
+
+void GpuQueries::EndOcclusion()
+{
+	if (!s_OcclusionActive)
+		return;
+
+	QueryFrame& frame = s_Frames[s_FrameIndex];
+	s_CommandBuffer.endQuery(frame.OcclusionPool, (sf::Uint32)frame.OcclusionIds.size() - 1);
+	s_OcclusionActive = false;
+}
+
+bool GpuQueries::IsPipelineStatisticsSupported()
+{
+	return s_StatisticsSupported;
+}
+
+const std::vector<PipelineStatisticsResult>& GpuQueries::GetStatisticsResults()
+{
+	return s_StatisticsResults;
+}
+
+bool GpuQueries::GetOcclusionResult(sf::Uint32 id, OcclusionResult& result)
+{
+	auto it = s_OcclusionResults.find(id);
+	if (it == s_OcclusionResults.end())
+		return false;
+
+	result = it->second;
+	return true;
+}
+
+void GpuQueries::ReadResults(sf::Uint32 frameIndex)
+{
+	vk::Device device = RenderingDevice::GetDevice();
+	QueryFrame& frame = s_Frames[frameIndex];
+	vk::QueryResultFlags flags = vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability;
+
+	// Statistics: replace the previous results only when every query of the frame is available
+	sf::Uint32 statisticsCount = (sf::Uint32)frame.StatisticsNames.size();
+	if (statisticsCount > 0)
+	{
+		sf::Uint32 stride = STATISTICS_COUNTERS + 1;
+		std::vector<sf::Uint64> data(statisticsCount * stride);
+		vk::Result result = device.getQueryPoolResults(frame.StatisticsPool, 0, statisticsCount, data.size() * sizeof(sf::Uint64), data.data(), stride * sizeof(sf::Uint64), flags);
+
+		bool available = result == vk::Result::eSuccess || result == vk::Result::eNotReady;
+		for (sf::Uint32 i = 0; i < statisticsCount && available; i++)
+			available = data[i * stride + STATISTICS_COUNTERS] != 0;
+
+		if (available)
+		{
+			s_StatisticsResults.clear();
+			for (sf::Uint32 i = 0; i < statisticsCount; i++)
+			{
+				const sf::Uint64* values = &data[i * stride];
+
+				PipelineStatisticsResult statisticsResult = {};
+				statisticsResult.Name = frame.StatisticsNames[i];
+				statisticsResult.Statistics.InputAssemblyVertices = values[0];
+				statisticsResult.Statistics.InputAssemblyPrimitives = values[1];
+				statisticsResult.Statistics.VertexShaderInvocations = values[2];
+				statisticsResult.Statistics.ClippingInvocations = values[3];
+				statisticsResult.Statistics.ClippingPrimitives = values[4];
+				statisticsResult.Statistics.FragmentShaderInvocations = values[5];
+				s_StatisticsResults.push_back(statisticsResult);
+			}
+		}
+	}
+
+	// Occlusion: every available query updates its id individually
+	sf::Uint32 occlusionCount = (sf::Uint32)frame.OcclusionIds.size();
+	if (occlusionCount > 0)
+	{
+		std::vector<sf::Uint64> data(occlusionCount * 2);
+		vk::Result result = device.getQueryPoolResults(frame.OcclusionPool, 0, occlusionCount, data.size() * sizeof(sf::Uint64), data.data(), 2 * sizeof(sf::Uint64), flags);
+
+		if (result == vk::Result::eSuccess || result == vk::Result::eNotReady)
+		{
+			for (sf::Uint32 i = 0; i < occlusionCount; i++)
+			{
+				if (data[i * 2 + 1] == 0)
+					continue;
+
+				OcclusionResult& occlusionResult = s_OcclusionResults[frame.OcclusionIds[i]];
+				if (occlusionResult.FrameNumber > frame.FrameNumber)
+					continue;
+
+				occlusionResult.SamplesPassed = data[i * 2];
+				occlusionResult.FrameNumber = frame.FrameNumber;
+			}
+		}
+	}
+}
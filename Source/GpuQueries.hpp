@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+#include "Profiler.hpp"
+
+struct PipelineStatistics
+{
+	sf::Uint64 InputAssemblyVertices = 0;
+	sf::Uint64 InputAssemblyPrimitives = 0;
+	sf::Uint64 VertexShaderInvocations = 0;
+	sf::Uint64 ClippingInvocations = 0;
+	sf::Uint64 ClippingPrimitives = 0;
+	sf::Uint64 FragmentShaderInvocations = 0;
+};
+
+struct PipelineStatisticsResult
+{
+	std::string Name = {};
+	PipelineStatistics Statistics = {};
+};
+
+struct OcclusionResult
+{
+	sf::Uint64 SamplesPassed = 0;
+	sf::Uint64 FrameNumber = 0;
+};
+
+// Pipeline statistics & occlusion queries, managed like the GpuProfiler timestamp pools: one pool of each type
+// per frame in flight, read back without waiting once the frame's fence has signalled.
+// Queries of the same type cannot nest, and a query begun inside a render pass must end inside it.
+class GpuQueries
+{
+public:
+	static void Initialize(sf::Uint32 framesInFlight);
+	static void Terminate();
+
+	// Frame hooks, see GpuProfiler
+	static void BeginFrame(sf::Uint32 frameIndex, vk::CommandBuffer commandBuffer);
+	static void EndFrame(vk::CommandBuffer commandBuffer);
+
+	static void BeginStatistics(const char* name);
+	static void EndStatistics();
+
+	// Id is chosen by the caller (e.g. object id) and used to look the result up later
+	static void BeginOcclusion(sf::Uint32 id, bool precise = false);
+	static void EndOcclusion();
+
+	static bool IsPipelineStatisticsSupported();
+
+	// Latest frame with complete results
+	static const std::vector<PipelineStatisticsResult>& GetStatisticsResults();
+	static bool GetOcclusionResult(sf::Uint32 id, OcclusionResult& result);
+private:
+	GpuQueries();
+	GpuQueries(const GpuQueries&);
+
+	static void ReadResults(sf::Uint32 frameIndex);
+};
+
+struct GpuStatisticsScope
+{
+	GpuStatisticsScope(const char* name) { GpuQueries::BeginStatistics(name); }
+	~GpuStatisticsScope() { GpuQueries::EndStatistics(); }
+};
+
+struct OcclusionQueryScope
+{
+	OcclusionQueryScope(sf::Uint32 id, bool precise = false) { GpuQueries::BeginOcclusion(id, precise); }
+	~OcclusionQueryScope() { GpuQueries::EndOcclusion(); }
+};
+
+#define GPU_STATISTICS_SCOPE(name) GpuStatisticsScope PROFILE_CONCAT(gpuStatisticsScope, __LINE__)(name)
@@ -1,12 +1,65 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
 #include <SFML/Window.hpp>
 
 #include "RenderingDevice.hpp"
+#include "FrameReadback.hpp"
+#include "FrameScheduler.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuQueries.hpp"
+#include "Profiler.hpp"
+#include "TraceCapture.hpp"
+#include "VideoCapture.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
+	PROFILE_THREAD("Main");
+
 	sf::WindowBase window(sf::VideoMode(960, 540), "SFML-Vulkan");
 
 	RenderingDevice::Initialize(&window);
+	FrameScheduler::Initialize(&window);
+
+	PresentSettings presentSettings = RenderingDevice::GetPresentSettings();
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string path = argv[i + 1];
+
+		// Replay with the TraceReplay tool, capture has to start before resources are created
+		if (std::strcmp(argv[i], "--capture") == 0)
+			TraceCapture::Begin(path);
+
+		// Y4M when the path says so, a PPM sequence named after the path otherwise
+		if (std::strcmp(argv[i], "--record") == 0)
+		{
+			bool y4m = path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+			VideoCapture::Begin(path, y4m ? VideoFormat::Y4M : VideoFormat::PpmSequence);
+		}
+
+		// vsync, low-latency, uncapped or adaptive
+		if (std::strcmp(argv[i], "--present") == 0)
+		{
+			if (path == "vsync")
+				presentSettings.Policy = PresentPolicy::VSync;
+			if (path == "low-latency")
+				presentSettings.Policy = PresentPolicy::LowLatency;
+			if (path == "uncapped")
+				presentSettings.Policy = PresentPolicy::Uncapped;
+			if (path == "adaptive")
+				presentSettings.Policy = PresentPolicy::Adaptive;
+		}
+
+		// continuous or on-demand
+		if (std::strcmp(argv[i], "--redraw") == 0)
+			FrameScheduler::SetRedrawMode(path == "on-demand" ? RedrawMode::OnDemand : RedrawMode::Continuous);
+
+		if (std::strcmp(argv[i], "--images") == 0)
+			presentSettings.ImageCount = (sf::Uint32)std::strtoul(path.c_str(), nullptr, 10);
+	}
+
+	RenderingDevice::SetPresentSettings(presentSettings);
 
 	VulkanShader shader = RenderingDevice::CreateShader("Resources/vert.spv", "Resources/frag.spv");
 
@@ -20,24 +73,37 @@ int main()
 
 	while (window.isOpen())
 	{
+		// Blocks while paused or, on demand, until something invalidates the window
 		sf::Event event = {};
-		while (window.pollEvent(event))
+		while (FrameScheduler::PollEvent(window, event))
 		{
 			if (event.type == sf::Event::Closed)
 				window.close();
 
 			if (event.type == sf::Event::Resized)
-				RenderingDevice::RecreateSwapchain();
+				RenderingDevice::RequestSwapchainRecreate();
 
 			if (sf::Keyboard::isKeyPressed(sf::Keyboard::Escape))
 				window.close();
+
+			// Written by the readback worker a couple of frames later
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F12)
+				FrameReadback::RequestScreenshot("Screenshot.png");
 		}
 
 		if (!window.isOpen())
 			break;
 
+		if (!FrameScheduler::ShouldRenderFrame())
+			continue;
+
+		PROFILE_SCOPE("Frame");
+
 		RenderingDevice::BeginRenderPass();
 		{
+			GPU_SCOPE("Triangle");
+			GPU_STATISTICS_SCOPE("Triangle");
+
 			RenderingDevice::SetViewport(sf::Vector2f(0.0f, 0.0f), (sf::Vector2f)window.getSize());
 			RenderingDevice::SetScissors(sf::Vector2i(0, 0), (sf::Vector2i)window.getSize());
 
@@ -47,8 +113,17 @@ int main()
 		}
 		RenderingDevice::EndRenderPass();
 		RenderingDevice::Present();
+
+		PROFILE_FRAME();
 	}
 
+#ifdef ENABLE_PROFILER
+	Profiler::WriteChromeTrace("Trace.json");
+#endif
+
+	TraceCapture::End();
+	VideoCapture::End();
+
 	RenderingDevice::DestroyVertexBuffer(vertexBuffer);
 	RenderingDevice::DestroyShader(shader);
 
@@ -0,0 +1,268 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#include "Profiler.hpp"
+#include "GpuProfiler.hpp"
+
+static constexpr sf::Uint32 THREAD_BUFFER_SIZE = 1 << 16;
+static constexpr sf::Uint32 MAX_SCOPE_DEPTH = 64;
+// Flush() keeps the most recent events, older ones are overwritten and counted as dropped
+static constexpr size_t MAX_COLLECTED_EVENTS = 1 << 20;
+static constexpr size_t MAX_COLLECTED_GPU_EVENTS = 1 << 16;
+
+// Track id used for GPU scopes in the trace
+static constexpr sf::Uint32 GPU_THREAD_ID = 1000;
+
+struct ProfileEvent
+{
+	const char* Name = {};
+	sf::Uint64 Begin = {};
+	sf::Uint64 End = {};
+	sf::Uint32 ThreadId = {};
+	sf::Uint32 Depth = {};
+};
+
+// Single producer ring: the owning thread publishes through Head, Flush() reads up to it. Buffers stay on the
+// list once registered, a thread that exits releases its buffer and the next new thread takes over its track.
+struct ThreadBuffer
+{
+	std::array<ProfileEvent, THREAD_BUFFER_SIZE> Events = {};
+	std::atomic<sf::Uint64> Head = {};
+	sf::Uint64 Tail = {};
+	sf::Uint32 ThreadId = {};
+	std::atomic<const char*> Name = {};
+	std::atomic<bool> InUse = {};
+	ThreadBuffer* Next = {};
+};
+
+// Releases the thread's buffer when the thread exits
+struct ThreadBufferLease
+{
+	ThreadBuffer* Buffer = {};
+
+	~ThreadBufferLease()
+	{
+		if (!Buffer)
+			return;
+
+		Buffer->Name.store(nullptr);
+		Buffer->InUse.store(false, std::memory_order_release);
+		Buffer = nullptr;
+	}
+};
+
+struct OpenScope
+{
+	const char* Name = {};
+	sf::Uint64 Begin = {};
+};
+
+struct GpuEvent
+{
+	std::string Name = {};
+	sf::Uint64 Begin = {};
+	sf::Uint64 End = {};
+	sf::Uint32 Depth = {};
+};
+
+static const std::chrono::steady_clock::time_point s_Epoch = std::chrono::steady_clock::now();
+
+static std::atomic<ThreadBuffer*>	s_ThreadBuffers = {};
+static std::atomic<sf::Uint32>		s_NextThreadId = {};
+
+static thread_local ThreadBufferLease						t_ThreadBuffer = {};
+static thread_local std::array<OpenScope, MAX_SCOPE_DEPTH>	t_ScopeStack = {};
+static thread_local sf::Uint32								t_ScopeDepth = {};
+
+static std::vector<ProfileEvent>	s_Collected = {};
+static size_t						s_CollectedNext = {};
+static std::vector<GpuEvent>		s_GpuCollected = {};
+static size_t						s_GpuCollectedNext = {};
+static sf::Uint64					s_LastGpuFrame = UINT64_MAX;
+static sf::Uint64					s_DroppedEvents = {};
+
+static ThreadBuffer* GetThreadBuffer()
+{
+	if (t_ThreadBuffer.Buffer)
+		return t_ThreadBuffer.Buffer;
+
+	// Reuse the buffer of a thread that exited, its unread events are still drained by Flush()
+	for (ThreadBuffer* buffer = s_ThreadBuffers.load(); buffer; buffer = buffer->Next)
+	{
+		bool inUse = false;
+		if (buffer->InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+		{
+			t_ThreadBuffer.Buffer = buffer;
+			return buffer;
+		}
+	}
+
+	// Otherwise register a new one with a lock-free push onto the list
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->ThreadId = s_NextThreadId++;
+	buffer->InUse.store(true);
+	buffer->Next = s_ThreadBuffers.load();
+	while (!s_ThreadBuffers.compare_exchange_weak(buffer->Next, buffer));
+
+	t_ThreadBuffer.Buffer = buffer;
+	return buffer;
+}
+
+template<typename T>
+static void PushCollected(std::vector<T>& events, size_t& next, size_t capacity, T&& event)
+{
+	if (events.size() < capacity)
+	{
+		events.push_back(std::move(event));
+		return;
+	}
+
+	events[next] = std::move(event);
+	next = (next + 1) % capacity;
+	s_DroppedEvents++;
+}
+
+static void WriteEscaped(std::ofstream& file, const char* text)
+{
+	for (; *text; text++)
+	{
+		if (*text == '"' || *text == '\\')
+			file << '\\';
+		file << *text;
+	}
+}
+
+sf::Uint64 Profiler::GetTime()
+{
+	return (sf::Uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_Epoch).count();
+}
+
+void Profiler::BeginScope(const char* name)
+{
+	if (t_ScopeDepth < MAX_SCOPE_DEPTH)
+		t_ScopeStack[t_ScopeDepth] = { name, GetTime() };
+
+	t_ScopeDepth++;
+}
+
+void Profiler::EndScope()
+{
+	sf::Uint64 end = GetTime();
+
+	t_ScopeDepth--;
+	if (t_ScopeDepth >= MAX_SCOPE_DEPTH)
+		return;
+
+	ThreadBuffer* buffer = GetThreadBuffer();
+	sf::Uint64 head = buffer->Head.load(std::memory_order_relaxed);
+
+	ProfileEvent& event = buffer->Events[head % THREAD_BUFFER_SIZE];
+	event.Name = t_ScopeStack[t_ScopeDepth].Name;
+	event.Begin = t_ScopeStack[t_ScopeDepth].Begin;
+	event.End = end;
+	event.ThreadId = buffer->ThreadId;
+	event.Depth = t_ScopeDepth;
+
+	buffer->Head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	GetThreadBuffer()->Name.store(name);
+}
+
+void Profiler::Flush()
+{
+	// Drain every thread's ring, events overwritten before we got to them are counted as dropped
+	for (ThreadBuffer* buffer = s_ThreadBuffers.load(); buffer; buffer = buffer->Next)
+	{
+		sf::Uint64 head = buffer->Head.load(std::memory_order_acquire);
+		// The slot at head - THREAD_BUFFER_SIZE is the one the producer writes next, it is never read
+		if (head - buffer->Tail >= THREAD_BUFFER_SIZE)
+		{
+			s_DroppedEvents += head - buffer->Tail - THREAD_BUFFER_SIZE + 1;
+			buffer->Tail = head - THREAD_BUFFER_SIZE + 1;
+		}
+
+		for (; buffer->Tail < head; buffer->Tail++)
+			PushCollected(s_Collected, s_CollectedNext, MAX_COLLECTED_EVENTS, ProfileEvent(buffer->Events[buffer->Tail % THREAD_BUFFER_SIZE]));
+	}
+
+	// GPU scopes are placed on their own track, anchored at the CPU time their frame began recording
+	if (GpuProfiler::GetResultsFrameNumber() != s_LastGpuFrame && !GpuProfiler::GetResults().empty())
+	{
+		s_LastGpuFrame = GpuProfiler::GetResultsFrameNumber();
+		sf::Uint64 anchor = GpuProfiler::GetResultsCpuTime();
+
+		for (const GpuScopeResult& result : GpuProfiler::GetResults())
+		{
+			GpuEvent event = {};
+			event.Name = result.Name;
+			event.Begin = anchor + (sf::Uint64)(result.BeginMs * 1000000.0);
+			event.End = event.Begin + (sf::Uint64)(result.DurationMs * 1000000.0);
+			event.Depth = result.Depth;
+			PushCollected(s_GpuCollected, s_GpuCollectedNext, MAX_COLLECTED_GPU_EVENTS, std::move(event));
+		}
+	}
+}
+
+bool Profiler::WriteChromeTrace(const std::string& filePath)
+{
+	Flush();
+
+	std::ofstream file(filePath, std::ios::binary);
+	if (!file)
+		return false;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	// Thread names
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_THREAD_ID << ",\"args\":{\"name\":\"GPU\"}}";
+	for (ThreadBuffer* buffer = s_ThreadBuffers.load(); buffer; buffer = buffer->Next)
+	{
+		const char* name = buffer->Name.load();
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->ThreadId << ",\"args\":{\"name\":\"";
+		if (name)
+			WriteEscaped(file, name);
+		else
+			file << "Thread " << buffer->ThreadId;
+		file << "\"}}";
+	}
+
+	// Complete events, timestamps in microseconds
+	file.precision(3);
+	file << std::fixed;
+
+	for (const ProfileEvent& event : s_Collected)
+	{
+		file << ",\n{\"name\":\"";
+		WriteEscaped(file, event.Name);
+		file << "\",\"cat\":\"CPU\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.ThreadId
+			<< ",\"ts\":" << event.Begin / 1000.0
+			<< ",\"dur\":" << (event.End - event.Begin) / 1000.0 << "}";
+	}
+
+	for (const GpuEvent& event : s_GpuCollected)
+	{
+		file << ",\n{\"name\":\"";
+		WriteEscaped(file, event.Name.c_str());
+		file << "\",\"cat\":\"GPU\",\"ph\":\"X\",\"pid\":0,\"tid\":" << GPU_THREAD_ID
+			<< ",\"ts\":" << event.Begin / 1000.0
+			<< ",\"dur\":" << (event.End - event.Begin) / 1000.0 << "}";
+	}
+
+	file << "\n],\"otherData\":{\"droppedEvents\":" << s_DroppedEvents << "}}\n";
+	return (bool)file;
+}
+
+void Profiler::Clear()
+{
+	s_Collected.clear();
+	s_CollectedNext = 0;
+	s_GpuCollected.clear();
+	s_GpuCollectedNext = 0;
+	s_DroppedEvents = 0;
+}
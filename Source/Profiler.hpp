@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include <SFML/Config.hpp>
+
+// Scoped CPU timers. Every thread writes completed scopes into its own ring buffer without locking,
+// Flush() drains all rings (and the latest GPU scopes) on the main thread, WriteChromeTrace() saves
+// trace-event JSON that loads in chrome://tracing or ui.perfetto.dev.
+//
+// The macros compile to nothing unless ENABLE_PROFILER is defined (Debug, or Release with --profile).
+class Profiler
+{
+public:
+	// Nanoseconds since the profiler epoch
+	static sf::Uint64 GetTime();
+
+	static void BeginScope(const char* name);
+	static void EndScope();
+
+	static void SetThreadName(const char* name);
+
+	static void Flush();
+	static bool WriteChromeTrace(const std::string& filePath);
+	static void Clear();
+private:
+	Profiler();
+	Profiler(const Profiler&);
+};
+
+struct ProfileScope
+{
+	ProfileScope(const char* name) { Profiler::BeginScope(name); }
+	~ProfileScope() { Profiler::EndScope(); }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#define PROFILE_FRAME() Profiler::Flush()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#define PROFILE_FRAME()
+#endif
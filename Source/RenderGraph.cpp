@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <cassert>
+
+#include "BarrierTracker.hpp"
+#include "RenderGraph.hpp"
+
+static bool IsDepthFormat(vk::Format format)
+{
+	return format == vk::Format::eD16Unorm
+		|| format == vk::Format::eD32Sfloat
+		|| format == vk::Format::eD16UnormS8Uint
+		|| format == vk::Format::eD24UnormS8Uint
+		|| format == vk::Format::eD32SfloatS8Uint;
+}
+
+static vk::ImageUsageFlags GetImageUsage(RenderGraphAccess access)
+{
+	switch (access)
+	{
+	case RenderGraphAccess::ColorAttachment:	return vk::ImageUsageFlagBits::eColorAttachment;
+	case RenderGraphAccess::DepthAttachment:	return vk::ImageUsageFlagBits::eDepthStencilAttachment;
+	case RenderGraphAccess::DepthRead:			return vk::ImageUsageFlagBits::eDepthStencilAttachment;
+	case RenderGraphAccess::ShaderRead:			return vk::ImageUsageFlagBits::eSampled;
+	case RenderGraphAccess::StorageRead:		return vk::ImageUsageFlagBits::eStorage;
+	case RenderGraphAccess::StorageWrite:		return vk::ImageUsageFlagBits::eStorage;
+	case RenderGraphAccess::TransferSrc:		return vk::ImageUsageFlagBits::eTransferSrc;
+	case RenderGraphAccess::TransferDst:		return vk::ImageUsageFlagBits::eTransferDst;
+	default:									return vk::ImageUsageFlags();
+	}
+}
+
+static bool HasStencil(vk::Format format)
+{
+	return format == vk::Format::eD16UnormS8Uint
+		|| format == vk::Format::eD24UnormS8Uint
+		|| format == vk::Format::eD32SfloatS8Uint;
+}
+
+static ResourceUsage GetResourceUsage(RenderGraphAccess access)
+{
+	switch (access)
+	{
+	case RenderGraphAccess::ColorAttachment:	return ResourceUsage::ColorAttachment;
+	case RenderGraphAccess::DepthAttachment:	return ResourceUsage::DepthAttachment;
+	case RenderGraphAccess::DepthRead:			return ResourceUsage::DepthRead;
+	case RenderGraphAccess::ShaderRead:			return ResourceUsage::FragmentShaderRead;
+	case RenderGraphAccess::StorageRead:		return ResourceUsage::ComputeStorageRead;
+	case RenderGraphAccess::StorageWrite:		return ResourceUsage::ComputeStorageWrite;
+	case RenderGraphAccess::TransferSrc:		return ResourceUsage::TransferSrc;
+	case RenderGraphAccess::TransferDst:		return ResourceUsage::TransferDst;
+	case RenderGraphAccess::VertexBuffer:		return ResourceUsage::VertexBuffer;
+	case RenderGraphAccess::IndexBuffer:		return ResourceUsage::IndexBuffer;
+	case RenderGraphAccess::UniformBuffer:		return ResourceUsage::UniformBuffer;
+	}
+
+	return ResourceUsage::General;
+}
+
+static vk::BufferUsageFlags GetBufferUsage(RenderGraphAccess access)
+{
+	switch (access)
+	{
+	case RenderGraphAccess::ShaderRead:		return vk::BufferUsageFlagBits::eStorageBuffer;
+	case RenderGraphAccess::StorageRead:	return vk::BufferUsageFlagBits::eStorageBuffer;
+	case RenderGraphAccess::StorageWrite:	return vk::BufferUsageFlagBits::eStorageBuffer;
+	case RenderGraphAccess::TransferSrc:	return vk::BufferUsageFlagBits::eTransferSrc;
+	case RenderGraphAccess::TransferDst:	return vk::BufferUsageFlagBits::eTransferDst;
+	case RenderGraphAccess::VertexBuffer:	return vk::BufferUsageFlagBits::eVertexBuffer;
+	case RenderGraphAccess::IndexBuffer:	return vk::BufferUsageFlagBits::eIndexBuffer;
+	case RenderGraphAccess::UniformBuffer:	return vk::BufferUsageFlagBits::eUniformBuffer;
+	default:								return vk::BufferUsageFlags();
+	}
+}
+
+RenderGraphBuilder::RenderGraphBuilder(RenderGraph* graph, sf::Uint32 passIndex)
+	: m_Graph(graph), m_PassIndex(passIndex)
+{
+}
+
+void RenderGraphBuilder::Read(RenderGraphResource resource, RenderGraphAccess access)
+{
+	assert(resource < m_Graph->m_Resources.size());
+	m_Graph->m_Passes[m_PassIndex].Accesses.push_back({ resource, access, false });
+}
+
+void RenderGraphBuilder::Write(RenderGraphResource resource, RenderGraphAccess access)
+{
+	assert(resource < m_Graph->m_Resources.size());
+	m_Graph->m_Passes[m_PassIndex].Accesses.push_back({ resource, access, true });
+}
+
+void RenderGraphBuilder::SetColorAttachment(RenderGraphResource resource, vk::AttachmentLoadOp loadOp, vk::ClearColorValue clearColor)
+{
+	if (loadOp == vk::AttachmentLoadOp::eLoad)
+		Read(resource, RenderGraphAccess::ColorAttachment);
+	Write(resource, RenderGraphAccess::ColorAttachment);
+
+	RenderGraph::Attachment attachment = {};
+	attachment.Resource = resource;
+	attachment.LoadOp = loadOp;
+	attachment.ClearValue = vk::ClearValue(clearColor);
+	m_Graph->m_Passes[m_PassIndex].ColorAttachments.push_back(attachment);
+}
+
+void RenderGraphBuilder::SetDepthAttachment(RenderGraphResource resource, vk::AttachmentLoadOp loadOp, vk::ClearDepthStencilValue clearDepth)
+{
+	if (loadOp == vk::AttachmentLoadOp::eLoad)
+		Read(resource, RenderGraphAccess::DepthAttachment);
+	Write(resource, RenderGraphAccess::DepthAttachment);
+
+	RenderGraph::Attachment& attachment = m_Graph->m_Passes[m_PassIndex].DepthAttachment;
+	attachment.Resource = resource;
+	attachment.LoadOp = loadOp;
+	attachment.ClearValue = vk::ClearValue(clearDepth);
+}
+
+void RenderGraphBuilder::SetSideEffects()
+{
+	m_Graph->m_Passes[m_PassIndex].SideEffects = true;
+}
+
+RenderGraph::~RenderGraph()
+{
+	Reset();
+}
+
+RenderGraphResource RenderGraph::CreateImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.IsImage = true;
+	resource.ImageDesc = desc;
+
+	m_Resources.push_back(resource);
+	return (RenderGraphResource)m_Resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::CreateBuffer(const std::string& name, const RenderGraphBufferDesc& desc)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.BufferDesc = desc;
+
+	m_Resources.push_back(resource);
+	return (RenderGraphResource)m_Resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::ImportImage(const std::string& name, vk::Image image, vk::ImageView imageView, vk::Format format, vk::Extent2D extent)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.IsImage = true;
+	resource.Imported = true;
+	resource.ImageDesc.Width = extent.width;
+	resource.ImageDesc.Height = extent.height;
+	resource.ImageDesc.Format = format;
+	resource.Image = image;
+	resource.ImageView = imageView;
+
+	m_Resources.push_back(resource);
+	return (RenderGraphResource)m_Resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::ImportBuffer(const std::string& name, vk::Buffer buffer, vk::DeviceSize size)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.Imported = true;
+	resource.BufferDesc.Size = size;
+	resource.Buffer = buffer;
+
+	m_Resources.push_back(resource);
+	return (RenderGraphResource)m_Resources.size() - 1;
+}
+
+void RenderGraph::UpdateImportedImage(RenderGraphResource resource, vk::Image image, vk::ImageView imageView)
+{
+	assert(m_Resources[resource].Imported && m_Resources[resource].IsImage);
+	m_Resources[resource].Image = image;
+	m_Resources[resource].ImageView = imageView;
+}
+
+void RenderGraph::MarkOutput(RenderGraphResource resource)
+{
+	m_Resources[resource].Output = true;
+}
+
+void RenderGraph::AddPass(const std::string& name, const std::function<void(RenderGraphBuilder&)>& setup, const std::function<void(vk::CommandBuffer)>& execute)
+{
+	assert(!m_Compiled);
+
+	Pass pass = {};
+	pass.Name = name;
+	pass.Execute = execute;
+	m_Passes.push_back(pass);
+
+	RenderGraphBuilder builder(this, (sf::Uint32)m_Passes.size() - 1);
+	setup(builder);
+}
+
+void RenderGraph::Compile()
+{
+	assert(!m_Compiled);
+
+	CullPasses();
+	ComputeLifetimes();
+	AllocateTransients();
+	CreateRenderPasses();
+	ComputeTransitions();
+
+	m_Compiled = true;
+}
+
+void RenderGraph::Execute(vk::CommandBuffer commandBuffer)
+{
+	assert(m_Compiled);
+
+	for (sf::Uint32 passIndex = 0; passIndex < m_Passes.size(); passIndex++)
+	{
+		Pass& pass = m_Passes[passIndex];
+		if (pass.Culled)
+			continue;
+
+		// One batched barrier per pass
+		for (const auto& [index, usage] : pass.Transitions)
+		{
+			const Resource& resource = m_Resources[index];
+
+			// First use of an aliased resource waits for the previous occupant of its memory, which was used earlier in
+			// this execution or, for the first occupant, by the last one
+			if (resource.FirstPass == passIndex && resource.AliasedResource != UINT32_MAX)
+			{
+				const Resource& previous = m_Resources[resource.AliasedResource];
+				if (resource.IsImage)
+					BarrierTracker::AliasImage(resource.Image, previous.Image);
+				else
+					BarrierTracker::AliasBuffer(resource.Buffer, previous.Buffer);
+			}
+
+			if (resource.IsImage)
+				BarrierTracker::TransitionImage(resource.Image, usage);
+			else
+				BarrierTracker::TransitionBuffer(resource.Buffer, usage);
+		}
+		BarrierTracker::Flush(commandBuffer);
+
+		if (!pass.RenderPass)
+		{
+			pass.Execute(commandBuffer);
+			continue;
+		}
+
+		std::vector<vk::ClearValue> clearValues = {};
+		for (const Attachment& attachment : pass.ColorAttachments)
+			clearValues.push_back(attachment.ClearValue);
+		if (pass.DepthAttachment.Resource != UINT32_MAX)
+			clearValues.push_back(pass.DepthAttachment.ClearValue);
+
+		vk::Rect2D renderArea(vk::Offset2D(0, 0), pass.Extent);
+		vk::RenderPassBeginInfo renderPassBeginInfo(pass.RenderPass, GetFramebuffer(pass), renderArea, clearValues);
+		commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+		pass.Execute(commandBuffer);
+		commandBuffer.endRenderPass();
+	}
+}
+
+void RenderGraph::Reset()
+{
+	// Executions still in flight may use everything, the device destroys it once their frames completed
+	if (m_Compiled)
+	{
+		for (Pass& pass : m_Passes)
+		{
+			if (pass.Framebuffer)
+				RenderingDevice::DestroyFramebuffer(pass.Framebuffer);
+			if (pass.RenderPass)
+				RenderingDevice::DestroyRenderPass(pass.RenderPass);
+		}
+
+		for (Resource& resource : m_Resources)
+		{
+			if (resource.Imported)
+				continue;
+
+			if (resource.ImageView)
+				RenderingDevice::DestroyImageView(resource.ImageView);
+			if (resource.Image)
+				RenderingDevice::RetireImage({ resource.Image, nullptr });
+			if (resource.Buffer)
+				RenderingDevice::RetireBuffer({ resource.Buffer, nullptr });
+		}
+
+		for (MemorySlot& slot : m_MemorySlots)
+			RenderingDevice::RetireMemory(slot.Memory);
+	}
+
+	m_Resources.clear();
+	m_Passes.clear();
+	m_MemorySlots.clear();
+	m_Compiled = false;
+}
+
+vk::Image RenderGraph::GetImage(RenderGraphResource resource) const
+{
+	return m_Resources[resource].Image;
+}
+
+vk::ImageView RenderGraph::GetImageView(RenderGraphResource resource) const
+{
+	return m_Resources[resource].ImageView;
+}
+
+vk::Buffer RenderGraph::GetBuffer(RenderGraphResource resource) const
+{
+	return m_Resources[resource].Buffer;
+}
+
+sf::Uint32 RenderGraph::GetPassCount() const
+{
+	return (sf::Uint32)m_Passes.size();
+}
+
+sf::Uint32 RenderGraph::GetCulledPassCount() const
+{
+	return (sf::Uint32)std::count_if(m_Passes.begin(), m_Passes.end(), [](const Pass& pass) { return pass.Culled; });
+}
+
+vk::DeviceSize RenderGraph::GetTransientMemorySize() const
+{
+	vk::DeviceSize size = 0;
+	for (const MemorySlot& slot : m_MemorySlots)
+		size += slot.Size;
+
+	return size;
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk passes backwards: a pass is alive if it writes a resource that is still needed
+	std::vector<bool> needed(m_Resources.size(), false);
+	for (sf::Uint32 i = 0; i < m_Resources.size(); i++)
+		needed[i] = m_Resources[i].Output;
+
+	for (sf::Uint32 i = (sf::Uint32)m_Passes.size(); i-- > 0;)
+	{
+		Pass& pass = m_Passes[i];
+
+		bool alive = pass.SideEffects;
+		for (const PassAccess& access : pass.Accesses)
+			alive |= access.Write && needed[access.Resource];
+
+		pass.Culled = !alive;
+		if (pass.Culled)
+			continue;
+
+		// Earlier writers are only needed if this pass reads what they produced
+		for (const PassAccess& access : pass.Accesses)
+		{
+			if (access.Write)
+				needed[access.Resource] = false;
+		}
+
+		for (const PassAccess& access : pass.Accesses)
+		{
+			if (!access.Write)
+				needed[access.Resource] = true;
+		}
+	}
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (sf::Uint32 i = 0; i < m_Passes.size(); i++)
+	{
+		const Pass& pass = m_Passes[i];
+		if (pass.Culled)
+			continue;
+
+		for (const PassAccess& access : pass.Accesses)
+		{
+			Resource& resource = m_Resources[access.Resource];
+			resource.FirstPass = std::min(resource.FirstPass, i);
+			resource.LastPass = std::max(resource.LastPass, i);
+
+			if (resource.IsImage)
+				resource.ImageDesc.Usage |= GetImageUsage(access.Access);
+			else
+				resource.BufferDesc.Usage |= GetBufferUsage(access.Access);
+		}
+	}
+}
+
+void RenderGraph::AllocateTransients()
+{
+	vk::Device device = RenderingDevice::GetDevice();
+
+	struct Allocation
+	{
+		RenderGraphResource Resource = {};
+		vk::MemoryRequirements Requirements = {};
+	};
+
+	std::vector<Allocation> allocations = {};
+
+	// Create transient resources, memory is bound once slots are assigned
+	for (sf::Uint32 i = 0; i < m_Resources.size(); i++)
+	{
+		Resource& resource = m_Resources[i];
+		if (resource.Imported || resource.FirstPass == UINT32_MAX)
+			continue;
+
+		Allocation allocation = {};
+		allocation.Resource = i;
+
+		if (resource.IsImage)
+		{
+			// Attachments living within a single pass never leave tile memory on tile based GPUs
+			const vk::ImageUsageFlags attachmentUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment;
+			resource.Transient = resource.FirstPass == resource.LastPass && !resource.Output && !(resource.ImageDesc.Usage & ~attachmentUsage);
+			if (resource.Transient)
+				resource.ImageDesc.Usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+
+			const RenderGraphImageDesc& desc = resource.ImageDesc;
+			vk::ImageCreateInfo imageCreateInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, desc.Format, vk::Extent3D(desc.Width, desc.Height, 1), 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, desc.Usage, vk::SharingMode::eExclusive);
+			resource.Image = device.createImage(imageCreateInfo);
+			allocation.Requirements = device.getImageMemoryRequirements(resource.Image);
+		}
+		else
+		{
+			vk::BufferCreateInfo bufferCreateInfo(vk::BufferCreateFlags(), resource.BufferDesc.Size, resource.BufferDesc.Usage, vk::SharingMode::eExclusive);
+			resource.Buffer = device.createBuffer(bufferCreateInfo);
+			allocation.Requirements = device.getBufferMemoryRequirements(resource.Buffer);
+		}
+
+		allocations.push_back(allocation);
+	}
+
+	// Largest first, so every slot is sized by its first occupant
+	std::sort(allocations.begin(), allocations.end(), [](const Allocation& a, const Allocation& b) { return a.Requirements.size > b.Requirements.size; });
+
+	for (const Allocation& allocation : allocations)
+	{
+		Resource& resource = m_Resources[allocation.Resource];
+		bool lazilyAllocated = resource.Transient && RenderingDevice::FindLazilyAllocatedMemoryType(allocation.Requirements.memoryTypeBits) != UINT32_MAX;
+
+		for (sf::Uint32 i = 0; i < m_MemorySlots.size() && resource.MemorySlot == UINT32_MAX; i++)
+		{
+			MemorySlot& slot = m_MemorySlots[i];
+			if (slot.IsImage != resource.IsImage || slot.LazilyAllocated != lazilyAllocated || !(slot.MemoryTypeBits & allocation.Requirements.memoryTypeBits) || slot.Size < allocation.Requirements.size)
+				continue;
+
+			bool overlaps = false;
+			for (const auto& lifetime : slot.Lifetimes)
+				overlaps |= resource.FirstPass <= lifetime.second && lifetime.first <= resource.LastPass;
+
+			if (overlaps)
+				continue;
+
+			slot.MemoryTypeBits &= allocation.Requirements.memoryTypeBits;
+			slot.Lifetimes.push_back({ resource.FirstPass, resource.LastPass });
+			resource.MemorySlot = i;
+		}
+
+		if (resource.MemorySlot == UINT32_MAX)
+		{
+			MemorySlot slot = {};
+			slot.IsImage = resource.IsImage;
+			slot.LazilyAllocated = lazilyAllocated;
+			slot.Size = allocation.Requirements.size;
+			slot.MemoryTypeBits = allocation.Requirements.memoryTypeBits;
+			slot.Lifetimes.push_back({ resource.FirstPass, resource.LastPass });
+
+			m_MemorySlots.push_back(slot);
+			resource.MemorySlot = (sf::Uint32)m_MemorySlots.size() - 1;
+		}
+	}
+
+	// Allocate slots & bind every occupant at offset zero
+	for (MemorySlot& slot : m_MemorySlots)
+	{
+		sf::Uint32 memoryType = slot.LazilyAllocated ? RenderingDevice::FindLazilyAllocatedMemoryType(slot.MemoryTypeBits) : UINT32_MAX;
+		if (memoryType == UINT32_MAX)
+			memoryType = RenderingDevice::FindMemoryType(slot.MemoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+		vk::MemoryAllocateInfo allocateInfo(slot.Size, memoryType);
+		slot.Memory = device.allocateMemory(allocateInfo);
+	}
+
+	FrameStats stats = {};
+	stats.Allocations = m_MemorySlots.size();
+	RenderingDevice::AddFrameStats(stats);
+
+	for (const Allocation& allocation : allocations)
+	{
+		Resource& resource = m_Resources[allocation.Resource];
+		vk::DeviceMemory memory = m_MemorySlots[resource.MemorySlot].Memory;
+
+		if (resource.IsImage)
+		{
+			device.bindImageMemory(resource.Image, memory, 0);
+
+			vk::Format format = resource.ImageDesc.Format;
+			vk::ImageAspectFlags aspect = IsDepthFormat(format) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor;
+			vk::ImageViewCreateInfo imageViewCreateInfo(vk::ImageViewCreateFlags(), resource.Image, vk::ImageViewType::e2D, format, vk::ComponentMapping(), vk::ImageSubresourceRange(aspect, 0, 1, 0, 1));
+			resource.ImageView = device.createImageView(imageViewCreateInfo);
+
+			BarrierTracker::RegisterImage(resource.Image, HasStencil(format) ? aspect | vk::ImageAspectFlagBits::eStencil : aspect);
+		}
+		else
+		{
+			device.bindBufferMemory(resource.Buffer, memory, 0);
+		}
+	}
+}
+
+void RenderGraph::CreateRenderPasses()
+{
+	vk::Device device = RenderingDevice::GetDevice();
+
+	for (sf::Uint32 passIndex = 0; passIndex < m_Passes.size(); passIndex++)
+	{
+		Pass& pass = m_Passes[passIndex];
+		if (pass.Culled || (pass.ColorAttachments.empty() && pass.DepthAttachment.Resource == UINT32_MAX))
+			continue;
+
+		std::vector<vk::AttachmentDescription> attachments = {};
+		std::vector<vk::AttachmentReference> colorReferences = {};
+		vk::AttachmentReference depthReference = {};
+
+		// Layout transitions are done by the BarrierTracker, so attachments stay in their optimal layout
+		for (const Attachment& attachment : pass.ColorAttachments)
+		{
+			const Resource& resource = m_Resources[attachment.Resource];
+			colorReferences.push_back(vk::AttachmentReference((sf::Uint32)attachments.size(), vk::ImageLayout::eColorAttachmentOptimal));
+			attachments.push_back(vk::AttachmentDescription(vk::AttachmentDescriptionFlags(),
+				resource.ImageDesc.Format,
+				vk::SampleCountFlagBits::e1,
+				attachment.LoadOp,
+				GetStoreOp(attachment.Resource, passIndex),
+				vk::AttachmentLoadOp::eDontCare,
+				vk::AttachmentStoreOp::eDontCare,
+				vk::ImageLayout::eColorAttachmentOptimal,
+				vk::ImageLayout::eColorAttachmentOptimal));
+
+			pass.Extent = vk::Extent2D(resource.ImageDesc.Width, resource.ImageDesc.Height);
+			pass.ImportedAttachments |= resource.Imported;
+		}
+
+		vk::SubpassDescription subpassDescription(vk::SubpassDescriptionFlags(), vk::PipelineBindPoint::eGraphics, nullptr, colorReferences);
+
+		if (pass.DepthAttachment.Resource != UINT32_MAX)
+		{
+			const Resource& resource = m_Resources[pass.DepthAttachment.Resource];
+			depthReference = vk::AttachmentReference((sf::Uint32)attachments.size(), vk::ImageLayout::eDepthStencilAttachmentOptimal);
+			attachments.push_back(vk::AttachmentDescription(vk::AttachmentDescriptionFlags(),
+				resource.ImageDesc.Format,
+				vk::SampleCountFlagBits::e1,
+				pass.DepthAttachment.LoadOp,
+				GetStoreOp(pass.DepthAttachment.Resource, passIndex),
+				vk::AttachmentLoadOp::eDontCare,
+				vk::AttachmentStoreOp::eDontCare,
+				vk::ImageLayout::eDepthStencilAttachmentOptimal,
+				vk::ImageLayout::eDepthStencilAttachmentOptimal));
+
+			subpassDescription.pDepthStencilAttachment = &depthReference;
+			pass.Extent = vk::Extent2D(resource.ImageDesc.Width, resource.ImageDesc.Height);
+			pass.ImportedAttachments |= resource.Imported;
+		}
+
+		vk::RenderPassCreateInfo renderPassCreateInfo(vk::RenderPassCreateFlags(), attachments, subpassDescription);
+		pass.RenderPass = device.createRenderPass(renderPassCreateInfo);
+	}
+}
+
+vk::AttachmentStoreOp RenderGraph::GetStoreOp(RenderGraphResource resource, sf::Uint32 passIndex) const
+{
+	// Nothing reads the contents after this pass, tile based GPUs then skip writing them back to memory
+	const Resource& graphResource = m_Resources[resource];
+	if (!graphResource.Imported && !graphResource.Output && graphResource.LastPass == passIndex)
+		return vk::AttachmentStoreOp::eDontCare;
+
+	return vk::AttachmentStoreOp::eStore;
+}
+
+void RenderGraph::ComputeTransitions()
+{
+	for (Pass& pass : m_Passes)
+	{
+		if (pass.Culled)
+			continue;
+
+		// Merge every access of a resource inside the pass into one usage
+		for (const PassAccess& access : pass.Accesses)
+		{
+			ResourceUsage usage = GetResourceUsage(access.Access);
+
+			auto it = std::find_if(pass.Transitions.begin(), pass.Transitions.end(), [&access](const auto& transition) { return transition.first == access.Resource; });
+			if (it == pass.Transitions.end())
+				pass.Transitions.push_back({ access.Resource, usage });
+			else if (it->second != usage)
+				it->second = ResourceUsage::General;
+		}
+	}
+
+	// Transients are reused by the next execution while this one may still be in flight, so the occupants of a memory
+	// slot form a cycle: each one waits for the previous, the first for the last one of the previous execution
+	for (sf::Uint32 slotIndex = 0; slotIndex < m_MemorySlots.size(); slotIndex++)
+	{
+		std::vector<RenderGraphResource> occupants = {};
+		for (sf::Uint32 i = 0; i < m_Resources.size(); i++)
+		{
+			if (m_Resources[i].MemorySlot == slotIndex)
+				occupants.push_back(i);
+		}
+
+		// A single occupant carries its own state across executions
+		if (occupants.size() < 2)
+			continue;
+
+		std::sort(occupants.begin(), occupants.end(), [this](RenderGraphResource a, RenderGraphResource b) { return m_Resources[a].FirstPass < m_Resources[b].FirstPass; });
+
+		for (size_t i = 0; i < occupants.size(); i++)
+			m_Resources[occupants[i]].AliasedResource = occupants[(i + occupants.size() - 1) % occupants.size()];
+	}
+}
+
+vk::Framebuffer RenderGraph::GetFramebuffer(Pass& pass)
+{
+	if (pass.Framebuffer)
+		return pass.Framebuffer;
+
+	std::vector<vk::ImageView> views = {};
+	for (const Attachment& attachment : pass.ColorAttachments)
+		views.push_back(m_Resources[attachment.Resource].ImageView);
+	if (pass.DepthAttachment.Resource != UINT32_MAX)
+		views.push_back(m_Resources[pass.DepthAttachment.Resource].ImageView);
+
+	vk::FramebufferCreateInfo framebufferCreateInfo(vk::FramebufferCreateFlags(), pass.RenderPass, views, pass.Extent.width, pass.Extent.height, 1);
+	vk::Framebuffer framebuffer = RenderingDevice::GetDevice().createFramebuffer(framebufferCreateInfo);
+
+	// Imported views may be destroyed & their handles reused (swapchain recreation), so those framebuffers only live
+	// for one execution. Graph owned views stay valid until Reset.
+	if (pass.ImportedAttachments)
+		RenderingDevice::DestroyFramebuffer(framebuffer);
+	else
+		pass.Framebuffer = framebuffer;
+
+	return framebuffer;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "BarrierTracker.hpp"
+#include "RenderingDevice.hpp"
+
+typedef sf::Uint32 RenderGraphResource;
+
+enum class RenderGraphAccess
+{
+	ColorAttachment,
+	DepthAttachment,
+	DepthRead,
+	ShaderRead,
+	StorageRead,
+	StorageWrite,
+	TransferSrc,
+	TransferDst,
+	VertexBuffer,
+	IndexBuffer,
+	UniformBuffer
+};
+
+struct RenderGraphImageDesc
+{
+	sf::Uint32 Width = 0;
+	sf::Uint32 Height = 0;
+	vk::Format Format = vk::Format::eUndefined;
+	vk::ImageUsageFlags Usage = {};
+};
+
+struct RenderGraphBufferDesc
+{
+	vk::DeviceSize Size = 0;
+	vk::BufferUsageFlags Usage = {};
+};
+
+class RenderGraph;
+
+class RenderGraphBuilder
+{
+public:
+	void Read(RenderGraphResource resource, RenderGraphAccess access);
+	void Write(RenderGraphResource resource, RenderGraphAccess access);
+
+	void SetColorAttachment(RenderGraphResource resource, vk::AttachmentLoadOp loadOp, vk::ClearColorValue clearColor = {});
+	void SetDepthAttachment(RenderGraphResource resource, vk::AttachmentLoadOp loadOp, vk::ClearDepthStencilValue clearDepth = { 1.0f, 0 });
+
+	// Pass is never culled, even if nothing reads its output
+	void SetSideEffects();
+private:
+	friend class RenderGraph;
+
+	RenderGraphBuilder(RenderGraph* graph, sf::Uint32 passIndex);
+
+	RenderGraph* m_Graph = {};
+	sf::Uint32 m_PassIndex = {};
+};
+
+// Frame graph: passes declare the resources they read and write, Compile() culls passes that do not contribute to an
+// output, merges the accesses of each pass into BarrierTracker transitions and lets transient resources with disjoint
+// lifetimes share memory. Imported images have to be registered with the tracker by their owner.
+// A compiled graph is executed once per frame from the main thread, between BeginFrame & EndFrame and outside of the
+// device's passes.
+class RenderGraph
+{
+public:
+	RenderGraph() = default;
+	~RenderGraph();
+
+	RenderGraphResource CreateImage(const std::string& name, const RenderGraphImageDesc& desc);
+	RenderGraphResource CreateBuffer(const std::string& name, const RenderGraphBufferDesc& desc);
+
+	RenderGraphResource ImportImage(const std::string& name, vk::Image image, vk::ImageView imageView, vk::Format format, vk::Extent2D extent);
+	RenderGraphResource ImportBuffer(const std::string& name, vk::Buffer buffer, vk::DeviceSize size);
+
+	// Imported handles may change between executions (e.g. the acquired swapchain image)
+	void UpdateImportedImage(RenderGraphResource resource, vk::Image image, vk::ImageView imageView);
+
+	void MarkOutput(RenderGraphResource resource);
+
+	void AddPass(const std::string& name, const std::function<void(RenderGraphBuilder&)>& setup, const std::function<void(vk::CommandBuffer)>& execute);
+
+	void Compile();
+	void Execute(vk::CommandBuffer commandBuffer);
+	// Never waits for the device, the graph's resources are destroyed once the frames that may use them completed
+	void Reset();
+
+	vk::Image GetImage(RenderGraphResource resource) const;
+	vk::ImageView GetImageView(RenderGraphResource resource) const;
+	vk::Buffer GetBuffer(RenderGraphResource resource) const;
+
+	sf::Uint32 GetPassCount() const;
+	sf::Uint32 GetCulledPassCount() const;
+	vk::DeviceSize GetTransientMemorySize() const;
+private:
+	friend class RenderGraphBuilder;
+
+	struct Resource
+	{
+		std::string Name = {};
+		bool IsImage = {};
+		bool Imported = {};
+		bool Output = {};
+
+		RenderGraphImageDesc ImageDesc = {};
+		RenderGraphBufferDesc BufferDesc = {};
+
+		vk::Image Image = {};
+		vk::ImageView ImageView = {};
+		vk::Buffer Buffer = {};
+
+		sf::Uint32 FirstPass = UINT32_MAX;
+		sf::Uint32 LastPass = 0;
+		sf::Uint32 MemorySlot = UINT32_MAX;
+		RenderGraphResource AliasedResource = UINT32_MAX;
+		bool Transient = {};
+	};
+
+	struct PassAccess
+	{
+		RenderGraphResource Resource = {};
+		RenderGraphAccess Access = {};
+		bool Write = {};
+	};
+
+	struct Attachment
+	{
+		RenderGraphResource Resource = UINT32_MAX;
+		vk::AttachmentLoadOp LoadOp = vk::AttachmentLoadOp::eDontCare;
+		vk::ClearValue ClearValue = {};
+	};
+
+	struct Pass
+	{
+		std::string Name = {};
+		std::function<void(vk::CommandBuffer)> Execute = {};
+		std::vector<PassAccess> Accesses = {};
+		std::vector<Attachment> ColorAttachments = {};
+		Attachment DepthAttachment = {};
+		bool SideEffects = {};
+		bool Culled = {};
+
+		std::vector<std::pair<RenderGraphResource, ResourceUsage>> Transitions = {};
+		vk::RenderPass RenderPass = {};
+		vk::Extent2D Extent = {};
+		bool ImportedAttachments = {};
+		vk::Framebuffer Framebuffer = {};
+	};
+
+	struct MemorySlot
+	{
+		bool IsImage = {};
+		bool LazilyAllocated = {};
+		vk::DeviceSize Size = {};
+		sf::Uint32 MemoryTypeBits = {};
+		vk::DeviceMemory Memory = {};
+		std::vector<std::pair<sf::Uint32, sf::Uint32>> Lifetimes = {};
+	};
+
+	void CullPasses();
+	void ComputeLifetimes();
+	void AllocateTransients();
+	void CreateRenderPasses();
+	vk::AttachmentStoreOp GetStoreOp(RenderGraphResource resource, sf::Uint32 passIndex) const;
+	void ComputeTransitions();
+
+	vk::Framebuffer GetFramebuffer(Pass& pass);
+private:
+	std::vector<Resource> m_Resources = {};
+	std::vector<Pass> m_Passes = {};
+	std::vector<MemorySlot> m_MemorySlots = {};
+	bool m_Compiled = {};
+};
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderLayers.hpp"
+#include "FrameScheduler.hpp"
+#include "Profiler.hpp"
+
+static constexpr vk::DeviceSize DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+struct Layer
+{
+	sf::Vector2u Size = {};
+	std::function<void()> Record = {};
+	RenderPassDesc Desc = {};
+	RenderTarget Target = {}; // No image before the first prepare & after an eviction
+	bool Dirty = true;
+	sf::Uint64 LastUsed = {}; // Frame it was last prepared or composited in
+};
+
+static std::unordered_map<RenderLayerId, Layer>	s_Layers = {};
+static RenderLayerId							s_NextLayer = 1;
+
+// Oldest released target first
+static std::vector<RenderTarget>				s_Pool = {};
+static vk::DeviceSize							s_MemoryBudget = DEFAULT_MEMORY_BUDGET;
+static vk::DeviceSize							s_MemoryUsed = {};
+
+static sf::Uint64								s_Renders = {};
+static sf::Uint64								s_Composites = {};
+static sf::Uint64								s_Evictions = {};
+
+static void DestroyTarget(const RenderTarget& target)
+{
+	s_MemoryUsed -= target.Size;
+	RenderingDevice::DestroyRenderTarget(target);
+}
+
+static void EnforceBudget()
+{
+	while (s_MemoryUsed > s_MemoryBudget && !s_Pool.empty())
+	{
+		DestroyTarget(s_Pool.front());
+		s_Pool.erase(s_Pool.begin());
+	}
+
+	// Layers used this frame stay, their pass or quad is already recorded
+	sf::Uint64 frameNumber = RenderingDevice::GetFrameNumber();
+	while (s_MemoryUsed > s_MemoryBudget)
+	{
+		Layer* victim = nullptr;
+		for (auto& [id, layer] : s_Layers)
+		{
+			if (layer.Target.Image.Image && layer.LastUsed < frameNumber && (!victim || layer.LastUsed < victim->LastUsed))
+				victim = &layer;
+		}
+
+		if (!victim)
+			break;
+
+		DestroyTarget(victim->Target);
+		victim->Target = {};
+		victim->Dirty = true;
+		s_Evictions++;
+	}
+}
+
+static RenderTarget AcquireTarget(sf::Vector2u size)
+{
+	// Targets made before the depth buffer or sample count changed cannot be rendered into anymore
+	for (size_t i = 0; i < s_Pool.size();)
+	{
+		if (RenderingDevice::IsRenderTargetCompatible(s_Pool[i]))
+		{
+			i++;
+			continue;
+		}
+
+		DestroyTarget(s_Pool[i]);
+		s_Pool.erase(s_Pool.begin() + i);
+	}
+
+	for (size_t i = 0; i < s_Pool.size(); i++)
+	{
+		if (s_Pool[i].Extent.width == size.x && s_Pool[i].Extent.height == size.y)
+		{
+			RenderTarget target = s_Pool[i];
+			s_Pool.erase(s_Pool.begin() + i);
+			return target;
+		}
+	}
+
+	RenderTarget target = RenderingDevice::CreateRenderTarget(size.x, size.y);
+	s_MemoryUsed += target.Size;
+	return target;
+}
+
+static void ReleaseTarget(Layer& layer)
+{
+	if (!layer.Target.Image.Image)
+		return;
+
+	s_Pool.push_back(layer.Target);
+	layer.Target = {};
+	layer.Dirty = true;
+}
+
+void RenderLayers::Terminate()
+{
+	for (auto& [id, layer] : s_Layers)
+	{
+		if (layer.Target.Image.Image)
+			DestroyTarget(layer.Target);
+	}
+
+	for (const RenderTarget& target : s_Pool)
+		DestroyTarget(target);
+
+	s_Layers.clear();
+	s_Pool.clear();
+	s_MemoryUsed = 0;
+}
+
+void RenderLayers::SetMemoryBudget(vk::DeviceSize memoryBudget)
+{
+	s_MemoryBudget = memoryBudget;
+	EnforceBudget();
+}
+
+vk::DeviceSize RenderLayers::GetMemoryBudget()
+{
+	return s_MemoryBudget;
+}
+
+RenderLayerId RenderLayers::CreateLayer(sf::Vector2u size, const std::function<void()>& record, const RenderPassDesc& desc)
+{
+	Layer layer = {};
+	layer.Size = sf::Vector2u(std::max(size.x, 1u), std::max(size.y, 1u));
+	layer.Record = record;
+	layer.Desc = desc;
+
+	RenderLayerId id = s_NextLayer++;
+	s_Layers[id] = layer;
+	return id;
+}
+
+void RenderLayers::DestroyLayer(RenderLayerId layer)
+{
+	auto it = s_Layers.find(layer);
+	if (it == s_Layers.end())
+		return;
+
+	ReleaseTarget(it->second);
+	s_Layers.erase(it);
+	EnforceBudget();
+}
+
+void RenderLayers::ResizeLayer(RenderLayerId layer, sf::Vector2u size)
+{
+	auto it = s_Layers.find(layer);
+	if (it == s_Layers.end())
+		return;
+
+	size = sf::Vector2u(std::max(size.x, 1u), std::max(size.y, 1u));
+	if (size == it->second.Size)
+		return;
+
+	ReleaseTarget(it->second);
+	it->second.Size = size;
+	EnforceBudget();
+	FrameScheduler::Invalidate();
+}
+
+void RenderLayers::MarkDirty(RenderLayerId layer)
+{
+	auto it = s_Layers.find(layer);
+	if (it == s_Layers.end())
+		return;
+
+	it->second.Dirty = true;
+	FrameScheduler::Invalidate();
+}
+
+bool RenderLayers::IsDirty(RenderLayerId layer)
+{
+	auto it = s_Layers.find(layer);
+	return it != s_Layers.end() && it->second.Dirty;
+}
+
+bool RenderLayers::Prepare(RenderLayerId layerId)
+{
+	PROFILE_FUNCTION();
+
+	auto it = s_Layers.find(layerId);
+	if (it == s_Layers.end())
+		return false;
+
+	Layer& layer = it->second;
+	layer.LastUsed = RenderingDevice::GetFrameNumber();
+
+	if (layer.Target.Image.Image && !RenderingDevice::IsRenderTargetCompatible(layer.Target))
+	{
+		DestroyTarget(layer.Target);
+		layer.Target = {};
+	}
+
+	if (!layer.Target.Image.Image)
+	{
+		layer.Target = AcquireTarget(layer.Size);
+		layer.Dirty = true;
+		EnforceBudget();
+	}
+
+	if (layer.Dirty)
+	{
+		PROFILE_SCOPE("RenderLayer");
+
+		RenderingDevice::BeginRenderTargetPass(layer.Target, layer.Desc);
+		RenderingDevice::SetViewport(sf::Vector2f(0.0f, 0.0f), (sf::Vector2f)layer.Size);
+		RenderingDevice::SetScissors(sf::Vector2i(0, 0), (sf::Vector2i)layer.Size);
+		layer.Record();
+		RenderingDevice::EndRenderTargetPass();
+
+		layer.Dirty = false;
+		s_Renders++;
+	}
+
+	return true;
+}
+
+bool RenderLayers::Composite(RenderLayerId layerId, sf::Vector2i position, sf::Vector2i size)
+{
+	PROFILE_FUNCTION();
+
+	// Marked dirty or evicted since it was prepared
+	auto it = s_Layers.find(layerId);
+	if (it == s_Layers.end() || !it->second.Target.Image.Image || it->second.Dirty)
+		return false;
+
+	Layer& layer = it->second;
+	layer.LastUsed = RenderingDevice::GetFrameNumber();
+
+	if (size == sf::Vector2i())
+		size = (sf::Vector2i)layer.Size;
+
+	RenderingDevice::DrawRenderTarget(layer.Target, position, size);
+	s_Composites++;
+	return true;
+}
+
+RenderLayerStats RenderLayers::GetStats()
+{
+	RenderLayerStats stats = {};
+	stats.Layers = (sf::Uint32)s_Layers.size();
+	for (const auto& [id, layer] : s_Layers)
+		stats.ResidentLayers += layer.Target.Image.Image ? 1 : 0;
+	stats.PooledTargets = (sf::Uint32)s_Pool.size();
+	stats.MemoryUsed = s_MemoryUsed;
+	stats.MemoryBudget = s_MemoryBudget;
+	stats.Renders = s_Renders;
+	stats.Composites = s_Composites;
+	stats.Evictions = s_Evictions;
+	return stats;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+
+#include "RenderingDevice.hpp"
+
+typedef sf::Uint32 RenderLayerId;
+
+struct RenderLayerStats
+{
+	sf::Uint32 Layers = 0;
+	sf::Uint32 ResidentLayers = 0;		// Layers holding a render target
+	sf::Uint32 PooledTargets = 0;
+	vk::DeviceSize MemoryUsed = 0;		// Targets of layers & the pool
+	vk::DeviceSize MemoryBudget = 0;
+	sf::Uint64 Renders = 0;
+	sf::Uint64 Composites = 0;
+	sf::Uint64 Evictions = 0;
+};
+
+// Retained layers for content that rarely changes (backgrounds, HUD panels, static text). A layer's record callback
+// draws into an offscreen render target once, afterwards the layer is composited as a single textured quad per frame
+// until it is marked dirty. Released targets are pooled by size. Above the memory budget the pool is trimmed first,
+// then the targets of the least recently used layers are evicted, they are re-rendered on their next prepare.
+class RenderLayers
+{
+public:
+	// Destroys every layer & pooled target, called by the owner before RenderingDevice::Terminate
+	static void Terminate();
+
+	static void SetMemoryBudget(vk::DeviceSize memoryBudget);
+	static vk::DeviceSize GetMemoryBudget();
+
+	// The callback records with the usual RenderingDevice calls, viewport & scissors start out covering the layer
+	static RenderLayerId CreateLayer(sf::Vector2u size, const std::function<void()>& record, const RenderPassDesc& desc = {});
+	static void DestroyLayer(RenderLayerId layer);
+	static void ResizeLayer(RenderLayerId layer, sf::Vector2u size);
+	static void MarkDirty(RenderLayerId layer);
+	static bool IsDirty(RenderLayerId layer);
+
+	// Renders the layer when dirty or not resident. Within a frame and outside of passes, before the passes
+	// compositing it.
+	static bool Prepare(RenderLayerId layer);
+	// Draws the prepared layer blended over the current swapchain pass, see RenderingDevice::DrawRenderTarget.
+	// False when it was not prepared since its last change. A size of 0 keeps the layer's own size.
+	static bool Composite(RenderLayerId layer, sf::Vector2i position, sf::Vector2i size = {});
+
+	static RenderLayerStats GetStats();
+private:
+	RenderLayers();
+	RenderLayers(const RenderLayers&);
+};
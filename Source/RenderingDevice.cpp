@@ -1,12 +1,26 @@
 #include <cassert>
 #include <iostream>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 #include "RenderingDevice.hpp"
+#include "BarrierTracker.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuQueries.hpp"
+#include "FrameReadback.hpp"
+#include "DynamicResolution.hpp"
+#include "Profiler.hpp"
+#include "TraceCapture.hpp"
 
 #ifdef DEBUG
 static constexpr bool USE_VALIDATION_LAYERS = true;
@@ -22,32 +36,342 @@ static constexpr std::array<const char*, 1> DEVICE_EXTENSIONS = {
 	"VK_KHR_swapchain"
 };
 
+// Enabled when the device supports it
+static constexpr const char* INCREMENTAL_PRESENT_EXTENSION = "VK_KHR_incremental_present";
+
+// Before 1.3 the features come from the extensions they were promoted from. Dynamic rendering depends on depth
+// stencil resolve, which in turn needs create renderpass 2 (both core in 1.2, still advertised as extensions).
+static constexpr const char* SYNCHRONIZATION_2_EXTENSION = "VK_KHR_synchronization2";
+static constexpr std::array<const char*, 3> DYNAMIC_RENDERING_EXTENSIONS = {
+	"VK_KHR_dynamic_rendering",
+	"VK_KHR_depth_stencil_resolve",
+	"VK_KHR_create_renderpass2"
+};
+
+static constexpr sf::Uint32 MAX_FRAMES_IN_FLIGHT = 2;
+static constexpr sf::Uint32 MAX_DESCRIPTOR_SETS = 4;
+static constexpr sf::Uint32 MAX_PUSH_CONSTANT_SIZE = 128;
+static constexpr sf::Uint32 MAX_DESCRIPTOR_POOL_SETS = 1024;
+static constexpr sf::Uint32 FRAME_STATS_HISTORY = 60;
+static constexpr sf::Uint32 PRESENT_INTERVAL_HISTORY = 120;
+static constexpr sf::Uint32 DAMAGE_HISTORY = 8;
+
+static const char* COMPOSITE_VERTEX_SHADER_PATH = "Resources/layer_vert.spv";
+static const char* COMPOSITE_FRAGMENT_SHADER_PATH = "Resources/layer_frag.spv";
+
+static constexpr std::array<sf::Uint64 FrameStats::*, 11> FRAME_STATS_COUNTERS = {
+	&FrameStats::Draws,
+	&FrameStats::Instances,
+	&FrameStats::Triangles,
+	&FrameStats::PipelineBinds,
+	&FrameStats::VertexBufferBinds,
+	&FrameStats::DescriptorSetBinds,
+	&FrameStats::BytesUploaded,
+	&FrameStats::DescriptorAllocations,
+	&FrameStats::Barriers,
+	&FrameStats::Allocations,
+	&FrameStats::Frees
+};
+
+struct ThreadCommandPool
+{
+	vk::CommandPool CommandPool = {};
+	std::vector<vk::CommandBuffer> CommandBuffers = {};
+	sf::Uint32 UsedCount = {};
+	std::vector<vk::CommandBuffer> Recorded = {};
+};
+
+// Shadow of the state bound in a command buffer, used to drop redundant calls
+struct StateCache
+{
+	vk::Pipeline Pipeline = {};
+	vk::PipelineLayout PipelineLayout = {};
+	vk::Buffer VertexBuffer = {};
+	std::array<vk::DescriptorSet, MAX_DESCRIPTOR_SETS> DescriptorSets = {};
+	bool ViewportSet = {};
+	vk::Viewport Viewport = {};
+	bool ScissorSet = {};
+	vk::Rect2D Scissor = {};
+	std::array<sf::Uint8, MAX_PUSH_CONSTANT_SIZE> PushConstants = {};
+	sf::Uint32 PushConstantsBegin = {};
+	sf::Uint32 PushConstantsEnd = {};
+};
+
+struct FrameData
+{
+	vk::CommandBuffer CommandBuffer = {};
+	vk::Semaphore ImageReadySemaphore = {};
+	vk::Semaphore RenderReadySemaphore = {};
+	vk::Fence WaitFrameFence = {};
+	std::vector<ThreadCommandPool> ThreadCommandPools = {};
+};
+
+// Everything a swapchain recreation replaced or a released render target, destroyed once the frames begun before
+// it was retired completed
+struct RetiredResources
+{
+	sf::Uint64 FrameNumber = {};
+	vk::SwapchainKHR Swapchain = {};
+	std::vector<vk::Pipeline> Pipelines = {};
+	std::vector<vk::DescriptorSet> DescriptorSets = {};
+	std::vector<vk::Framebuffer> Framebuffers = {};
+	std::vector<vk::RenderPass> RenderPasses = {};
+	std::vector<vk::ImageView> ImageViews = {};
+	std::vector<VulkanImage> Images = {};
+	std::vector<VulkanBuffer> Buffers = {};
+	std::vector<vk::DeviceMemory> Memory = {};
+};
+
 static sf::WindowBase* s_Window = {};
 
+// Headless: the swapchain is replaced by offscreen images, one per frame in flight, rotated with the frame index
+static bool							s_Headless = {};
+static vk::Extent2D					s_HeadlessExtent = {};
+static std::vector<VulkanImage>		s_HeadlessImages = {};
+
 static vk::Instance					s_Instance = {};
 static vk::SurfaceKHR				s_Surface = {};
 static vk::PhysicalDevice			s_PhysicalDevice = {};
+static vk::PhysicalDeviceFeatures	s_EnabledFeatures = {};
+static vk::PhysicalDeviceVulkan13Features s_Vulkan13Features = {};
+static vk::PhysicalDeviceSynchronization2FeaturesKHR s_Synchronization2Features = {};
+static vk::PhysicalDeviceDynamicRenderingFeaturesKHR s_DynamicRenderingFeatures = {};
+static bool							s_Synchronization2 = {};
+static vk::DispatchLoaderDynamic	s_Dispatch = {};
 static sf::Uint32					s_QueueFamilyIndex = {};
 static vk::Device					s_Device = {};
 static vk::Queue					s_Queue = {};
 static vk::SurfaceCapabilitiesKHR	s_SurfaceCapabilities = {};
 static vk::SurfaceFormatKHR			s_SurfaceFormat = {};
-static vk::PresentModeKHR			s_PresentMode = {};
+static vk::PresentModeKHR			s_PresentMode = vk::PresentModeKHR::eFifo;
+static PresentSettings				s_PresentSettings = {};
 static vk::SwapchainKHR				s_Swapchain = {};
+static std::vector<vk::Image>		s_SwapchainImages = {};
 static std::vector<vk::ImageView>	s_ImageViews = {};
 static vk::RenderPass				s_RenderPass = {};
 static std::vector<vk::Framebuffer> s_Framebuffers = {};
+
+// With dynamic rendering pipelines only know the attachment formats, no render pass or framebuffer objects exist
+static bool							s_DynamicRendering = {};
+
+// Variants of s_RenderPass & s_SceneRenderPass with other load & store ops, compatible with their framebuffers
+static std::map<std::pair<vk::AttachmentLoadOp, vk::AttachmentStoreOp>, vk::RenderPass> s_RenderPassVariants = {};
 static vk::CommandPool				s_CommandPool = {};
-static vk::CommandBuffer			s_CommandBuffer = {};
 static vk::DescriptorPool			s_DescriptorPool = {};
 static sf::Uint32					s_SwapchainImageIndex = {};
-static vk::Semaphore				s_ImageReadySemaphore = {};
-static vk::Semaphore				s_RenderReadySemaphore = {};
-static vk::Fence					s_WaitFrameFence = {};
+static std::array<FrameData, MAX_FRAMES_IN_FLIGHT> s_Frames = {};
+static sf::Uint32					s_FrameIndex = {};
+static bool							s_FrameActive = {};
+static bool							s_ImplicitFrame = {};
+static sf::Uint64					s_FrameNumber = {};
+
+// Resizes only mark the swapchain dirty, it is recreated once before the next acquire. The old swapchain is handed
+// to its replacement and its resources are retired instead of waiting for the device to idle.
+static bool							s_SwapchainDirty = {};
+static std::vector<RetiredResources> s_RetiredResources = {};
+
+// No image could be acquired (minimized between the caller's check and the acquire), the frame is recorded but
+// neither submitted nor presented
+static bool							s_FrameSkipped = {};
+
+// Readback needs transfer source usage, and something rendered into the image this frame
+static bool							s_SwapchainReadable = {};
+static bool							s_SwapchainRendered = {};
+
+static std::vector<std::pair<FrameCallbackId, std::function<void()>>> s_FrameEndCallbacks = {};
+static FrameCallbackId				s_NextFrameCallback = 1;
+
+// Depth & multisampled color images are shared by every frame, the render pass orders the writes of consecutive
+// frames. Neither is ever stored, so both are transient & lazily allocated where the device allows it.
+static bool							s_DepthBuffer = {};
+static vk::Format					s_DepthFormat = {};
+static VulkanImage					s_DepthImage = {};
+static vk::ImageView				s_DepthView = {};
+static vk::SampleCountFlagBits		s_SampleCount = vk::SampleCountFlagBits::e1;
+static VulkanImage					s_MultisampleImage = {};
+static vk::ImageView				s_MultisampleView = {};
+static vk::DeviceSize				s_TransientAllocated = {};
+static vk::DeviceSize				s_TransientEagerSize = {};
+static std::vector<vk::DeviceMemory> s_TransientLazyMemory = {};
+
+// Damage tracking: the first pass of a frame computes the area damaged since the acquired image was last rendered,
+// every pass of the frame keeps the image's contents and only renders inside that area. Frame numbers of the
+// damage history are per image, 0 when its contents are unknown.
+static bool							s_DamageTracking = {};
+static bool							s_IncrementalPresent = {};
+static std::vector<vk::Rect2D>		s_FrameDamage = {};
+static std::array<vk::Rect2D, DAMAGE_HISTORY> s_DamageHistory = {};
+static std::vector<sf::Uint64>		s_ImageRenderedFrame = {};
+static vk::Rect2D					s_DamageArea = {};
+static bool							s_DamageRestricted = {};
+
+// Render target pass, its framebuffer is created per pass & retired right away since targets are rarely re-rendered
+static bool							s_RenderTargetActive = {};
+static RenderTarget					s_RenderTarget = {};
+
+// Draws render targets as textured quads. The pipeline is created on first use and again once the swapchain's
+// attachments it was made for changed, the set layout & sampler live as long as the device.
+static vk::DescriptorSetLayout		s_CompositeSetLayout = {};
+static vk::Sampler					s_CompositeSampler = {};
+static VulkanShader					s_CompositeShader = {};
+static vk::Format					s_CompositeFormat = {};
+static vk::SampleCountFlagBits		s_CompositeSampleCount = {};
+static bool							s_CompositeDepth = {};
+
+// Dynamic resolution: the render pass targets a per frame offscreen image sized for the largest scale,
+// only the render extent of it is used and blitted to the swapchain at the end of the pass
+static bool							s_DynamicResolution = {};
+static bool							s_SwapchainBlittable = {};
+static vk::Filter					s_UpscaleFilter = {};
+static vk::RenderPass				s_SceneRenderPass = {};
+static std::vector<VulkanImage>		s_SceneTargets = {};
+static std::vector<vk::ImageView>	s_SceneViews = {};
+static std::vector<vk::Framebuffer>	s_SceneFramebuffers = {};
+static vk::Extent2D					s_SceneExtent = {};
+static vk::Extent2D					s_RenderExtent = {};
+static sf::Uint64					s_ResolutionResultsFrame = {};
+static bool							s_ScenePassActive = {};
+static sf::Vector2f					s_ViewportScale = { 1.0f, 1.0f };
+
+// Command buffer the calling thread records into: the frame's primary on the main thread, a secondary on workers
+static thread_local vk::CommandBuffer	t_CommandBuffer = {};
+static thread_local sf::Uint32			t_ThreadIndex = {};
+static thread_local StateCache			t_StateCache = {};
+static thread_local RedundantStateStats	t_RedundantStateStats = {};
+static thread_local FrameStats			t_FrameStats = {};
+
+// Present() call times, the interval spanning a swapchain recreation is skipped
+static std::array<sf::Uint64, PRESENT_INTERVAL_HISTORY> s_PresentIntervals = {};
+static sf::Uint64						s_PresentIntervalCount = {};
+static sf::Uint64						s_LastPresentTime = {};
+
+// Per-thread counters are merged into the pending values, which are published at the end of the frame
+static std::mutex						s_StatsMutex = {};
+static RedundantStateStats				s_PendingRedundantStateStats = {};
+static RedundantStateStats				s_RedundantStateStats = {};
+static FrameStats						s_PendingFrameStats = {};
+static std::array<FrameStats, FRAME_STATS_HISTORY> s_FrameStatsHistory = {};
+static FrameStats						s_FrameStatsSum = {};
+static sf::Uint64						s_FrameStatsCount = {};
+
+static void AccumulateFrameStats(FrameStats& target, const FrameStats& source)
+{
+	for (sf::Uint64 FrameStats::* counter : FRAME_STATS_COUNTERS)
+		target.*counter += source.*counter;
+}
+
+static vk::PresentModeKHR ToPresentMode(PresentPolicy policy)
+{
+	switch (policy)
+	{
+	case PresentPolicy::LowLatency: return vk::PresentModeKHR::eMailbox;
+	case PresentPolicy::Uncapped: return vk::PresentModeKHR::eImmediate;
+	case PresentPolicy::Adaptive: return vk::PresentModeKHR::eFifoRelaxed;
+	default: return vk::PresentModeKHR::eFifo;
+	}
+}
+
+// Zero sized rects are empty
+static vk::Rect2D UniteRects(const vk::Rect2D& a, const vk::Rect2D& b)
+{
+	if (a.extent.width == 0 || a.extent.height == 0)
+		return b;
+	if (b.extent.width == 0 || b.extent.height == 0)
+		return a;
+
+	sf::Int32 left = std::min(a.offset.x, b.offset.x);
+	sf::Int32 top = std::min(a.offset.y, b.offset.y);
+	sf::Int32 right = std::max(a.offset.x + (sf::Int32)a.extent.width, b.offset.x + (sf::Int32)b.extent.width);
+	sf::Int32 bottom = std::max(a.offset.y + (sf::Int32)a.extent.height, b.offset.y + (sf::Int32)b.extent.height);
+	return vk::Rect2D(vk::Offset2D(left, top), vk::Extent2D(right - left, bottom - top));
+}
+
+static std::vector<sf::Uint32> ReadShaderCode(const sf::String& filePath)
+{
+	sf::FileInputStream file = {};
+	bool opened = file.open(filePath);
+	assert(opened);
+
+	sf::Int64 size = file.getSize();
+	assert(size != -1);
+
+	std::vector<sf::Uint32> code((size + 3) / 4);
+	sf::Int64 read = file.read(code.data(), size);
+	assert(read == size);
+
+	return code;
+}
+
+static vk::ImageAspectFlags GetDepthAspect(vk::Format format)
+{
+	bool stencil = format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
+	return vk::ImageAspectFlagBits::eDepth | (stencil ? vk::ImageAspectFlagBits::eStencil : vk::ImageAspectFlags());
+}
+
+static void RecordPresentInterval()
+{
+	sf::Uint64 now = Profiler::GetTime();
+	if (s_LastPresentTime != 0)
+	{
+		s_PresentIntervals[s_PresentIntervalCount % PRESENT_INTERVAL_HISTORY] = now - s_LastPresentTime;
+		s_PresentIntervalCount++;
+	}
+
+	s_LastPresentTime = now;
+}
+
+static void DestroyRetiredResources(const RetiredResources& retired)
+{
+	for (const vk::Pipeline& pipeline : retired.Pipelines)
+		s_Device.destroyPipeline(pipeline);
+	if (!retired.DescriptorSets.empty())
+		s_Device.freeDescriptorSets(s_DescriptorPool, retired.DescriptorSets);
+	for (const vk::Framebuffer& framebuffer : retired.Framebuffers)
+		s_Device.destroyFramebuffer(framebuffer);
+	for (const vk::RenderPass& renderPass : retired.RenderPasses)
+		s_Device.destroyRenderPass(renderPass);
+	for (const vk::ImageView& imageView : retired.ImageViews)
+		s_Device.destroyImageView(imageView);
+
+	// Images & buffers bound to memory owned elsewhere have no memory of their own
+	for (const VulkanImage& image : retired.Images)
+	{
+		BarrierTracker::UnregisterImage(image.Image);
+		s_Device.destroyImage(image.Image);
+		if (image.Memory)
+		{
+			s_Device.freeMemory(image.Memory);
+			t_FrameStats.Frees++;
+		}
+	}
+
+	for (const VulkanBuffer& buffer : retired.Buffers)
+	{
+		BarrierTracker::UnregisterBuffer(buffer.Buffer);
+		s_Device.destroyBuffer(buffer.Buffer);
+		if (buffer.Memory)
+		{
+			s_Device.freeMemory(buffer.Memory);
+			t_FrameStats.Frees++;
+		}
+	}
+
+	for (const vk::DeviceMemory& memory : retired.Memory)
+	{
+		s_Device.freeMemory(memory);
+		t_FrameStats.Frees++;
+	}
+
+	if (retired.Swapchain)
+		s_Device.destroySwapchainKHR(retired.Swapchain);
+}
 
 void RenderingDevice::Initialize(sf::WindowBase* window)
 {
+	PROFILE_FUNCTION();
+
 	s_Window = window;
+	s_Headless = false;
 	assert(s_Window);
 
 	if (!sf::Vulkan::isAvailable())
@@ -68,55 +392,93 @@ void RenderingDevice::Initialize(sf::WindowBase* window)
 		return;
 	}
 
+	InitializeDevice();
+}
+
+bool RenderingDevice::InitializeHeadless(sf::Vector2u extent)
+{
+	PROFILE_FUNCTION();
+
+	s_Window = {};
+	s_Headless = true;
+	s_HeadlessExtent = vk::Extent2D(extent.x, extent.y);
+
+	// No surface extensions are needed, so any loader & ICD works (e.g. lavapipe)
+	if (!sf::Vulkan::isAvailable(false))
+	{
+		std::cerr << "Vulkan is NOT supported (Failed to find loader)\n";
+		return false;
+	}
+
+	CreateInstance();
+
+	s_PhysicalDevice = FindPhysicalDevice();
+	if (!s_PhysicalDevice)
+	{
+		std::cerr << "Vulkan is NOT supported (Failed to find GPU)\n";
+		return false;
+	}
+
+	InitializeDevice();
+	return true;
+}
+
+void RenderingDevice::InitializeDevice()
+{
 	s_QueueFamilyIndex = FindQueueFamily(vk::QueueFlagBits::eGraphics);
+	s_DepthFormat = FindDepthFormat();
 	CreateDevice();
 
 	CreateSwapchain();
 
+	// Linear filtering of the upscale blit & scaled render targets when the format supports it
+	vk::FormatProperties formatProperties = s_PhysicalDevice.getFormatProperties(s_SurfaceFormat.format);
+	s_UpscaleFilter = formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear ? vk::Filter::eLinear : vk::Filter::eNearest;
+
 	CreateCommandPool();
-	s_CommandBuffer = AllocateCommandBuffer();
+	CreateDescriptorPool();
+	CreateCompositeLayout();
+	for (FrameData& frame : s_Frames)
+		frame.CommandBuffer = AllocateCommandBuffer();
 
 	CreateSynchronization();
+
+	GpuProfiler::Initialize(MAX_FRAMES_IN_FLIGHT, s_QueueFamilyIndex);
+	GpuQueries::Initialize(MAX_FRAMES_IN_FLIGHT);
+	FrameReadback::Initialize(MAX_FRAMES_IN_FLIGHT);
 }
 
 void RenderingDevice::Terminate()
 {
+	PROFILE_FUNCTION();
+
 	DestroyAll();
 	s_Window = {};
+	s_Headless = false;
+	s_DynamicResolution = false;
+	s_DepthBuffer = false;
+	s_SampleCount = vk::SampleCountFlagBits::e1;
 }
 
-VulkanShader RenderingDevice::CreateShader(const sf::String& vsFilePath, const sf::String& fsFilePath)
+VulkanShader RenderingDevice::CreateShader(const sf::String& vsFilePath, const sf::String& fsFilePath, DepthMode depthMode)
 {
-	VulkanShader vulkanShader = {};
-
-	// Read vertex shader
-
-	sf::FileInputStream vsFile = {};
-	assert(vsFile.open(vsFilePath));
-
-	sf::Int64 vsSize = vsFile.getSize();
-	assert(vsSize != -1);
+	PROFILE_FUNCTION();
 
-	std::vector<sf::Uint32> vsBuffer(vsSize);
-	assert(vsFile.read(vsBuffer.data(), vsSize) == vsSize);
-
-	// Read fragment shader
-
-	sf::FileInputStream fsFile = {};
-	assert(fsFile.open(fsFilePath));
+	return CreateShader(ReadShaderCode(vsFilePath), ReadShaderCode(fsFilePath), depthMode);
+}
 
-	sf::Int64 fsSize = fsFile.getSize();
-	assert(fsSize != -1);
+VulkanShader RenderingDevice::CreateShader(const std::vector<sf::Uint32>& vsCode, const std::vector<sf::Uint32>& fsCode, DepthMode depthMode)
+{
+	PROFILE_FUNCTION();
 
-	std::vector<sf::Uint32> fsBuffer(fsSize);
-	assert(fsFile.read(fsBuffer.data(), fsSize) == fsSize);
+	VulkanShader vulkanShader = {};
 
 	// Create vertex shader
-	vk::ShaderModuleCreateInfo vertexModuleCreateInfo(vk::ShaderModuleCreateFlags(), vsBuffer.size(), vsBuffer.data());
+	vk::ShaderModuleCreateInfo vertexModuleCreateInfo(vk::ShaderModuleCreateFlags(), vsCode.size() * sizeof(sf::Uint32), vsCode.data());
 	vk::ShaderModule vertexModule = s_Device.createShaderModule(vertexModuleCreateInfo);
 
 	// Create fragment shader
-	vk::ShaderModuleCreateInfo fragmentModuleCreateInfo(vk::ShaderModuleCreateFlags(), fsBuffer.size(), fsBuffer.data());
+	vk::ShaderModuleCreateInfo fragmentModuleCreateInfo(vk::ShaderModuleCreateFlags(), fsCode.size() * sizeof(sf::Uint32), fsCode.data());
 	vk::ShaderModule fragmentModule = s_Device.createShaderModule(fragmentModuleCreateInfo);
 
 	// Pipeline stages
@@ -139,7 +501,12 @@ VulkanShader RenderingDevice::CreateShader(const sf::String& vsFilePath, const s
 
 	// Rasterizer & Multisampling
 	vk::PipelineRasterizationStateCreateInfo rasterizationState(vk::PipelineRasterizationStateCreateFlags(), false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f);
-	vk::PipelineMultisampleStateCreateInfo multisampleState(vk::PipelineMultisampleStateCreateFlags(), vk::SampleCountFlagBits::e1, false, 1.0f, nullptr, false, false);
+	vk::PipelineMultisampleStateCreateInfo multisampleState(vk::PipelineMultisampleStateCreateFlags(), s_SampleCount, false, 1.0f, nullptr, false, false);
+
+	// Depth, less or equal so geometry drawn twice at the same depth still passes
+	bool depthTest = s_DepthBuffer && depthMode != DepthMode::Disabled;
+	bool depthWrite = s_DepthBuffer && depthMode == DepthMode::TestAndWrite;
+	vk::PipelineDepthStencilStateCreateInfo depthStencilState(vk::PipelineDepthStencilStateCreateFlags(), depthTest, depthWrite, vk::CompareOp::eLessOrEqual, false, false, {}, {}, 0.0f, 1.0f);
 
 	// Color blending
 	vk::PipelineColorBlendAttachmentState colorBlendAttachment(true, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
@@ -147,9 +514,14 @@ VulkanShader RenderingDevice::CreateShader(const sf::String& vsFilePath, const s
 	vk::PipelineColorBlendStateCreateInfo colorBlendState(vk::PipelineColorBlendStateCreateFlags(), false, vk::LogicOp::eCopy, colorBlendAttachment);
 
 	// Create pipeline layout
-	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), nullptr, nullptr);
+	vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, MAX_PUSH_CONSTANT_SIZE);
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), nullptr, pushConstantRange);
 	vulkanShader.PipelineLayout = s_Device.createPipelineLayout(pipelineLayoutCreateInfo);
 
+	// Dynamic rendering pipelines only depend on the attachment formats, resizes never touch them
+	vk::Format colorFormat = s_SurfaceFormat.format;
+	vk::PipelineRenderingCreateInfo renderingCreateInfo(0, colorFormat, s_DepthBuffer ? s_DepthFormat : vk::Format::eUndefined, vk::Format::eUndefined);
+
 	// Create graphics pipeline
 	vk::GraphicsPipelineCreateInfo pipelineCreateInfo(vk::PipelineCreateFlags(),
 		stages,
@@ -159,11 +531,13 @@ VulkanShader RenderingDevice::CreateShader(const sf::String& vsFilePath, const s
 		&viewportState,
 		&rasterizationState,
 		&multisampleState,
-		nullptr,
+		s_DepthBuffer ? &depthStencilState : nullptr,
 		&colorBlendState,
 		&dynamicState,
 		vulkanShader.PipelineLayout,
-		s_RenderPass);
+		s_DynamicRendering ? nullptr : s_RenderPass);
+	if (s_DynamicRendering)
+		pipelineCreateInfo.pNext = &renderingCreateInfo;
 
 	vk::ResultValue<vk::Pipeline> result = s_Device.createGraphicsPipeline(nullptr, pipelineCreateInfo);
 	assert(result.result == vk::Result::eSuccess);
@@ -173,11 +547,19 @@ VulkanShader RenderingDevice::CreateShader(const sf::String& vsFilePath, const s
 	s_Device.destroyShaderModule(vertexModule);
 	s_Device.destroyShaderModule(fragmentModule);
 
+	if (TraceCapture::IsCapturing())
+		TraceCapture::CreateShader(vulkanShader.Pipeline, vsCode, fsCode, depthMode, s_SampleCount);
+
 	return vulkanShader;
 }
 
 void RenderingDevice::DestroyShader(VulkanShader vulkanShader)
 {
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::DestroyShader(vulkanShader.Pipeline);
+
 	s_Device.waitIdle();
 	s_Device.destroyPipelineLayout(vulkanShader.PipelineLayout);
 	s_Device.destroyPipeline(vulkanShader.Pipeline);
@@ -187,6 +569,8 @@ void RenderingDevice::DestroyShader(VulkanShader vulkanShader)
 
 VulkanBuffer RenderingDevice::CreateVertexBuffer(const std::vector<sf::Vector3f>& vertices)
 {
+	PROFILE_FUNCTION();
+
 	// Calculate buffer size in bytes
 	vk::DeviceSize size = sizeof(sf::Vector3f) * vertices.size();
 
@@ -200,135 +584,1412 @@ VulkanBuffer RenderingDevice::CreateVertexBuffer(const std::vector<sf::Vector3f>
 	}
 	s_Device.unmapMemory(vertexBuffer.Memory);
 
+	t_FrameStats.BytesUploaded += size;
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::CreateVertexBuffer(vertexBuffer.Buffer, vertices);
+
 	return vertexBuffer;
 }
 
 void RenderingDevice::DestroyVertexBuffer(VulkanBuffer vertexBuffer)
 {
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::DestroyVertexBuffer(vertexBuffer.Buffer);
+
 	s_Device.waitIdle();
 	s_Device.destroyBuffer(vertexBuffer.Buffer);
 	s_Device.freeMemory(vertexBuffer.Memory);
+	t_FrameStats.Frees++;
 	vertexBuffer.Buffer = nullptr;
 	vertexBuffer.Memory = nullptr;
 }
 
 void RenderingDevice::SetViewport(sf::Vector2f position, sf::Vector2f size)
 {
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::SetViewport(position, size);
+
+	// Callers work in swapchain coordinates, the scene target only covers the scaled render extent
+	if (s_ScenePassActive)
+	{
+		position = sf::Vector2f(position.x * s_ViewportScale.x, position.y * s_ViewportScale.y);
+		size = sf::Vector2f(size.x * s_ViewportScale.x, size.y * s_ViewportScale.y);
+	}
+
 	vk::Viewport viewport(position.x, position.y, size.x, size.y, 0.0f, 1.0f);
-	s_CommandBuffer.setViewport(0, viewport);
+	if (t_StateCache.ViewportSet && t_StateCache.Viewport == viewport)
+	{
+		t_RedundantStateStats.Viewports++;
+		return;
+	}
+
+	t_CommandBuffer.setViewport(0, viewport);
+	t_StateCache.Viewport = viewport;
+	t_StateCache.ViewportSet = true;
 }
 
 void RenderingDevice::SetScissors(sf::Vector2i offset, sf::Vector2i extent)
 {
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::SetScissors(offset, extent);
+
+	// Rounded outwards so scaled scissors never cut pixels the viewport covers
+	if (s_ScenePassActive)
+	{
+		sf::Vector2i end((sf::Int32)std::ceil((offset.x + extent.x) * s_ViewportScale.x), (sf::Int32)std::ceil((offset.y + extent.y) * s_ViewportScale.y));
+		offset = sf::Vector2i((sf::Int32)std::floor(offset.x * s_ViewportScale.x), (sf::Int32)std::floor(offset.y * s_ViewportScale.y));
+		extent = end - offset;
+	}
+
+	// Drawing outside the render area is undefined
+	if (s_DamageRestricted && !s_RenderTargetActive)
+	{
+		sf::Vector2i begin(std::max(offset.x, s_DamageArea.offset.x), std::max(offset.y, s_DamageArea.offset.y));
+		sf::Vector2i end(std::min(offset.x + extent.x, s_DamageArea.offset.x + (sf::Int32)s_DamageArea.extent.width), std::min(offset.y + extent.y, s_DamageArea.offset.y + (sf::Int32)s_DamageArea.extent.height));
+		offset = begin;
+		extent = sf::Vector2i(std::max(end.x - begin.x, 0), std::max(end.y - begin.y, 0));
+	}
+
 	vk::Rect2D scissor(vk::Offset2D(offset.x, offset.y), vk::Extent2D(extent.x, extent.y));
-	s_CommandBuffer.setScissor(0, scissor);
+	if (t_StateCache.ScissorSet && t_StateCache.Scissor == scissor)
+	{
+		t_RedundantStateStats.Scissors++;
+		return;
+	}
+
+	t_CommandBuffer.setScissor(0, scissor);
+	t_StateCache.Scissor = scissor;
+	t_StateCache.ScissorSet = true;
 }
 
 void RenderingDevice::BindShader(VulkanShader& vulkanShader)
 {
-	s_CommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, vulkanShader.Pipeline);
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::BindShader(vulkanShader.Pipeline);
+
+	if (t_StateCache.Pipeline == vulkanShader.Pipeline)
+	{
+		t_RedundantStateStats.Pipelines++;
+		return;
+	}
+
+	t_CommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, vulkanShader.Pipeline);
+	t_StateCache.Pipeline = vulkanShader.Pipeline;
+	t_FrameStats.PipelineBinds++;
+
+	// Bound descriptor sets & push constants are only kept for the same layout
+	if (t_StateCache.PipelineLayout != vulkanShader.PipelineLayout)
+	{
+		t_StateCache.PipelineLayout = vulkanShader.PipelineLayout;
+		t_StateCache.DescriptorSets = {};
+		t_StateCache.PushConstantsBegin = 0;
+		t_StateCache.PushConstantsEnd = 0;
+	}
 }
 
 void RenderingDevice::BindVertexBuffer(VulkanBuffer& vertexBuffer)
 {
-	s_CommandBuffer.bindVertexBuffers(0, vertexBuffer.Buffer, { 0 });
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::BindVertexBuffer(vertexBuffer.Buffer);
+
+	if (t_StateCache.VertexBuffer == vertexBuffer.Buffer)
+	{
+		t_RedundantStateStats.VertexBuffers++;
+		return;
+	}
+
+	t_CommandBuffer.bindVertexBuffers(0, vertexBuffer.Buffer, { 0 });
+	t_StateCache.VertexBuffer = vertexBuffer.Buffer;
+	t_FrameStats.VertexBufferBinds++;
+}
+
+void RenderingDevice::BindDescriptorSet(VulkanShader& vulkanShader, vk::DescriptorSet descriptorSet, sf::Uint32 setIndex)
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::BindDescriptorSet(vulkanShader.Pipeline, descriptorSet, setIndex);
+
+	assert(setIndex < MAX_DESCRIPTOR_SETS);
+	if (t_StateCache.PipelineLayout == vulkanShader.PipelineLayout && t_StateCache.DescriptorSets[setIndex] == descriptorSet)
+	{
+		t_RedundantStateStats.DescriptorSets++;
+		return;
+	}
+
+	t_CommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, vulkanShader.PipelineLayout, setIndex, descriptorSet, nullptr);
+	t_StateCache.DescriptorSets[setIndex] = descriptorSet;
+	t_FrameStats.DescriptorSetBinds++;
+}
+
+void RenderingDevice::PushConstants(VulkanShader& vulkanShader, const void* data, sf::Uint32 size, sf::Uint32 offset)
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::PushConstants(vulkanShader.Pipeline, data, size, offset);
+
+	assert(offset + size <= MAX_PUSH_CONSTANT_SIZE);
+
+	StateCache& cache = t_StateCache;
+	bool known = cache.PipelineLayout == vulkanShader.PipelineLayout && offset >= cache.PushConstantsBegin && offset + size <= cache.PushConstantsEnd;
+	if (known && std::memcmp(cache.PushConstants.data() + offset, data, size) == 0)
+	{
+		t_RedundantStateStats.PushConstants++;
+		return;
+	}
+
+	t_CommandBuffer.pushConstants(vulkanShader.PipelineLayout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, offset, size, data);
+	std::memcpy(cache.PushConstants.data() + offset, data, size);
+
+	// Track a single known range, disjoint pushes replace it
+	if (cache.PipelineLayout == vulkanShader.PipelineLayout && offset <= cache.PushConstantsEnd && offset + size >= cache.PushConstantsBegin && cache.PushConstantsEnd > 0)
+	{
+		cache.PushConstantsBegin = std::min(cache.PushConstantsBegin, offset);
+		cache.PushConstantsEnd = std::max(cache.PushConstantsEnd, offset + size);
+	}
+	else
+	{
+		cache.PushConstantsBegin = offset;
+		cache.PushConstantsEnd = offset + size;
+	}
+}
+
+void RenderingDevice::Draw(sf::Uint32 count, sf::Uint32 instanceCount, sf::Uint32 firstVertex, sf::Uint32 firstInstance)
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::Draw(count, instanceCount, firstVertex, firstInstance);
+
+	t_CommandBuffer.draw(count, instanceCount, firstVertex, firstInstance);
+
+	// Every pipeline uses a triangle list
+	t_FrameStats.Draws++;
+	t_FrameStats.Instances += instanceCount;
+	t_FrameStats.Triangles += (sf::Uint64)(count / 3) * instanceCount;
+}
+
+vk::DescriptorSet RenderingDevice::AllocateDescriptorSet(vk::DescriptorSetLayout layout)
+{
+	PROFILE_FUNCTION();
+
+	vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo(s_DescriptorPool, layout);
+	vk::DescriptorSet descriptorSet = s_Device.allocateDescriptorSets(descriptorSetAllocateInfo).front();
+	t_FrameStats.DescriptorAllocations++;
+
+	return descriptorSet;
 }
 
-void RenderingDevice::Draw(sf::Uint32 count)
+void RenderingDevice::FreeDescriptorSet(vk::DescriptorSet descriptorSet)
 {
-	s_CommandBuffer.draw(count, 1, 0, 0);
+	PROFILE_FUNCTION();
+
+	s_Device.freeDescriptorSets(s_DescriptorPool, descriptorSet);
 }
 
 void RenderingDevice::RecreateSwapchain()
 {
-	vk::Extent2D extent = s_PhysicalDevice.getSurfaceCapabilitiesKHR(s_Surface).currentExtent;
-	while (extent.width == 0 || extent.height == 0)
+	PROFILE_FUNCTION();
+
+	assert(!s_FrameActive);
+
+	// Minimized, the swapchain stays dirty until the window has an extent again. Waiting is up to the caller.
+	if (!s_Headless)
+	{
+		vk::Extent2D extent = s_PhysicalDevice.getSurfaceCapabilitiesKHR(s_Surface).currentExtent;
+		if (extent.width == 0 || extent.height == 0)
+		{
+			s_SwapchainDirty = true;
+			return;
+		}
+	}
+
+	ReleaseRetiredResources(false);
+
+	vk::SwapchainKHR oldSwapchain = s_Swapchain;
+	RetireSwapchain();
+	CreateSwapchain(oldSwapchain);
+
+	s_SwapchainDirty = false;
+}
+
+void RenderingDevice::RequestSwapchainRecreate()
+{
+	s_SwapchainDirty = true;
+}
+
+void RenderingDevice::RetireSwapchain()
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.Swapchain = s_Swapchain;
+
+	retired.Framebuffers = std::move(s_Framebuffers);
+	retired.Framebuffers.insert(retired.Framebuffers.end(), s_SceneFramebuffers.begin(), s_SceneFramebuffers.end());
+
+	for (const auto& [key, renderPass] : s_RenderPassVariants)
+		retired.RenderPasses.push_back(renderPass);
+	if (s_RenderPass)
+		retired.RenderPasses.push_back(s_RenderPass);
+	if (s_SceneRenderPass)
+		retired.RenderPasses.push_back(s_SceneRenderPass);
+
+	retired.ImageViews = std::move(s_ImageViews);
+	retired.ImageViews.insert(retired.ImageViews.end(), s_SceneViews.begin(), s_SceneViews.end());
+	if (s_DepthView)
+		retired.ImageViews.push_back(s_DepthView);
+	if (s_MultisampleView)
+		retired.ImageViews.push_back(s_MultisampleView);
+
+	retired.Images = std::move(s_HeadlessImages);
+	retired.Images.insert(retired.Images.end(), s_SceneTargets.begin(), s_SceneTargets.end());
+	if (s_DepthImage.Image)
+		retired.Images.push_back(s_DepthImage);
+	if (s_MultisampleImage.Image)
+		retired.Images.push_back(s_MultisampleImage);
+
+	s_RetiredResources.push_back(std::move(retired));
+
+	// Headless images are unregistered once destroyed, the swapchain's own are never recorded again
+	if (!s_Headless)
+	{
+		for (const vk::Image& image : s_SwapchainImages)
+			BarrierTracker::UnregisterImage(image);
+	}
+
+	s_Swapchain = nullptr;
+	s_ImageViews.clear();
+	s_HeadlessImages.clear();
+	s_Framebuffers.clear();
+	s_RenderPassVariants.clear();
+	s_RenderPass = nullptr;
+
+	s_SceneFramebuffers.clear();
+	s_SceneViews.clear();
+	s_SceneTargets.clear();
+	s_SceneRenderPass = nullptr;
+
+	s_DepthView = nullptr;
+	s_DepthImage = {};
+	s_MultisampleView = nullptr;
+	s_MultisampleImage = {};
+	s_TransientAllocated = 0;
+	s_TransientEagerSize = 0;
+	s_TransientLazyMemory.clear();
+
+	s_ImageRenderedFrame.clear();
+}
+
+void RenderingDevice::ReleaseRetiredResources(bool deviceIdle)
+{
+	// Without frames in flight (e.g. several recreations in a row) nothing can use the retired resources anymore
+	bool framesComplete = deviceIdle;
+	if (!framesComplete)
+	{
+		framesComplete = true;
+		for (const FrameData& frame : s_Frames)
+			framesComplete &= s_Device.getFenceStatus(frame.WaitFrameFence) == vk::Result::eSuccess;
+	}
+
+	// Every frame begun before the recreation waited on its fence again once MAX_FRAMES_IN_FLIGHT frames began since
+	for (size_t i = 0; i < s_RetiredResources.size();)
+	{
+		if (!framesComplete && s_RetiredResources[i].FrameNumber + MAX_FRAMES_IN_FLIGHT > s_FrameNumber)
+		{
+			i++;
+			continue;
+		}
+
+		DestroyRetiredResources(s_RetiredResources[i]);
+		s_RetiredResources.erase(s_RetiredResources.begin() + i);
+	}
+}
+
+void RenderingDevice::BeginFrame()
+{
+	PROFILE_FUNCTION();
+
+	FrameData& frame = s_Frames[s_FrameIndex];
+
+	// Wait for the last frame that used these resources
+	{
+		PROFILE_SCOPE("WaitForFence");
+		while (s_Device.waitForFences(frame.WaitFrameFence, true, UINT64_MAX) == vk::Result::eTimeout);
+		s_Device.resetFences(frame.WaitFrameFence);
+	}
+
+	// Copies recorded the last time this frame ran are complete
+	FrameReadback::BeginFrame(s_FrameIndex);
+	s_SwapchainRendered = false;
+
+	// Reset every secondary command buffer of this frame in bulk
+	for (ThreadCommandPool& threadCommandPool : frame.ThreadCommandPools)
+	{
+		s_Device.resetCommandPool(threadCommandPool.CommandPool);
+		threadCommandPool.UsedCount = 0;
+		threadCommandPool.Recorded.clear();
+	}
+
+	s_FrameNumber++;
+	ReleaseRetiredResources(false);
+
+	// Frames that never begin a pass are treated as fully damaged
+	s_DamageHistory[s_FrameNumber % DAMAGE_HISTORY] = vk::Rect2D(vk::Offset2D(0, 0), s_SurfaceCapabilities.currentExtent);
+	s_DamageRestricted = false;
+
+	// Every resize since the last frame is handled by a single recreation, still dirty afterwards means minimized
+	if (s_SwapchainDirty)
+		RecreateSwapchain();
+	s_FrameSkipped = s_SwapchainDirty;
+
+	{
+		PROFILE_SCOPE("AcquireNextImage");
+
+		// Get image from swapchain, offscreen images are owned by the frame and ready once its fence signalled
+		if (s_Headless)
+			s_SwapchainImageIndex = s_FrameIndex;
+
+		while (!s_Headless && !s_FrameSkipped)
+		{
+			try
+			{
+				vk::ResultValue<sf::Uint32> acquired = s_Device.acquireNextImageKHR(s_Swapchain, UINT64_MAX, frame.ImageReadySemaphore);
+				s_SwapchainImageIndex = acquired.value;
+
+				// The submission waits for the semaphore at the color output stage, the first transition chains after it
+				vk::Image image = s_SwapchainImages[s_SwapchainImageIndex];
+				BarrierTracker::SetImageState(image, BarrierTracker::GetImageLayout(image), ResourceUsage::ColorAttachment);
+
+				// Still presentable, recreate before the next frame
+				if (acquired.result == vk::Result::eSuboptimalKHR)
+					s_SwapchainDirty = true;
+				break;
+			}
+			catch (const vk::OutOfDateKHRError&) // Swapchain outdated, the semaphore was not signalled
+			{
+				RecreateSwapchain();
+				s_FrameSkipped = s_SwapchainDirty;
+			}
+			catch (const vk::SystemError& error) // Unexpected error happened
+			{
+				// Print error
+				std::cerr << error.what() << "\n";
+				break;
+			}
+		}
+	}
+
+	if (s_DynamicResolution)
+		UpdateRenderExtent();
+
+	// Transitions recorded into a dropped command buffer never happen
+	if (s_FrameSkipped)
+		BarrierTracker::SaveState();
+
+	// Begin command buffer
+	frame.CommandBuffer.reset();
+	frame.CommandBuffer.begin(vk::CommandBufferBeginInfo());
+	t_CommandBuffer = frame.CommandBuffer;
+	InvalidateStateCache();
+
+	if (!s_FrameSkipped)
+	{
+		GpuProfiler::BeginFrame(s_FrameIndex, frame.CommandBuffer);
+		GpuQueries::BeginFrame(s_FrameIndex, frame.CommandBuffer);
+	}
+
+	s_FrameActive = true;
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::BeginFrame();
+}
+
+void RenderingDevice::EndFrame()
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::EndFrame();
+
+	FrameData& frame = s_Frames[s_FrameIndex];
+
+	// The recording is dropped, an empty submission still signals the fence the next use of this frame waits on
+	if (s_FrameSkipped)
+	{
+		frame.CommandBuffer.end();
+		s_Queue.submit(nullptr, frame.WaitFrameFence);
+		BarrierTracker::RestoreState();
+		s_FrameActive = false;
+		return;
+	}
+
+	if (s_SwapchainRendered)
+	{
+		for (const auto& [id, callback] : s_FrameEndCallbacks)
+			callback();
+
+		FrameReadback::EndFrame(frame.CommandBuffer, s_SwapchainReadable ? GetSwapchainImage() : nullptr, GetSwapchainExtent(), s_SurfaceFormat.format);
+	}
+
+	if (!s_Headless)
 	{
-		sf::Event event = {};
-		s_Window->waitEvent(event);
-		extent = s_PhysicalDevice.getSurfaceCapabilitiesKHR(s_Surface).currentExtent;
+		BarrierTracker::TransitionImage(GetSwapchainImage(), ResourceUsage::Present);
+		BarrierTracker::Flush(frame.CommandBuffer);
 	}
 
-	DestroySwapchain();
-	CreateSwapchain();
+	GpuQueries::EndFrame(frame.CommandBuffer);
+	GpuProfiler::EndFrame(frame.CommandBuffer);
+
+	// End command buffer
+	frame.CommandBuffer.end();
+
+	// Ensures that the color output is finished rendering before continuing
+	vk::PipelineStageFlags pipelineStageFlags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+
+	// Submit render commands to GPU
+	vk::SubmitInfo submitInfo(frame.ImageReadySemaphore, pipelineStageFlags, frame.CommandBuffer, frame.RenderReadySemaphore);
+	if (s_Headless)
+		submitInfo = vk::SubmitInfo(nullptr, nullptr, frame.CommandBuffer, nullptr);
+	{
+		PROFILE_SCOPE("QueueSubmit");
+		s_Queue.submit(submitInfo, frame.WaitFrameFence);
+	}
+
+	// Publish this frame's counters, the rolling sum drops the frame that falls out of the history
+	FlushThreadStats();
+	{
+		std::lock_guard<std::mutex> lock(s_StatsMutex);
+		s_RedundantStateStats = s_PendingRedundantStateStats;
+		s_PendingRedundantStateStats = {};
+
+		FrameStats& slot = s_FrameStatsHistory[s_FrameStatsCount % FRAME_STATS_HISTORY];
+		for (sf::Uint64 FrameStats::* counter : FRAME_STATS_COUNTERS)
+			s_FrameStatsSum.*counter += s_PendingFrameStats.*counter - slot.*counter;
+
+		slot = s_PendingFrameStats;
+		s_PendingFrameStats = {};
+		s_FrameStatsCount++;
+	}
+
+	s_FrameActive = false;
+}
+
+void RenderingDevice::BeginRenderPass(vk::SubpassContents contents)
+{
+	BeginRenderPass(RenderPassDesc(), contents);
+}
+
+void RenderingDevice::BeginRenderPass(const RenderPassDesc& desc, vk::SubpassContents contents)
+{
+	PROFILE_FUNCTION();
+
+	// Frame is begun implicitly when the caller does not manage it
+	s_ImplicitFrame = !s_FrameActive;
+	if (s_ImplicitFrame)
+		BeginFrame();
+
+	if (!s_SwapchainRendered)
+		UpdateDamageArea();
+
+	// Nothing to keep before the first pass of the frame unless the damage restricts it, and the multisampled
+	// attachment never holds earlier contents
+	RenderPassDesc passDesc = desc;
+	if (passDesc.ColorLoadOp == vk::AttachmentLoadOp::eLoad && ((!s_SwapchainRendered && !s_DamageRestricted) || s_SampleCount != vk::SampleCountFlagBits::e1))
+		passDesc.ColorLoadOp = vk::AttachmentLoadOp::eClear;
+
+	s_SwapchainRendered = true;
+
+	// Recorded after the implicit frame, the replay then sees an explicit BeginFrame/EndFrame pair
+	if (TraceCapture::IsCapturing())
+		TraceCapture::BeginRenderPass(desc, contents);
+
+	GpuProfiler::BeginScope("RenderPass");
+
+	// Without damage restriction the previous contents are only kept when loaded
+	s_ScenePassActive = s_DynamicResolution;
+	vk::Image target = s_ScenePassActive ? s_SceneTargets[s_FrameIndex].Image : s_SwapchainImages[s_SwapchainImageIndex];
+	TransitionPassAttachments(target, s_DepthImage.Image, s_MultisampleImage.Image, passDesc.ColorLoadOp == vk::AttachmentLoadOp::eLoad || s_DamageRestricted);
+
+	if (s_DynamicRendering)
+	{
+		BeginDynamicRendering(passDesc, contents);
+	}
+	else
+	{
+		// Render area & Clear values, in attachment order. The clear only covers the render area.
+		std::array<vk::ClearValue, 3> clearValues = {};
+		sf::Uint32 clearValueCount = 0;
+		clearValues[clearValueCount++] = passDesc.ClearColor;
+		if (s_DepthBuffer)
+			clearValues[clearValueCount++] = passDesc.ClearDepth;
+		if (s_SampleCount != vk::SampleCountFlagBits::e1)
+			clearValues[clearValueCount++] = passDesc.ClearColor;
+
+		bool defaultOps = passDesc.ColorLoadOp == vk::AttachmentLoadOp::eClear && passDesc.ColorStoreOp == vk::AttachmentStoreOp::eStore;
+
+		// Begin render pass
+		vk::RenderPass renderPass = defaultOps ? s_RenderPass : GetRenderPass(passDesc);
+		vk::RenderPassBeginInfo renderPassBeginInfo(renderPass, s_Framebuffers[s_SwapchainImageIndex], s_DamageArea, clearValueCount, clearValues.data());
+		if (s_ScenePassActive)
+		{
+			renderPassBeginInfo.renderPass = defaultOps ? s_SceneRenderPass : renderPass;
+			renderPassBeginInfo.framebuffer = s_SceneFramebuffers[s_FrameIndex];
+			renderPassBeginInfo.renderArea.extent = s_RenderExtent;
+		}
+
+		t_CommandBuffer.beginRenderPass(renderPassBeginInfo, contents);
+	}
+
+	// Drawing outside the render area is undefined, so passes start scissored to the damage
+	if (s_DamageRestricted && contents == vk::SubpassContents::eInline)
+	{
+		t_CommandBuffer.setScissor(0, s_DamageArea);
+		t_StateCache.Scissor = s_DamageArea;
+		t_StateCache.ScissorSet = true;
+	}
+}
+
+void RenderingDevice::EndRenderPass()
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::EndRenderPass();
+
+	// End render pass
+	if (s_DynamicRendering)
+		EndDynamicRendering();
+	else
+		t_CommandBuffer.endRenderPass();
+
+	GpuProfiler::EndScope();
+
+	if (s_ScenePassActive)
+	{
+		UpscaleSceneTarget();
+		s_ScenePassActive = false;
+	}
+
+	if (s_ImplicitFrame)
+		EndFrame();
+
+	s_ImplicitFrame = false;
+}
+
+void RenderingDevice::BeginDynamicRendering(const RenderPassDesc& desc, vk::SubpassContents contents)
+{
+	bool multisampled = s_SampleCount != vk::SampleCountFlagBits::e1;
+
+	vk::ImageView targetView = s_ScenePassActive ? s_SceneViews[s_FrameIndex] : s_ImageViews[s_SwapchainImageIndex];
+	vk::ImageView depthView = s_DepthView;
+	vk::ImageView multisampleView = s_MultisampleView;
+	vk::Extent2D extent = s_ScenePassActive ? s_RenderExtent : s_SurfaceCapabilities.currentExtent;
+	if (s_RenderTargetActive)
+	{
+		targetView = s_RenderTarget.View;
+		depthView = s_RenderTarget.DepthView;
+		multisampleView = s_RenderTarget.MultisampleView;
+		extent = s_RenderTarget.Extent;
+	}
+
+	// Samples are resolved into the target at the end of rendering, while still in tile memory
+	vk::RenderingAttachmentInfo colorAttachment(multisampled ? multisampleView : targetView,
+		vk::ImageLayout::eColorAttachmentOptimal,
+		vk::ResolveModeFlagBits::eNone,
+		nullptr,
+		vk::ImageLayout::eUndefined,
+		desc.ColorLoadOp,
+		multisampled ? vk::AttachmentStoreOp::eDontCare : desc.ColorStoreOp,
+		desc.ClearColor);
+	if (multisampled)
+	{
+		colorAttachment.resolveMode = vk::ResolveModeFlagBits::eAverage;
+		colorAttachment.resolveImageView = targetView;
+		colorAttachment.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+	}
+
+	vk::RenderingAttachmentInfo depthAttachment(depthView,
+		vk::ImageLayout::eDepthStencilAttachmentOptimal,
+		vk::ResolveModeFlagBits::eNone,
+		nullptr,
+		vk::ImageLayout::eUndefined,
+		vk::AttachmentLoadOp::eClear,
+		vk::AttachmentStoreOp::eDontCare,
+		desc.ClearDepth);
+
+	vk::RenderingFlags flags = contents == vk::SubpassContents::eSecondaryCommandBuffers ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags();
+	vk::Rect2D renderArea = s_ScenePassActive || s_RenderTargetActive ? vk::Rect2D(vk::Offset2D(0, 0), extent) : s_DamageArea;
+	vk::RenderingInfo renderingInfo(flags, renderArea, 1, 0, colorAttachment, s_DepthBuffer ? &depthAttachment : nullptr);
+	t_CommandBuffer.beginRendering(renderingInfo, s_Dispatch);
+}
+
+void RenderingDevice::EndDynamicRendering()
+{
+	t_CommandBuffer.endRendering(s_Dispatch);
+}
+
+void RenderingDevice::TransitionPassAttachments(vk::Image target, vk::Image depth, vk::Image multisample, bool keep)
+{
+	// Attachments stay in attachment layouts for the whole pass, so both paths render from the same transitions.
+	// Depth & multisampled images are reused by every pass, their previous writes have to finish first.
+	if (!keep)
+		BarrierTracker::DiscardImage(target);
+	BarrierTracker::TransitionImage(target, ResourceUsage::ColorAttachment);
+
+	if (s_DepthBuffer)
+	{
+		BarrierTracker::DiscardImage(depth);
+		BarrierTracker::TransitionImage(depth, ResourceUsage::DepthAttachment);
+	}
+
+	if (s_SampleCount != vk::SampleCountFlagBits::e1)
+	{
+		BarrierTracker::DiscardImage(multisample);
+		BarrierTracker::TransitionImage(multisample, ResourceUsage::ColorAttachment);
+	}
+
+	BarrierTracker::Flush(t_CommandBuffer);
+}
+
+void RenderingDevice::Present()
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::Present();
+
+	// Nothing to present to, the next frame simply rotates to its own image
+	if (s_Headless || s_FrameSkipped)
+	{
+		RecordPresentInterval();
+		s_FrameDamage.clear();
+		s_FrameIndex = (s_FrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+		return;
+	}
+
+	try
+	{
+		vk::PresentInfoKHR presentInfo(s_Frames[s_FrameIndex].RenderReadySemaphore, s_Swapchain, s_SwapchainImageIndex);
+
+		// Only this frame's rects changed since the last present. No rects would mean the whole image changed.
+		std::vector<vk::RectLayerKHR> rects = {};
+		vk::PresentRegionKHR presentRegion = {};
+		vk::PresentRegionsKHR presentRegions = {};
+		if (s_IncrementalPresent && s_DamageRestricted)
+		{
+			for (const vk::Rect2D& rect : s_FrameDamage)
+				rects.push_back(vk::RectLayerKHR(rect.offset, rect.extent, 0));
+			if (rects.empty())
+				rects.push_back(vk::RectLayerKHR(vk::Offset2D(0, 0), vk::Extent2D(1, 1), 0));
+
+			presentRegion.setRectangles(rects);
+			presentRegions.setRegions(presentRegion);
+			presentInfo.pNext = &presentRegions;
+		}
+
+		// Present the rendered image
+		vk::Result result = s_Queue.presentKHR(presentInfo);
+		if (result == vk::Result::eSuboptimalKHR)
+			s_SwapchainDirty = true;
+	}
+	catch (const vk::OutOfDateKHRError&) // Swapchain outdated
+	{
+		// Recreated before the next acquire
+		s_SwapchainDirty = true;
+	}
+	catch (const vk::SystemError& error) // Unexpected error happened
+	{
+		// Print error
+		std::cerr << error.what() << "\n";
+	}
+
+	RecordPresentInterval();
+	s_FrameDamage.clear();
+
+	s_FrameIndex = (s_FrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+RenderTarget RenderingDevice::CreateRenderTarget(sf::Uint32 width, sf::Uint32 height)
+{
+	PROFILE_FUNCTION();
+
+	RenderTarget target = {};
+	target.Extent = vk::Extent2D(std::max(width, 1u), std::max(height, 1u));
+	target.SampleCount = s_SampleCount;
+
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+	target.Image = CreateImage(target.Extent.width, target.Extent.height, s_SurfaceFormat.format, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	target.View = CreateImageView(target.Image.Image, s_SurfaceFormat.format);
+	target.Size = s_Device.getImageMemoryRequirements(target.Image.Image).size;
+	BarrierTracker::RegisterImage(target.Image.Image, vk::ImageAspectFlagBits::eColor);
+
+	// Sized like the target, the swapchain's are only as large as the swapchain
+	if (s_DepthBuffer)
+	{
+		target.DepthImage = CreateTransientImage(target.Extent.width, target.Extent.height, s_DepthFormat, vk::ImageUsageFlagBits::eDepthStencilAttachment, false);
+		target.DepthView = CreateImageView(target.DepthImage.Image, s_DepthFormat, vk::ImageAspectFlagBits::eDepth);
+		target.Size += s_Device.getImageMemoryRequirements(target.DepthImage.Image).size;
+		BarrierTracker::RegisterImage(target.DepthImage.Image, GetDepthAspect(s_DepthFormat));
+	}
+
+	if (s_SampleCount != vk::SampleCountFlagBits::e1)
+	{
+		target.MultisampleImage = CreateTransientImage(target.Extent.width, target.Extent.height, s_SurfaceFormat.format, vk::ImageUsageFlagBits::eColorAttachment, false);
+		target.MultisampleView = CreateImageView(target.MultisampleImage.Image, s_SurfaceFormat.format);
+		target.Size += s_Device.getImageMemoryRequirements(target.MultisampleImage.Image).size;
+		BarrierTracker::RegisterImage(target.MultisampleImage.Image, vk::ImageAspectFlagBits::eColor);
+	}
+
+	target.DescriptorSet = AllocateDescriptorSet(s_CompositeSetLayout);
+	vk::DescriptorImageInfo imageInfo(s_CompositeSampler, target.View, vk::ImageLayout::eShaderReadOnlyOptimal);
+	vk::WriteDescriptorSet descriptorWrite(target.DescriptorSet, 0, 0, vk::DescriptorType::eCombinedImageSampler, imageInfo);
+	s_Device.updateDescriptorSets(descriptorWrite, nullptr);
+
+	return target;
+}
+
+bool RenderingDevice::IsRenderTargetCompatible(const RenderTarget& target)
+{
+	return target.SampleCount == s_SampleCount && (bool)target.DepthImage.Image == s_DepthBuffer;
+}
+
+void RenderingDevice::DestroyRenderTarget(const RenderTarget& target)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.DescriptorSets.push_back(target.DescriptorSet);
+	retired.ImageViews.push_back(target.View);
+	retired.Images.push_back(target.Image);
+	if (target.DepthImage.Image)
+	{
+		retired.ImageViews.push_back(target.DepthView);
+		retired.Images.push_back(target.DepthImage);
+	}
+	if (target.MultisampleImage.Image)
+	{
+		retired.ImageViews.push_back(target.MultisampleView);
+		retired.Images.push_back(target.MultisampleImage);
+	}
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::DestroyFramebuffer(vk::Framebuffer framebuffer)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.Framebuffers.push_back(framebuffer);
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::DestroyRenderPass(vk::RenderPass renderPass)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.RenderPasses.push_back(renderPass);
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::DestroyImageView(vk::ImageView imageView)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.ImageViews.push_back(imageView);
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::RetireImage(VulkanImage image)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.Images.push_back(image);
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::RetireBuffer(VulkanBuffer buffer)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.Buffers.push_back(buffer);
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::RetireMemory(vk::DeviceMemory memory)
+{
+	RetiredResources retired = {};
+	retired.FrameNumber = s_FrameNumber;
+	retired.Memory.push_back(memory);
+	s_RetiredResources.push_back(std::move(retired));
+}
+
+void RenderingDevice::BeginRenderTargetPass(const RenderTarget& target, const RenderPassDesc& desc)
+{
+	PROFILE_FUNCTION();
+
+	assert(s_FrameActive && !s_RenderTargetActive);
+	assert(IsRenderTargetCompatible(target));
+
+	// Earlier contents of the target are never kept
+	RenderPassDesc passDesc = desc;
+	if (passDesc.ColorLoadOp == vk::AttachmentLoadOp::eLoad)
+		passDesc.ColorLoadOp = vk::AttachmentLoadOp::eClear;
+
+	s_RenderTarget = target;
+	s_RenderTargetActive = true;
+
+	// Draws into the target are not captured, the replay has no render targets
+	TraceCapture::Suspend();
+
+	GpuProfiler::BeginScope("RenderTargetPass");
+
+	// Also waits for composites of earlier frames still sampling the target
+	TransitionPassAttachments(target.Image.Image, target.DepthImage.Image, target.MultisampleImage.Image, false);
+
+	if (s_DynamicRendering)
+	{
+		BeginDynamicRendering(passDesc, vk::SubpassContents::eInline);
+		return;
+	}
+
+	std::array<vk::ClearValue, 3> clearValues = {};
+	sf::Uint32 clearValueCount = 0;
+	clearValues[clearValueCount++] = passDesc.ClearColor;
+	if (s_DepthBuffer)
+		clearValues[clearValueCount++] = passDesc.ClearDepth;
+	if (s_SampleCount != vk::SampleCountFlagBits::e1)
+		clearValues[clearValueCount++] = passDesc.ClearColor;
+
+	vk::Framebuffer framebuffer = CreateFramebuffer(target.View, target.DepthView, target.MultisampleView, target.Extent.width, target.Extent.height);
+	DestroyFramebuffer(framebuffer);
+
+	vk::RenderPass renderPass = GetRenderPass(passDesc);
+	vk::RenderPassBeginInfo renderPassBeginInfo(renderPass, framebuffer, vk::Rect2D(vk::Offset2D(0, 0), target.Extent), clearValueCount, clearValues.data());
+	t_CommandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+}
+
+void RenderingDevice::EndRenderTargetPass()
+{
+	PROFILE_FUNCTION();
+
+	assert(s_RenderTargetActive);
+
+	if (s_DynamicRendering)
+		EndDynamicRendering();
+	else
+		t_CommandBuffer.endRenderPass();
+
+	GpuProfiler::EndScope();
+
+	// Sampled by the composites of this & later frames
+	BarrierTracker::TransitionImage(s_RenderTarget.Image.Image, ResourceUsage::FragmentShaderRead);
+	BarrierTracker::Flush(t_CommandBuffer);
+
+	TraceCapture::Resume();
+
+	s_RenderTarget = {};
+	s_RenderTargetActive = false;
+}
+
+void RenderingDevice::DrawRenderTarget(const RenderTarget& target, sf::Vector2i position, sf::Vector2i size)
+{
+	PROFILE_FUNCTION();
+
+	assert(s_FrameActive && !s_RenderTargetActive);
+	assert(BarrierTracker::GetImageLayout(target.Image.Image) == vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	if (size.x <= 0 || size.y <= 0)
+		return;
+
+	if (!s_CompositeShader.Pipeline || s_CompositeFormat != s_SurfaceFormat.format || s_CompositeSampleCount != s_SampleCount || s_CompositeDepth != s_DepthBuffer)
+		CreateCompositeShader();
+
+	// The replay knows neither the pipeline nor the target, it keeps the state the caller set before
+	TraceCapture::Suspend();
+
+	// The viewport stretches the quad over the rect, scissors clip it to the rect & the damage (never negative)
+	sf::Vector2i begin(std::max(position.x, 0), std::max(position.y, 0));
+	sf::Vector2i end(std::max(position.x + size.x, begin.x), std::max(position.y + size.y, begin.y));
+	SetViewport((sf::Vector2f)position, (sf::Vector2f)size);
+	SetScissors(begin, end - begin);
+	BindShader(s_CompositeShader);
+	BindDescriptorSet(s_CompositeShader, target.DescriptorSet);
+	Draw(6);
+
+	TraceCapture::Resume();
+}
+
+sf::Uint64 RenderingDevice::GetFrameNumber()
+{
+	return s_FrameNumber;
+}
+
+FrameCallbackId RenderingDevice::AddFrameEndCallback(const std::function<void()>& callback)
+{
+	FrameCallbackId id = s_NextFrameCallback++;
+	s_FrameEndCallbacks.push_back({ id, callback });
+	return id;
+}
+
+void RenderingDevice::RemoveFrameEndCallback(FrameCallbackId id)
+{
+	for (size_t i = 0; i < s_FrameEndCallbacks.size(); i++)
+	{
+		if (s_FrameEndCallbacks[i].first == id)
+		{
+			s_FrameEndCallbacks.erase(s_FrameEndCallbacks.begin() + i);
+			return;
+		}
+	}
+}
+
+void RenderingDevice::SetPresentSettings(const PresentSettings& settings)
+{
+	if (settings.Policy == s_PresentSettings.Policy && settings.ImageCount == s_PresentSettings.ImageCount)
+		return;
+
+	s_PresentSettings = settings;
+
+	if (s_Device && !s_Headless)
+		s_SwapchainDirty = true;
+}
+
+PresentSettings RenderingDevice::GetPresentSettings()
+{
+	return s_PresentSettings;
+}
+
+PresentStats RenderingDevice::GetPresentStats()
+{
+	PresentStats stats = {};
+	stats.PresentMode = s_PresentMode;
+	stats.ImageCount = (sf::Uint32)s_SwapchainImages.size();
+	stats.IntervalCount = (sf::Uint32)std::min<sf::Uint64>(s_PresentIntervalCount, PRESENT_INTERVAL_HISTORY);
+	if (stats.IntervalCount == 0)
+		return stats;
+
+	sf::Uint64 sum = 0;
+	sf::Uint64 minimum = UINT64_MAX;
+	sf::Uint64 maximum = 0;
+	for (sf::Uint32 i = 0; i < stats.IntervalCount; i++)
+	{
+		sum += s_PresentIntervals[i];
+		minimum = std::min(minimum, s_PresentIntervals[i]);
+		maximum = std::max(maximum, s_PresentIntervals[i]);
+	}
+
+	stats.LastInterval = s_PresentIntervals[(s_PresentIntervalCount - 1) % PRESENT_INTERVAL_HISTORY] / 1000000.0;
+	stats.AverageInterval = sum / (double)stats.IntervalCount / 1000000.0;
+	stats.MinInterval = minimum / 1000000.0;
+	stats.MaxInterval = maximum / 1000000.0;
+	return stats;
+}
+
+void RenderingDevice::SetDamageTrackingEnabled(bool enabled)
+{
+	s_DamageTracking = enabled;
+
+	// Contents rendered meanwhile were not tracked
+	s_ImageRenderedFrame.clear();
+}
+
+bool RenderingDevice::IsDamageTrackingEnabled()
+{
+	return s_DamageTracking;
+}
+
+bool RenderingDevice::SupportsIncrementalPresent()
+{
+	return s_IncrementalPresent;
+}
+
+void RenderingDevice::AddDamage(sf::Vector2i offset, sf::Vector2i extent)
+{
+	// Clipped to the image, rects outside of it damage nothing
+	vk::Extent2D imageExtent = s_SurfaceCapabilities.currentExtent;
+	sf::Vector2i begin(std::max(offset.x, 0), std::max(offset.y, 0));
+	sf::Vector2i end(std::min(offset.x + extent.x, (sf::Int32)imageExtent.width), std::min(offset.y + extent.y, (sf::Int32)imageExtent.height));
+	if (end.x <= begin.x || end.y <= begin.y)
+		return;
+
+	s_FrameDamage.push_back(vk::Rect2D(vk::Offset2D(begin.x, begin.y), vk::Extent2D(end.x - begin.x, end.y - begin.y)));
+}
+
+vk::Rect2D RenderingDevice::GetDamageArea()
+{
+	return s_DamageArea;
+}
+
+void RenderingDevice::UpdateDamageArea()
+{
+	s_DamageArea = vk::Rect2D(vk::Offset2D(0, 0), s_SurfaceCapabilities.currentExtent);
+	s_DamageRestricted = false;
+
+	if (!s_DamageTracking)
+		return;
+
+	vk::Rect2D bounds = {};
+	for (const vk::Rect2D& rect : s_FrameDamage)
+		bounds = UniteRects(bounds, rect);
+	s_DamageHistory[s_FrameNumber % DAMAGE_HISTORY] = bounds;
+
+	if (s_ImageRenderedFrame.size() != s_SwapchainImages.size())
+		s_ImageRenderedFrame.assign(s_SwapchainImages.size(), 0);
+	sf::Uint64 renderedFrame = s_ImageRenderedFrame[s_SwapchainImageIndex];
+	s_ImageRenderedFrame[s_SwapchainImageIndex] = s_FrameNumber;
+
+	// The multisampled attachment cannot be loaded and the scene target is upscaled as a whole
+	if (renderedFrame == 0 || s_FrameNumber - renderedFrame >= DAMAGE_HISTORY || s_SampleCount != vk::SampleCountFlagBits::e1 || s_DynamicResolution)
+		return;
+
+	// The image shows renderedFrame, everything damaged since has to be rendered again
+	vk::Rect2D area = {};
+	for (sf::Uint64 frameNumber = renderedFrame + 1; frameNumber <= s_FrameNumber; frameNumber++)
+		area = UniteRects(area, s_DamageHistory[frameNumber % DAMAGE_HISTORY]);
+
+	// Render areas cannot be empty, loading & storing a single pixel changes nothing
+	if (area.extent.width == 0 || area.extent.height == 0)
+		area = vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(1, 1));
+
+	s_DamageArea = area;
+	s_DamageRestricted = true;
+}
+
+void RenderingDevice::SetRecordingThreadCount(sf::Uint32 threadCount)
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::SetRecordingThreadCount(threadCount);
+
+	DestroyThreadCommandPools();
+
+	// Transient pools: buffers are never reset individually, only the whole pool once per frame
+	vk::CommandPoolCreateInfo commandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient, s_QueueFamilyIndex);
+
+	for (FrameData& frame : s_Frames)
+	{
+		frame.ThreadCommandPools.resize(threadCount);
+		for (ThreadCommandPool& threadCommandPool : frame.ThreadCommandPools)
+			threadCommandPool.CommandPool = s_Device.createCommandPool(commandPoolCreateInfo);
+	}
+}
+
+void RenderingDevice::BeginSecondaryCommandBuffer(sf::Uint32 threadIndex)
+{
+	PROFILE_FUNCTION();
+
+	ThreadCommandPool& threadCommandPool = s_Frames[s_FrameIndex].ThreadCommandPools[threadIndex];
+
+	// Command buffers are kept across frames and only allocated when a thread needs more than before
+	if (threadCommandPool.UsedCount == threadCommandPool.CommandBuffers.size())
+	{
+		vk::CommandBufferAllocateInfo commandBufferAllocateInfo(threadCommandPool.CommandPool, vk::CommandBufferLevel::eSecondary, 1);
+		threadCommandPool.CommandBuffers.push_back(s_Device.allocateCommandBuffers(commandBufferAllocateInfo).front());
+	}
+
+	vk::CommandBuffer commandBuffer = threadCommandPool.CommandBuffers[threadCommandPool.UsedCount++];
+
+	// Viewport & scissors are not inherited, every secondary has to set them
+	vk::Format colorFormat = s_SurfaceFormat.format;
+	vk::CommandBufferInheritanceRenderingInfo renderingInheritance(vk::RenderingFlags(), 0, colorFormat, s_DepthBuffer ? s_DepthFormat : vk::Format::eUndefined, vk::Format::eUndefined, s_SampleCount);
+	vk::CommandBufferInheritanceInfo inheritanceInfo = {};
+	if (s_DynamicRendering)
+		inheritanceInfo.pNext = &renderingInheritance;
+	else if (s_ScenePassActive)
+		inheritanceInfo = vk::CommandBufferInheritanceInfo(s_SceneRenderPass, 0, s_SceneFramebuffers[s_FrameIndex]);
+	else
+		inheritanceInfo = vk::CommandBufferInheritanceInfo(s_RenderPass, 0, s_Framebuffers[s_SwapchainImageIndex]);
+	vk::CommandBufferBeginInfo commandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit, &inheritanceInfo);
+	commandBuffer.begin(commandBufferBeginInfo);
+
+	t_CommandBuffer = commandBuffer;
+	t_ThreadIndex = threadIndex;
+	InvalidateStateCache();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::BeginSecondaryCommandBuffer(threadIndex);
+}
+
+void RenderingDevice::EndSecondaryCommandBuffer()
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::EndSecondaryCommandBuffer();
+
+	t_CommandBuffer.end();
+
+	// Each thread only touches its own pool, no locking needed
+	s_Frames[s_FrameIndex].ThreadCommandPools[t_ThreadIndex].Recorded.push_back(t_CommandBuffer);
+	t_CommandBuffer = nullptr;
+
+	FlushThreadStats();
+}
+
+void RenderingDevice::ExecuteSecondaryCommandBuffers()
+{
+	PROFILE_FUNCTION();
+
+	if (TraceCapture::IsCapturing())
+		TraceCapture::ExecuteSecondaryCommandBuffers();
+
+	// Execute in thread order so the result does not depend on scheduling
+	std::vector<vk::CommandBuffer> commandBuffers = {};
+	for (ThreadCommandPool& threadCommandPool : s_Frames[s_FrameIndex].ThreadCommandPools)
+	{
+		commandBuffers.insert(commandBuffers.end(), threadCommandPool.Recorded.begin(), threadCommandPool.Recorded.end());
+		threadCommandPool.Recorded.clear();
+	}
+
+	if (!commandBuffers.empty())
+		t_CommandBuffer.executeCommands(commandBuffers);
+
+	// Primary state is undefined after executing secondaries
+	InvalidateStateCache();
+}
+
+void RenderingDevice::InvalidateStateCache()
+{
+	t_StateCache = {};
+}
+
+void RenderingDevice::FlushThreadStats()
+{
+	std::lock_guard<std::mutex> lock(s_StatsMutex);
+	s_PendingRedundantStateStats.Pipelines += t_RedundantStateStats.Pipelines;
+	s_PendingRedundantStateStats.VertexBuffers += t_RedundantStateStats.VertexBuffers;
+	s_PendingRedundantStateStats.DescriptorSets += t_RedundantStateStats.DescriptorSets;
+	s_PendingRedundantStateStats.Viewports += t_RedundantStateStats.Viewports;
+	s_PendingRedundantStateStats.Scissors += t_RedundantStateStats.Scissors;
+	s_PendingRedundantStateStats.PushConstants += t_RedundantStateStats.PushConstants;
+	t_RedundantStateStats = {};
+
+	AccumulateFrameStats(s_PendingFrameStats, t_FrameStats);
+	t_FrameStats = {};
+}
+
+vk::Device RenderingDevice::GetDevice()
+{
+	return s_Device;
+}
+
+vk::PhysicalDevice RenderingDevice::GetPhysicalDevice()
+{
+	return s_PhysicalDevice;
+}
+
+vk::CommandBuffer RenderingDevice::GetCommandBuffer()
+{
+	return t_CommandBuffer;
+}
+
+vk::Image RenderingDevice::GetSwapchainImage()
+{
+	return s_SwapchainImages[s_SwapchainImageIndex];
+}
+
+vk::ImageView RenderingDevice::GetSwapchainImageView()
+{
+	return s_ImageViews[s_SwapchainImageIndex];
+}
+
+vk::Format RenderingDevice::GetSwapchainFormat()
+{
+	return s_SurfaceFormat.format;
+}
+
+vk::Extent2D RenderingDevice::GetSwapchainExtent()
+{
+	return s_SurfaceCapabilities.currentExtent;
+}
+
+const vk::PhysicalDeviceFeatures& RenderingDevice::GetEnabledFeatures()
+{
+	return s_EnabledFeatures;
+}
+
+bool RenderingDevice::SupportsSynchronization2()
+{
+	return s_Synchronization2;
+}
+
+const vk::DispatchLoaderDynamic& RenderingDevice::GetDispatch()
+{
+	return s_Dispatch;
+}
+
+bool RenderingDevice::UsesDynamicRendering()
+{
+	return s_DynamicRendering;
+}
+
+bool RenderingDevice::IsHeadless()
+{
+	return s_Headless;
+}
+
+bool RenderingDevice::EnableDynamicResolution(const DynamicResolutionSettings& settings)
+{
+	PROFILE_FUNCTION();
+
+	assert(!s_FrameActive);
+
+	if (!s_SwapchainBlittable)
+		return false;
+
+	DynamicResolution::Configure(settings);
+
+	s_Device.waitIdle();
+	DestroySceneTargets();
+	s_DynamicResolution = true;
+
+	// Transient attachments are sized for the largest scale
+	if (s_DepthBuffer || s_SampleCount != vk::SampleCountFlagBits::e1)
+		RecreateSwapchain();
+	else
+		CreateSceneTargets();
+	return true;
+}
+
+void RenderingDevice::DisableDynamicResolution()
+{
+	PROFILE_FUNCTION();
+
+	assert(!s_FrameActive);
+
+	s_Device.waitIdle();
+	DestroySceneTargets();
+	s_DynamicResolution = false;
+
+	if (s_DepthBuffer || s_SampleCount != vk::SampleCountFlagBits::e1)
+		RecreateSwapchain();
+}
+
+void RenderingDevice::SetDepthBufferEnabled(bool enabled)
+{
+	PROFILE_FUNCTION();
+
+	assert(!s_FrameActive);
+
+	if (enabled == s_DepthBuffer)
+		return;
+
+	if (enabled && s_Device && s_DepthFormat == vk::Format::eUndefined)
+		return;
+
+	s_DepthBuffer = enabled;
+
+	// Render pass & framebuffers change their attachments
+	if (s_Device)
+		RecreateSwapchain();
+}
+
+bool RenderingDevice::IsDepthBufferEnabled()
+{
+	return s_DepthBuffer;
+}
+
+vk::Format RenderingDevice::GetDepthFormat()
+{
+	return s_DepthFormat;
+}
+
+vk::SampleCountFlagBits RenderingDevice::SetSampleCount(vk::SampleCountFlagBits sampleCount)
+{
+	PROFILE_FUNCTION();
+
+	assert(!s_FrameActive);
+
+	// Highest supported count not above the requested one, the depth buffer has to match the color samples
+	if (s_PhysicalDevice)
+	{
+		vk::PhysicalDeviceLimits limits = s_PhysicalDevice.getProperties().limits;
+		vk::SampleCountFlags supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+		while (sampleCount != vk::SampleCountFlagBits::e1 && !(supported & sampleCount))
+			sampleCount = (vk::SampleCountFlagBits)((sf::Uint32)sampleCount >> 1);
+	}
+
+	if (sampleCount == s_SampleCount)
+		return s_SampleCount;
+
+	s_SampleCount = sampleCount;
+
+	// Render pass & framebuffers change their attachments
+	if (s_Device)
+		RecreateSwapchain();
+
+	return s_SampleCount;
+}
+
+vk::SampleCountFlagBits RenderingDevice::GetSampleCount()
+{
+	return s_SampleCount;
 }
 
-void RenderingDevice::BeginRenderPass()
+TransientAttachmentStats RenderingDevice::GetTransientAttachmentStats()
 {
-	// Wait for previous frame
-	while (s_Device.waitForFences(s_WaitFrameFence, true, UINT64_MAX) == vk::Result::eTimeout);
-	s_Device.resetFences(s_WaitFrameFence);
+	TransientAttachmentStats stats = {};
+	stats.Allocated = s_TransientAllocated;
+	stats.Committed = s_TransientEagerSize;
+	stats.LazilyAllocated = !s_TransientLazyMemory.empty();
 
-	try
-	{
-		// Get image from swapchain
-		s_SwapchainImageIndex = s_Device.acquireNextImageKHR(s_Swapchain, UINT64_MAX, s_ImageReadySemaphore).value;
-	}
-	catch (const vk::OutOfDateKHRError&) // Swapchain outdated
-	{
-		// Recreate swapchain
-		RecreateSwapchain();
-	}
-	catch (const vk::SystemError& error) // Unexpected error happened
-	{
-		// Print error
-		std::cerr << error.what() << "\n";
-	}
+	for (const vk::DeviceMemory& memory : s_TransientLazyMemory)
+		stats.Committed += s_Device.getMemoryCommitment(memory);
 
-	// Begin command buffer
-	s_CommandBuffer.reset();
-	s_CommandBuffer.begin(vk::CommandBufferBeginInfo());
+	return stats;
+}
 
-	// Render area & Clear color
-	vk::Rect2D renderArea(vk::Offset2D(0, 0), s_SurfaceCapabilities.currentExtent);
-	vk::ClearValue clearValue(vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f));
+vk::Extent2D RenderingDevice::GetRenderExtent()
+{
+	return s_DynamicResolution ? s_RenderExtent : s_SurfaceCapabilities.currentExtent;
+}
 
-	// Begin render pass
-	vk::RenderPassBeginInfo renderPassBeginInfo(s_RenderPass, s_Framebuffers[s_SwapchainImageIndex], renderArea, clearValue);
-	s_CommandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+RedundantStateStats RenderingDevice::GetRedundantStateStats()
+{
+	std::lock_guard<std::mutex> lock(s_StatsMutex);
+	return s_RedundantStateStats;
 }
 
-void RenderingDevice::EndRenderPass()
+FrameStatsReport RenderingDevice::GetFrameStats()
 {
-	// End render pass
-	s_CommandBuffer.endRenderPass();
+	std::lock_guard<std::mutex> lock(s_StatsMutex);
 
-	// End command buffer
-	s_CommandBuffer.end();
+	FrameStatsReport report = {};
+	if (s_FrameStatsCount == 0)
+		return report;
 
-	// Ensures that the color output is finished rendering before continuing
-	vk::PipelineStageFlags pipelineStageFlags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	report.LastFrame = s_FrameStatsHistory[(s_FrameStatsCount - 1) % FRAME_STATS_HISTORY];
+	report.AverageFrameCount = (sf::Uint32)std::min<sf::Uint64>(s_FrameStatsCount, FRAME_STATS_HISTORY);
+	for (sf::Uint64 FrameStats::* counter : FRAME_STATS_COUNTERS)
+		report.Average.*counter = (s_FrameStatsSum.*counter + report.AverageFrameCount / 2) / report.AverageFrameCount;
 
-	// Submit render commands to GPU
-	vk::SubmitInfo submitInfo(s_ImageReadySemaphore, pipelineStageFlags, s_CommandBuffer, s_RenderReadySemaphore);
-	s_Queue.submit(submitInfo, s_WaitFrameFence);
+	return report;
 }
 
-void RenderingDevice::Present()
+void RenderingDevice::AddFrameStats(const FrameStats& stats)
 {
-	try
-	{
-		// Present the rendered image
-		vk::Result result = s_Queue.presentKHR(vk::PresentInfoKHR(s_RenderReadySemaphore, s_Swapchain, s_SwapchainImageIndex));
-	}
-	catch (const vk::OutOfDateKHRError&) // Swapchain outdated
-	{
-		// Recreate swapchain
-		RecreateSwapchain();
-	}
-	catch (const vk::SystemError& error) // Unexpected error happened
-	{
-		// Print error
-		std::cerr << error.what() << "\n";
-	}
+	AccumulateFrameStats(t_FrameStats, stats);
 }
 
 void RenderingDevice::CreateInstance()
 {
 	vk::ApplicationInfo applicationInfo = {};
-	applicationInfo.apiVersion = VK_API_VERSION_1_0;
+	applicationInfo.apiVersion = VK_API_VERSION_1_3;
 
-	std::vector<const char*> instanceExtensions = sf::Vulkan::getGraphicsRequiredInstanceExtensions();
+	std::vector<const char*> instanceExtensions = {};
+	if (!s_Headless)
+		instanceExtensions = sf::Vulkan::getGraphicsRequiredInstanceExtensions();
 
 	vk::InstanceCreateInfo instanceCreateInfo(vk::InstanceCreateFlags(), &applicationInfo, nullptr, nullptr);
 	if (USE_VALIDATION_LAYERS)
@@ -370,6 +2031,20 @@ sf::Uint32 RenderingDevice::FindQueueFamily(vk::QueueFlags queueFlags)
 	return UINT32_MAX;
 }
 
+vk::Format RenderingDevice::FindDepthFormat()
+{
+	// Stencil is unused, prefer formats without it
+	const std::array<vk::Format, 3> candidates = { vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint };
+	for (vk::Format format : candidates)
+	{
+		if (s_PhysicalDevice.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+			return format;
+	}
+
+	std::cerr << "Failed to find depth format\n";
+	return vk::Format::eUndefined;
+}
+
 void RenderingDevice::CreateDevice()
 {
 	const std::array<float, 1> queuePriorities = { 1.0f };
@@ -382,90 +2057,425 @@ void RenderingDevice::CreateDevice()
 		deviceCreateInfo.ppEnabledLayerNames = VALIDATION_LAYERS.data();
 	}
 
-	deviceCreateInfo.enabledExtensionCount = (sf::Uint32)DEVICE_EXTENSIONS.size();
-	deviceCreateInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+	std::vector<vk::ExtensionProperties> supportedExtensions = s_PhysicalDevice.enumerateDeviceExtensionProperties();
+	auto isSupported = [&](const char* name)
+	{
+		for (const vk::ExtensionProperties& extension : supportedExtensions)
+		{
+			if (std::strcmp(extension.extensionName, name) == 0)
+				return true;
+		}
+		return false;
+	};
+
+	std::vector<const char*> extensions = {};
+	if (!s_Headless)
+	{
+		extensions.assign(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
+
+		s_IncrementalPresent = isSupported(INCREMENTAL_PRESENT_EXTENSION);
+		if (s_IncrementalPresent)
+			extensions.push_back(INCREMENTAL_PRESENT_EXTENSION);
+	}
+
+	// Query features used by GpuQueries, enabled when available
+	vk::PhysicalDeviceFeatures supportedFeatures = s_PhysicalDevice.getFeatures();
+	s_EnabledFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	s_EnabledFeatures.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+	deviceCreateInfo.pEnabledFeatures = &s_EnabledFeatures;
+
+	// Vulkan 1.3 features are optional, everything has a 1.0 fallback
+	s_Synchronization2 = false;
+	s_DynamicRendering = false;
+	if (s_PhysicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_3)
+	{
+		auto features = s_PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features>();
+		const vk::PhysicalDeviceVulkan13Features& supported = features.get<vk::PhysicalDeviceVulkan13Features>();
+
+		s_Vulkan13Features.synchronization2 = supported.synchronization2;
+		s_Vulkan13Features.dynamicRendering = supported.dynamicRendering;
+		deviceCreateInfo.pNext = &s_Vulkan13Features;
+
+		s_Synchronization2 = s_Vulkan13Features.synchronization2;
+		s_DynamicRendering = s_Vulkan13Features.dynamicRendering;
+	}
+	else
+	{
+		if (isSupported(SYNCHRONIZATION_2_EXTENSION))
+		{
+			auto features = s_PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceSynchronization2FeaturesKHR>();
+			s_Synchronization2 = features.get<vk::PhysicalDeviceSynchronization2FeaturesKHR>().synchronization2;
+		}
+
+		if (std::all_of(DYNAMIC_RENDERING_EXTENSIONS.begin(), DYNAMIC_RENDERING_EXTENSIONS.end(), isSupported))
+		{
+			auto features = s_PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDynamicRenderingFeaturesKHR>();
+			s_DynamicRendering = features.get<vk::PhysicalDeviceDynamicRenderingFeaturesKHR>().dynamicRendering;
+		}
+
+		if (s_Synchronization2)
+		{
+			extensions.push_back(SYNCHRONIZATION_2_EXTENSION);
+			s_Synchronization2Features.synchronization2 = true;
+			s_Synchronization2Features.pNext = deviceCreateInfo.pNext;
+			deviceCreateInfo.pNext = &s_Synchronization2Features;
+		}
+
+		if (s_DynamicRendering)
+		{
+			extensions.insert(extensions.end(), DYNAMIC_RENDERING_EXTENSIONS.begin(), DYNAMIC_RENDERING_EXTENSIONS.end());
+			s_DynamicRenderingFeatures.dynamicRendering = true;
+			s_DynamicRenderingFeatures.pNext = deviceCreateInfo.pNext;
+			deviceCreateInfo.pNext = &s_DynamicRenderingFeatures;
+		}
+	}
+
+	deviceCreateInfo.enabledExtensionCount = (sf::Uint32)extensions.size();
+	deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
 	s_Device = s_PhysicalDevice.createDevice(deviceCreateInfo);
 
+	// Promoted commands (vkCmdBeginRendering, vkCmdPipelineBarrier2) fall back to their KHR entry points before 1.3
+	s_Dispatch.init(s_Instance, vkGetInstanceProcAddr, s_Device);
+
 	s_Queue = s_Device.getQueue(s_QueueFamilyIndex, 0);
 }
 
-void RenderingDevice::CreateSwapchain()
+void RenderingDevice::CreateSwapchain(vk::SwapchainKHR oldSwapchain)
 {
+	if (s_Headless)
+	{
+		CreateOffscreenImages();
+		return;
+	}
+
 	s_SurfaceCapabilities = s_PhysicalDevice.getSurfaceCapabilitiesKHR(s_Surface);
 
 	s_SurfaceFormat.format = vk::Format::eB8G8R8A8Srgb;
 	s_SurfaceFormat.colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear;
 
-	for (const auto& presentMode : s_PhysicalDevice.getSurfacePresentModesKHR(s_Surface))
-	{
-		if (presentMode == vk::PresentModeKHR::eMailbox)
-		{
-			s_PresentMode = vk::PresentModeKHR::eMailbox;
-			break;
-		}
-
-		s_PresentMode = vk::PresentModeKHR::eFifo;
-	}
+	vk::PresentModeKHR presentMode = ToPresentMode(s_PresentSettings.Policy);
+	std::vector<vk::PresentModeKHR> presentModes = s_PhysicalDevice.getSurfacePresentModesKHR(s_Surface);
+	if (std::find(presentModes.begin(), presentModes.end(), presentMode) == presentModes.end())
+		presentMode = vk::PresentModeKHR::eFifo;
+
+	// A maximum of 0 means no limit. Mailbox needs an image beyond the minimum to never block the acquire.
+	sf::Uint32 imageCount = std::max(s_PresentSettings.ImageCount, s_SurfaceCapabilities.minImageCount);
+	if (s_PresentSettings.ImageCount == 0 && presentMode == vk::PresentModeKHR::eMailbox)
+		imageCount++;
+	if (s_SurfaceCapabilities.maxImageCount != 0)
+		imageCount = std::min(imageCount, s_SurfaceCapabilities.maxImageCount);
+
+	// Transfer source lets FrameReadback copy the presented image, transfer destination lets the scaled scene be
+	// blitted into it, when the surface allows it
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+	s_SwapchainReadable = (bool)(s_SurfaceCapabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+	if (s_SwapchainReadable)
+		usage |= vk::ImageUsageFlagBits::eTransferSrc;
+	s_SwapchainBlittable = (bool)(s_SurfaceCapabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst);
+	if (s_SwapchainBlittable)
+		usage |= vk::ImageUsageFlagBits::eTransferDst;
 
 	vk::SwapchainCreateInfoKHR swapchainCreateInfo(vk::SwapchainCreateFlagsKHR(),
 		s_Surface,
-		s_SurfaceCapabilities.minImageCount,
+		imageCount,
 		s_SurfaceFormat.format,
 		s_SurfaceFormat.colorSpace,
 		s_SurfaceCapabilities.currentExtent,
 		1,
-		vk::ImageUsageFlagBits::eColorAttachment,
+		usage,
 		vk::SharingMode::eExclusive,
 		nullptr,
 		s_SurfaceCapabilities.currentTransform,
 		vk::CompositeAlphaFlagBitsKHR::eOpaque,
-		s_PresentMode,
+		presentMode,
 		true,
-		nullptr);
+		oldSwapchain);
 
 	s_Swapchain = s_Device.createSwapchainKHR(swapchainCreateInfo);
 
+	// Intervals measured with another mode or image count say nothing about this swapchain
 	std::vector<vk::Image> swapchainImages = s_Device.getSwapchainImagesKHR(s_Swapchain);
+	if (presentMode != s_PresentMode || swapchainImages.size() != s_SwapchainImages.size())
+		s_PresentIntervalCount = 0;
+	s_LastPresentTime = 0;
 
-	s_ImageViews.resize(swapchainImages.size());
+	s_PresentMode = presentMode;
+	s_SwapchainImages = swapchainImages;
+
+	s_ImageViews.resize(s_SwapchainImages.size());
 	for (sf::Uint32 i = 0; i < s_ImageViews.size(); i++)
-		s_ImageViews[i] = CreateImageView(swapchainImages[i], s_SurfaceFormat.format);
+	{
+		s_ImageViews[i] = CreateImageView(s_SwapchainImages[i], s_SurfaceFormat.format);
+		BarrierTracker::RegisterImage(s_SwapchainImages[i], vk::ImageAspectFlagBits::eColor);
+	}
+
+	CreateTransientTargets();
+
+	if (!s_DynamicRendering)
+	{
+		s_RenderPass = CreateRenderPass();
+
+		vk::Extent2D currentExtent = s_SurfaceCapabilities.currentExtent;
+
+		s_Framebuffers.resize(s_ImageViews.size());
+		for (sf::Uint32 i = 0; i < s_Framebuffers.size(); i++)
+			s_Framebuffers[i] = CreateFramebuffer(s_ImageViews[i], s_DepthView, s_MultisampleView, currentExtent.width, currentExtent.height);
+	}
+
+	if (s_DynamicResolution)
+		CreateSceneTargets();
+}
+
+void RenderingDevice::CreateOffscreenImages()
+{
+	s_SurfaceCapabilities = vk::SurfaceCapabilitiesKHR();
+	s_SurfaceCapabilities.currentExtent = s_HeadlessExtent;
+
+	s_SurfaceFormat.format = vk::Format::eB8G8R8A8Srgb;
+	s_SurfaceFormat.colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear;
+
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+	s_SwapchainReadable = true;
+	s_SwapchainBlittable = true;
+
+	s_HeadlessImages.resize(MAX_FRAMES_IN_FLIGHT);
+	s_SwapchainImages.resize(MAX_FRAMES_IN_FLIGHT);
+	s_ImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+	for (sf::Uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		s_HeadlessImages[i] = CreateImage(s_HeadlessExtent.width, s_HeadlessExtent.height, s_SurfaceFormat.format, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		s_SwapchainImages[i] = s_HeadlessImages[i].Image;
+		s_ImageViews[i] = CreateImageView(s_SwapchainImages[i], s_SurfaceFormat.format);
+		BarrierTracker::RegisterImage(s_SwapchainImages[i], vk::ImageAspectFlagBits::eColor);
+	}
+
+	CreateTransientTargets();
+
+	if (!s_DynamicRendering)
+	{
+		s_RenderPass = CreateRenderPass();
+
+		s_Framebuffers.resize(s_ImageViews.size());
+		for (sf::Uint32 i = 0; i < s_Framebuffers.size(); i++)
+			s_Framebuffers[i] = CreateFramebuffer(s_ImageViews[i], s_DepthView, s_MultisampleView, s_HeadlessExtent.width, s_HeadlessExtent.height);
+	}
+
+	if (s_DynamicResolution)
+		CreateSceneTargets();
+}
+
+void RenderingDevice::CreateTransientTargets()
+{
+	// Covers the scene targets too when dynamic resolution renders above the swapchain size
+	vk::Extent2D extent = s_SurfaceCapabilities.currentExtent;
+	if (s_DynamicResolution)
+	{
+		float maxScale = std::max(DynamicResolution::GetSettings().MaxScale, 1.0f);
+		extent = vk::Extent2D((sf::Uint32)std::ceil(extent.width * maxScale), (sf::Uint32)std::ceil(extent.height * maxScale));
+	}
+
+	if (s_DepthBuffer)
+	{
+		s_DepthImage = CreateTransientImage(extent.width, extent.height, s_DepthFormat, vk::ImageUsageFlagBits::eDepthStencilAttachment);
+		s_DepthView = CreateImageView(s_DepthImage.Image, s_DepthFormat, vk::ImageAspectFlagBits::eDepth);
+		BarrierTracker::RegisterImage(s_DepthImage.Image, GetDepthAspect(s_DepthFormat));
+	}
+
+	if (s_SampleCount != vk::SampleCountFlagBits::e1)
+	{
+		s_MultisampleImage = CreateTransientImage(extent.width, extent.height, s_SurfaceFormat.format, vk::ImageUsageFlagBits::eColorAttachment);
+		s_MultisampleView = CreateImageView(s_MultisampleImage.Image, s_SurfaceFormat.format);
+		BarrierTracker::RegisterImage(s_MultisampleImage.Image, vk::ImageAspectFlagBits::eColor);
+	}
+}
+
+VulkanImage RenderingDevice::CreateTransientImage(sf::Uint32 width, sf::Uint32 height, vk::Format format, vk::ImageUsageFlags usage, bool shared)
+{
+	VulkanImage vulkanImage = {};
+
+	// Only ever used as an attachment
+	vk::ImageCreateInfo imageCreateInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, format, vk::Extent3D(width, height, 1), 1, 1, s_SampleCount, vk::ImageTiling::eOptimal, usage | vk::ImageUsageFlagBits::eTransientAttachment, vk::SharingMode::eExclusive);
+	vulkanImage.Image = s_Device.createImage(imageCreateInfo);
+
+	vk::MemoryRequirements requirements = s_Device.getImageMemoryRequirements(vulkanImage.Image);
+	sf::Uint32 memoryType = FindLazilyAllocatedMemoryType(requirements.memoryTypeBits);
+	bool lazilyAllocated = memoryType != UINT32_MAX;
+	if (!lazilyAllocated)
+		memoryType = FindMemoryType(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	vk::MemoryAllocateInfo allocateInfo(requirements.size, memoryType);
+	vulkanImage.Memory = s_Device.allocateMemory(allocateInfo);
+	t_FrameStats.Allocations++;
+
+	s_Device.bindImageMemory(vulkanImage.Image, vulkanImage.Memory, 0);
+
+	if (!shared)
+		return vulkanImage;
+
+	s_TransientAllocated += requirements.size;
+	if (lazilyAllocated)
+		s_TransientLazyMemory.push_back(vulkanImage.Memory);
+	else
+		s_TransientEagerSize += requirements.size;
+
+	return vulkanImage;
+}
+
+void RenderingDevice::CreateSceneTargets()
+{
+	float maxScale = DynamicResolution::GetSettings().MaxScale;
+	vk::Extent2D extent = s_SurfaceCapabilities.currentExtent;
+	s_SceneExtent = vk::Extent2D(std::max((sf::Uint32)std::ceil(extent.width * maxScale), 1u), std::max((sf::Uint32)std::ceil(extent.height * maxScale), 1u));
+
+	// Render pass compatible with s_RenderPass, so every pipeline works with both
+	if (!s_DynamicRendering)
+		s_SceneRenderPass = CreateRenderPass();
+
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+
+	s_SceneTargets.resize(MAX_FRAMES_IN_FLIGHT);
+	s_SceneViews.resize(MAX_FRAMES_IN_FLIGHT);
+	s_SceneFramebuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	for (sf::Uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		s_SceneTargets[i] = CreateImage(s_SceneExtent.width, s_SceneExtent.height, s_SurfaceFormat.format, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		s_SceneViews[i] = CreateImageView(s_SceneTargets[i].Image, s_SurfaceFormat.format);
+		BarrierTracker::RegisterImage(s_SceneTargets[i].Image, vk::ImageAspectFlagBits::eColor);
+		if (!s_DynamicRendering)
+			s_SceneFramebuffers[i] = CreateFramebuffer(s_SceneViews[i], s_DepthView, s_MultisampleView, s_SceneExtent.width, s_SceneExtent.height);
+	}
+
+	s_RenderExtent = s_SceneExtent;
+}
+
+void RenderingDevice::DestroySceneTargets()
+{
+	for (const vk::Framebuffer& framebuffer : s_SceneFramebuffers)
+		s_Device.destroyFramebuffer(framebuffer);
+	for (const vk::ImageView& imageView : s_SceneViews)
+		s_Device.destroyImageView(imageView);
+	for (const VulkanImage& image : s_SceneTargets)
+		DestroyImage(image);
+
+	if (s_SceneRenderPass)
+		s_Device.destroyRenderPass(s_SceneRenderPass);
 
-	CreateRenderPass();
+	s_SceneFramebuffers.clear();
+	s_SceneViews.clear();
+	s_SceneTargets.clear();
+	s_SceneRenderPass = nullptr;
+}
+
+void RenderingDevice::UpdateRenderExtent()
+{
+	// A new GPU frame time only arrives once per completed frame
+	if (GpuProfiler::IsSupported() && GpuProfiler::GetResultsFrameNumber() != s_ResolutionResultsFrame)
+	{
+		s_ResolutionResultsFrame = GpuProfiler::GetResultsFrameNumber();
+		DynamicResolution::Update(GpuProfiler::GetFrameTime());
+	}
+
+	float scale = DynamicResolution::GetScale();
+	vk::Extent2D extent = s_SurfaceCapabilities.currentExtent;
 
-	vk::Extent2D currentExtent = s_SurfaceCapabilities.currentExtent;
+	s_RenderExtent.width = std::clamp((sf::Uint32)std::lround(extent.width * scale), 1u, s_SceneExtent.width);
+	s_RenderExtent.height = std::clamp((sf::Uint32)std::lround(extent.height * scale), 1u, s_SceneExtent.height);
+	s_ViewportScale = sf::Vector2f((float)s_RenderExtent.width / extent.width, (float)s_RenderExtent.height / extent.height);
+}
 
-	s_Framebuffers.resize(s_ImageViews.size());
-	for (sf::Uint32 i = 0; i < s_Framebuffers.size(); i++)
-		s_Framebuffers[i] = CreateFramebuffer(s_ImageViews[i], currentExtent.width, currentExtent.height);
+void RenderingDevice::UpscaleSceneTarget()
+{
+	PROFILE_FUNCTION();
+	GPU_SCOPE("Upscale");
+
+	vk::Image scene = s_SceneTargets[s_FrameIndex].Image;
+	vk::Image swapchain = s_SwapchainImages[s_SwapchainImageIndex];
+	vk::Extent2D extent = s_SurfaceCapabilities.currentExtent;
+
+	// The blit covers the whole swapchain image, later passes, readback & present transition it from there
+	BarrierTracker::TransitionImage(scene, ResourceUsage::TransferSrc);
+	BarrierTracker::DiscardImage(swapchain);
+	BarrierTracker::TransitionImage(swapchain, ResourceUsage::TransferDst);
+	BarrierTracker::Flush(t_CommandBuffer);
+
+	vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+	std::array<vk::Offset3D, 2> sourceOffsets = { vk::Offset3D(0, 0, 0), vk::Offset3D(s_RenderExtent.width, s_RenderExtent.height, 1) };
+	std::array<vk::Offset3D, 2> destinationOffsets = { vk::Offset3D(0, 0, 0), vk::Offset3D(extent.width, extent.height, 1) };
+	vk::ImageBlit blit(layers, sourceOffsets, layers, destinationOffsets);
+	t_CommandBuffer.blitImage(scene, vk::ImageLayout::eTransferSrcOptimal, swapchain, vk::ImageLayout::eTransferDstOptimal, blit, s_UpscaleFilter);
 }
 
-void RenderingDevice::CreateRenderPass()
+vk::RenderPass RenderingDevice::CreateRenderPass(const RenderPassDesc& desc)
 {
-	vk::AttachmentDescription colorAttachment(vk::AttachmentDescriptionFlags(),
+	bool multisampled = s_SampleCount != vk::SampleCountFlagBits::e1;
+	assert(!multisampled || desc.ColorLoadOp != vk::AttachmentLoadOp::eLoad);
+
+	// Every attachment is transitioned through the BarrierTracker before the pass and left in its attachment layout,
+	// which also keeps the contents outside the render area. The tracker's barriers replace the external dependency.
+	std::vector<vk::AttachmentDescription> attachments = {};
+
+	// Target image. When multisampling it is the resolve destination and fully overwritten, so it is never loaded.
+	attachments.push_back(vk::AttachmentDescription(vk::AttachmentDescriptionFlags(),
 		s_SurfaceFormat.format,
 		vk::SampleCountFlagBits::e1,
-		vk::AttachmentLoadOp::eClear,
-		vk::AttachmentStoreOp::eStore,
+		multisampled ? vk::AttachmentLoadOp::eDontCare : desc.ColorLoadOp,
+		desc.ColorStoreOp,
 		vk::AttachmentLoadOp::eDontCare,
 		vk::AttachmentStoreOp::eDontCare,
-		vk::ImageLayout::eUndefined,
-		vk::ImageLayout::ePresentSrcKHR);
+		vk::ImageLayout::eColorAttachmentOptimal,
+		vk::ImageLayout::eColorAttachmentOptimal));
 
+	// Depth is cleared every pass and never read afterwards
+	vk::AttachmentReference depthReference((sf::Uint32)attachments.size(), vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	if (s_DepthBuffer)
+	{
+		attachments.push_back(vk::AttachmentDescription(vk::AttachmentDescriptionFlags(),
+			s_DepthFormat,
+			s_SampleCount,
+			vk::AttachmentLoadOp::eClear,
+			vk::AttachmentStoreOp::eDontCare,
+			vk::AttachmentLoadOp::eDontCare,
+			vk::AttachmentStoreOp::eDontCare,
+			vk::ImageLayout::eDepthStencilAttachmentOptimal,
+			vk::ImageLayout::eDepthStencilAttachmentOptimal));
+	}
+
+	// Samples are resolved into the target at the end of the subpass, while still in tile memory
 	vk::AttachmentReference colorReference(0, vk::ImageLayout::eColorAttachmentOptimal);
-	vk::SubpassDescription subpassDescription(vk::SubpassDescriptionFlags(), vk::PipelineBindPoint::eGraphics, nullptr, colorReference);
+	vk::AttachmentReference resolveReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+	if (multisampled)
+	{
+		colorReference.attachment = (sf::Uint32)attachments.size();
+		attachments.push_back(vk::AttachmentDescription(vk::AttachmentDescriptionFlags(),
+			s_SurfaceFormat.format,
+			s_SampleCount,
+			desc.ColorLoadOp,
+			vk::AttachmentStoreOp::eDontCare,
+			vk::AttachmentLoadOp::eDontCare,
+			vk::AttachmentStoreOp::eDontCare,
+			vk::ImageLayout::eColorAttachmentOptimal,
+			vk::ImageLayout::eColorAttachmentOptimal));
+	}
+
+	vk::SubpassDescription subpassDescription(vk::SubpassDescriptionFlags(), vk::PipelineBindPoint::eGraphics, nullptr, colorReference, nullptr, s_DepthBuffer ? &depthReference : nullptr);
+	if (multisampled)
+		subpassDescription.pResolveAttachments = &resolveReference;
 
-	vk::SubpassDependency subpassDependency(
-		vk::SubpassExternal,
-		0,
-		vk::PipelineStageFlagBits::eColorAttachmentOutput,
-		vk::PipelineStageFlagBits::eColorAttachmentOutput,
-		vk::AccessFlagBits::eNone,
-		vk::AccessFlagBits::eColorAttachmentWrite);
+	vk::RenderPassCreateInfo renderPassCreateInfo(vk::RenderPassCreateFlags(), attachments, subpassDescription);
+	return s_Device.createRenderPass(renderPassCreateInfo);
+}
 
-	vk::RenderPassCreateInfo renderPassCreateInfo(vk::RenderPassCreateFlags(), colorAttachment, subpassDescription, subpassDependency);
-	s_RenderPass = s_Device.createRenderPass(renderPassCreateInfo);
+vk::RenderPass RenderingDevice::GetRenderPass(const RenderPassDesc& desc)
+{
+	auto key = std::make_pair(desc.ColorLoadOp, desc.ColorStoreOp);
+	auto it = s_RenderPassVariants.find(key);
+	if (it != s_RenderPassVariants.end())
+		return it->second;
+
+	vk::RenderPass renderPass = CreateRenderPass(desc);
+	s_RenderPassVariants[key] = renderPass;
+	return renderPass;
 }
 
 void RenderingDevice::CreateCommandPool()
@@ -474,42 +2484,178 @@ void RenderingDevice::CreateCommandPool()
 	s_CommandPool = s_Device.createCommandPool(commandPoolCreateInfo);
 }
 
+void RenderingDevice::CreateDescriptorPool()
+{
+	const std::array<vk::DescriptorPoolSize, 3> poolSizes = {
+		vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, MAX_DESCRIPTOR_POOL_SETS),
+		vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, MAX_DESCRIPTOR_POOL_SETS),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, MAX_DESCRIPTOR_POOL_SETS)
+	};
+
+	vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, MAX_DESCRIPTOR_POOL_SETS, poolSizes);
+	s_DescriptorPool = s_Device.createDescriptorPool(descriptorPoolCreateInfo);
+}
+
+void RenderingDevice::CreateCompositeLayout()
+{
+	vk::SamplerCreateInfo samplerCreateInfo(vk::SamplerCreateFlags(),
+		s_UpscaleFilter,
+		s_UpscaleFilter,
+		vk::SamplerMipmapMode::eNearest,
+		vk::SamplerAddressMode::eClampToEdge,
+		vk::SamplerAddressMode::eClampToEdge,
+		vk::SamplerAddressMode::eClampToEdge);
+	s_CompositeSampler = s_Device.createSampler(samplerCreateInfo);
+
+	vk::DescriptorSetLayoutBinding binding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+	vk::DescriptorSetLayoutCreateInfo setLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlags(), binding);
+	s_CompositeSetLayout = s_Device.createDescriptorSetLayout(setLayoutCreateInfo);
+
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), s_CompositeSetLayout);
+	s_CompositeShader.PipelineLayout = s_Device.createPipelineLayout(pipelineLayoutCreateInfo);
+}
+
+void RenderingDevice::CreateCompositeShader()
+{
+	PROFILE_FUNCTION();
+
+	// Frames in flight may still draw with the previous pipeline
+	if (s_CompositeShader.Pipeline)
+	{
+		RetiredResources retired = {};
+		retired.FrameNumber = s_FrameNumber;
+		retired.Pipelines.push_back(s_CompositeShader.Pipeline);
+		s_RetiredResources.push_back(std::move(retired));
+	}
+
+	std::vector<sf::Uint32> vsCode = ReadShaderCode(COMPOSITE_VERTEX_SHADER_PATH);
+	std::vector<sf::Uint32> fsCode = ReadShaderCode(COMPOSITE_FRAGMENT_SHADER_PATH);
+
+	vk::ShaderModuleCreateInfo vertexModuleCreateInfo(vk::ShaderModuleCreateFlags(), vsCode.size() * sizeof(sf::Uint32), vsCode.data());
+	vk::ShaderModule vertexModule = s_Device.createShaderModule(vertexModuleCreateInfo);
+	vk::ShaderModuleCreateInfo fragmentModuleCreateInfo(vk::ShaderModuleCreateFlags(), fsCode.size() * sizeof(sf::Uint32), fsCode.data());
+	vk::ShaderModule fragmentModule = s_Device.createShaderModule(fragmentModuleCreateInfo);
+
+	vk::PipelineShaderStageCreateInfo vertexStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, vertexModule, "main");
+	vk::PipelineShaderStageCreateInfo fragmentStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, fragmentModule, "main");
+	std::array<vk::PipelineShaderStageCreateInfo, 2> stages = { vertexStageCreateInfo, fragmentStageCreateInfo };
+
+	// The quad's corners come from the vertex index, no vertex buffer is bound
+	vk::PipelineVertexInputStateCreateInfo vertexInputState = {};
+	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState(vk::PipelineInputAssemblyStateCreateFlags(), vk::PrimitiveTopology::eTriangleList, false);
+
+	vk::PipelineViewportStateCreateInfo viewportState(vk::PipelineViewportStateCreateFlags(), 1, nullptr, 1, nullptr);
+	std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	vk::PipelineDynamicStateCreateInfo dynamicState(vk::PipelineDynamicStateCreateFlags(), dynamicStates);
+
+	vk::PipelineRasterizationStateCreateInfo rasterizationState(vk::PipelineRasterizationStateCreateFlags(), false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eNone, vk::FrontFace::eClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f);
+	vk::PipelineMultisampleStateCreateInfo multisampleState(vk::PipelineMultisampleStateCreateFlags(), s_SampleCount, false, 1.0f, nullptr, false, false);
+
+	// Layers are drawn on top of whatever the pass rendered so far, regardless of depth
+	vk::PipelineDepthStencilStateCreateInfo depthStencilState(vk::PipelineDepthStencilStateCreateFlags(), false, false, vk::CompareOp::eAlways, false, false, {}, {}, 0.0f, 1.0f);
+
+	// Target contents were blended over their clear color, so their colors are already multiplied by alpha
+	vk::PipelineColorBlendAttachmentState colorBlendAttachment(true, vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+		vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+	vk::PipelineColorBlendStateCreateInfo colorBlendState(vk::PipelineColorBlendStateCreateFlags(), false, vk::LogicOp::eCopy, colorBlendAttachment);
+
+	vk::PipelineRenderingCreateInfo renderingCreateInfo(0, s_SurfaceFormat.format, s_DepthBuffer ? s_DepthFormat : vk::Format::eUndefined, vk::Format::eUndefined);
+
+	vk::GraphicsPipelineCreateInfo pipelineCreateInfo(vk::PipelineCreateFlags(),
+		stages,
+		&vertexInputState,
+		&inputAssemblyState,
+		nullptr,
+		&viewportState,
+		&rasterizationState,
+		&multisampleState,
+		s_DepthBuffer ? &depthStencilState : nullptr,
+		&colorBlendState,
+		&dynamicState,
+		s_CompositeShader.PipelineLayout,
+		s_DynamicRendering ? nullptr : s_RenderPass);
+	if (s_DynamicRendering)
+		pipelineCreateInfo.pNext = &renderingCreateInfo;
+
+	vk::ResultValue<vk::Pipeline> result = s_Device.createGraphicsPipeline(nullptr, pipelineCreateInfo);
+	assert(result.result == vk::Result::eSuccess);
+	s_CompositeShader.Pipeline = result.value;
+	s_CompositeFormat = s_SurfaceFormat.format;
+	s_CompositeSampleCount = s_SampleCount;
+	s_CompositeDepth = s_DepthBuffer;
+
+	s_Device.destroyShaderModule(vertexModule);
+	s_Device.destroyShaderModule(fragmentModule);
+}
+
 void RenderingDevice::CreateSynchronization()
 {
-	s_ImageReadySemaphore = s_Device.createSemaphore(vk::SemaphoreCreateInfo());
-	s_RenderReadySemaphore = s_Device.createSemaphore(vk::SemaphoreCreateInfo());
-	s_WaitFrameFence = s_Device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+	for (FrameData& frame : s_Frames)
+	{
+		frame.ImageReadySemaphore = s_Device.createSemaphore(vk::SemaphoreCreateInfo());
+		frame.RenderReadySemaphore = s_Device.createSemaphore(vk::SemaphoreCreateInfo());
+		frame.WaitFrameFence = s_Device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+	}
 }
 
-void RenderingDevice::DestroySwapchain()
+void RenderingDevice::DestroyThreadCommandPools()
 {
 	s_Device.waitIdle();
 
-	for (auto const& framebuffer : s_Framebuffers)
-		s_Device.destroyFramebuffer(framebuffer);
+	// Destroying a pool frees its command buffers
+	for (FrameData& frame : s_Frames)
+	{
+		for (ThreadCommandPool& threadCommandPool : frame.ThreadCommandPools)
+			s_Device.destroyCommandPool(threadCommandPool.CommandPool);
 
-	s_Device.destroyRenderPass(s_RenderPass);
+		frame.ThreadCommandPools.clear();
+	}
+}
 
-	for (auto const& imageView : s_ImageViews)
-		s_Device.destroyImageView(imageView);
+void RenderingDevice::DestroySwapchain()
+{
+	s_Device.waitIdle();
 
-	s_Device.destroySwapchainKHR(s_Swapchain);
+	RetireSwapchain();
+	ReleaseRetiredResources(true);
 }
 
 void RenderingDevice::DestroyAll()
 {
 	s_Device.waitIdle();
 
-	s_Device.destroyFence(s_WaitFrameFence);
-	s_Device.destroySemaphore(s_RenderReadySemaphore);
-	s_Device.destroySemaphore(s_ImageReadySemaphore);
-	s_Device.freeCommandBuffers(s_CommandPool, s_CommandBuffer);
+	FrameReadback::Terminate();
+	GpuQueries::Terminate();
+	GpuProfiler::Terminate();
+	DestroyThreadCommandPools();
+
+	for (FrameData& frame : s_Frames)
+	{
+		s_Device.destroyFence(frame.WaitFrameFence);
+		s_Device.destroySemaphore(frame.RenderReadySemaphore);
+		s_Device.destroySemaphore(frame.ImageReadySemaphore);
+		s_Device.freeCommandBuffers(s_CommandPool, frame.CommandBuffer);
+	}
 	s_Device.destroyCommandPool(s_CommandPool);
 
+	// Retired descriptor sets are freed into the pool
 	DestroySwapchain();
 
+	if (s_CompositeShader.Pipeline)
+		s_Device.destroyPipeline(s_CompositeShader.Pipeline);
+	s_Device.destroyPipelineLayout(s_CompositeShader.PipelineLayout);
+	s_Device.destroySampler(s_CompositeSampler);
+	s_Device.destroyDescriptorSetLayout(s_CompositeSetLayout);
+	s_CompositeShader = {};
+	s_CompositeSampler = nullptr;
+	s_CompositeSetLayout = nullptr;
+
+	s_Device.destroyDescriptorPool(s_DescriptorPool);
+
 	s_Device.destroy();
-	s_Instance.destroySurfaceKHR(s_Surface);
+	if (s_Surface)
+		s_Instance.destroySurfaceKHR(s_Surface);
+	s_Surface = nullptr;
 	s_Instance.destroy();
 }
 
@@ -546,6 +2692,7 @@ VulkanBuffer RenderingDevice::CreateBuffer(vk::DeviceSize size, vk::BufferUsageF
 	vk::MemoryRequirements requirments = s_Device.getBufferMemoryRequirements(vulkanBuffer.Buffer);
 	vk::MemoryAllocateInfo allocateInfo(requirments.size, FindMemoryType(requirments.memoryTypeBits, properties));
 	vulkanBuffer.Memory = s_Device.allocateMemory(allocateInfo);
+	t_FrameStats.Allocations++;
 
 	// Bind memory
 	s_Device.bindBufferMemory(vulkanBuffer.Buffer, vulkanBuffer.Memory, 0);
@@ -556,8 +2703,10 @@ VulkanBuffer RenderingDevice::CreateBuffer(vk::DeviceSize size, vk::BufferUsageF
 void RenderingDevice::DestroyBuffer(VulkanBuffer buffer)
 {
 	s_Device.waitIdle();
+	BarrierTracker::UnregisterBuffer(buffer.Buffer);
 	s_Device.destroyBuffer(buffer.Buffer);
 	s_Device.freeMemory(buffer.Memory);
+	t_FrameStats.Frees++;
 	buffer.Buffer = nullptr;
 	buffer.Memory = nullptr;
 }
@@ -574,6 +2723,7 @@ VulkanImage RenderingDevice::CreateImage(sf::Uint32 width, sf::Uint32 height, vk
 	vk::MemoryRequirements requirements = s_Device.getImageMemoryRequirements(vulkanImage.Image);
 	vk::MemoryAllocateInfo allocateInfo(requirements.size, FindMemoryType(requirements.memoryTypeBits, properties));
 	vulkanImage.Memory = s_Device.allocateMemory(allocateInfo);
+	t_FrameStats.Allocations++;
 
 	// Bind memory
 	s_Device.bindImageMemory(vulkanImage.Image, vulkanImage.Memory, 0);
@@ -584,29 +2734,40 @@ VulkanImage RenderingDevice::CreateImage(sf::Uint32 width, sf::Uint32 height, vk
 void RenderingDevice::DestroyImage(VulkanImage image)
 {
 	s_Device.waitIdle();
+	BarrierTracker::UnregisterImage(image.Image);
 	s_Device.destroyImage(image.Image);
 	s_Device.freeMemory(image.Memory);
+	t_FrameStats.Frees++;
 	image.Image = nullptr;
 	image.Memory = nullptr;
 }
 
-vk::ImageView RenderingDevice::CreateImageView(vk::Image image, vk::Format format)
+vk::ImageView RenderingDevice::CreateImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspect)
 {
 	vk::ImageViewCreateInfo imageViewCreateInfo(vk::ImageViewCreateFlags(),
 		image,
 		vk::ImageViewType::e2D,
 		format,
 		vk::ComponentMapping(),
-		vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+		vk::ImageSubresourceRange(aspect, 0, 1, 0, 1));
 
 	return s_Device.createImageView(imageViewCreateInfo);
 }
 
-vk::Framebuffer RenderingDevice::CreateFramebuffer(vk::ImageView imageView, sf::Uint32 width, sf::Uint32 height)
+vk::Framebuffer RenderingDevice::CreateFramebuffer(vk::ImageView imageView, vk::ImageView depthView, vk::ImageView multisampleView, sf::Uint32 width, sf::Uint32 height)
 {
+	// Same order as the render pass attachments
+	std::array<vk::ImageView, 3> attachments = { imageView };
+	sf::Uint32 attachmentCount = 1;
+	if (s_DepthBuffer)
+		attachments[attachmentCount++] = depthView;
+	if (s_SampleCount != vk::SampleCountFlagBits::e1)
+		attachments[attachmentCount++] = multisampleView;
+
 	vk::FramebufferCreateInfo framebufferCreateInfo(vk::FramebufferCreateFlags(),
 		s_RenderPass,
-		imageView,
+		attachmentCount,
+		attachments.data(),
 		width,
 		height,
 		1);
@@ -635,46 +2796,14 @@ sf::Uint32 RenderingDevice::FindMemoryType(sf::Uint32 suitableTypes, vk::MemoryP
 	return UINT32_MAX;
 }
 
-void RenderingDevice::ChangeImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+sf::Uint32 RenderingDevice::FindLazilyAllocatedMemoryType(sf::Uint32 suitableTypes)
 {
-	vk::CommandBuffer commandBuffer = BeginSingleTimeCommands();
+	vk::PhysicalDeviceMemoryProperties memoryProperties = s_PhysicalDevice.getMemoryProperties();
+	for (sf::Uint32 i = 0; i < memoryProperties.memoryTypeCount; i++)
 	{
-		vk::ImageMemoryBarrier memoryBarrier = {};
-
-		vk::PipelineStageFlags sourceStage = {};
-		vk::PipelineStageFlags destinationStage = {};
-
-		if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
-		{
-			memoryBarrier.srcAccessMask = vk::AccessFlagBits::eNone;
-			memoryBarrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-			sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-			destinationStage = vk::PipelineStageFlagBits::eTransfer;
-		}
-		else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
-		{
-			memoryBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-			memoryBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-			sourceStage = vk::PipelineStageFlagBits::eTransfer;
-			destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-		}
-		else
-		{
-			std::cerr << "Image layout NOT supported (Image layout transition)\n";
-			s_Window->close();
-			return;
-		}
-
-		memoryBarrier.oldLayout = oldLayout;
-		memoryBarrier.newLayout = newLayout;
-		memoryBarrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
-		memoryBarrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
-		memoryBarrier.image = image;
-		memoryBarrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
-
-		commandBuffer.pipelineBarrier(sourceStage, destinationStage, vk::DependencyFlags(), nullptr, nullptr, memoryBarrier);
+		if (suitableTypes & (1 << i) && memoryProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated)
+			return i;
 	}
-	EndSingleTimeCommands(commandBuffer);
+
+	return UINT32_MAX;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 
@@ -23,13 +25,130 @@ struct VulkanImage
 	vk::DeviceMemory Memory = {};
 };
 
+// Number of state changes dropped because the state was already set
+struct RedundantStateStats
+{
+	sf::Uint32 Pipelines = 0;
+	sf::Uint32 VertexBuffers = 0;
+	sf::Uint32 DescriptorSets = 0;
+	sf::Uint32 Viewports = 0;
+	sf::Uint32 Scissors = 0;
+	sf::Uint32 PushConstants = 0;
+};
+
+// Work counters accumulated by RenderingDevice functions over a frame
+struct FrameStats
+{
+	sf::Uint64 Draws = 0;
+	sf::Uint64 Instances = 0;
+	sf::Uint64 Triangles = 0;
+	sf::Uint64 PipelineBinds = 0;
+	sf::Uint64 VertexBufferBinds = 0;
+	sf::Uint64 DescriptorSetBinds = 0;
+	sf::Uint64 BytesUploaded = 0;
+	sf::Uint64 DescriptorAllocations = 0;
+	sf::Uint64 Barriers = 0;
+	sf::Uint64 Allocations = 0;
+	sf::Uint64 Frees = 0;
+};
+
+struct FrameStatsReport
+{
+	FrameStats LastFrame = {};
+	FrameStats Average = {}; // Rounded mean over the last AverageFrameCount frames
+	sf::Uint32 AverageFrameCount = 0;
+};
+
+// Depth state baked into a shader's pipeline, ignored while the depth buffer is disabled
+enum class DepthMode
+{
+	Disabled,
+	TestAndWrite,
+	TestOnly
+};
+
+// Attachment behaviour of one render pass. Clear & DontCare loads let tile based GPUs skip reading the image into
+// tile memory, a DontCare store skips writing it back. Load keeps what earlier passes of the frame rendered.
+struct RenderPassDesc
+{
+	vk::AttachmentLoadOp ColorLoadOp = vk::AttachmentLoadOp::eClear;
+	vk::AttachmentStoreOp ColorStoreOp = vk::AttachmentStoreOp::eStore;
+	vk::ClearColorValue ClearColor = vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f);
+	vk::ClearDepthStencilValue ClearDepth = vk::ClearDepthStencilValue(1.0f, 0);
+};
+
+// Memory behind the depth & multisampled color attachments. Lazily allocated memory is only committed when a
+// tile based GPU actually spills the attachment, which is usually never.
+struct TransientAttachmentStats
+{
+	vk::DeviceSize Allocated = 0;
+	vk::DeviceSize Committed = 0;
+	bool LazilyAllocated = false;
+};
+
+// How rendered images reach the display. A mode the surface lacks falls back to VSync, which every surface supports.
+enum class PresentPolicy
+{
+	VSync,			// Fifo: never tears, frames queue behind the display and the GPU stalls once the queue is full
+	LowLatency,		// Mailbox: never tears, a new image replaces the queued one so rendering never waits on the display
+	Uncapped,		// Immediate: shown right away, tears
+	Adaptive		// FifoRelaxed: VSync while frames are on time, a late frame is shown right away and may tear
+};
+
+struct PresentSettings
+{
+	PresentPolicy Policy = PresentPolicy::LowLatency;
+	sf::Uint32 ImageCount = 0; // Clamped to the surface limits, 0 uses the surface minimum (one more for mailbox)
+};
+
+// CPU time between consecutive Present() calls in milliseconds, over the last IntervalCount presents
+struct PresentStats
+{
+	vk::PresentModeKHR PresentMode = vk::PresentModeKHR::eFifo;
+	sf::Uint32 ImageCount = 0;
+	double LastInterval = 0.0;
+	double AverageInterval = 0.0;
+	double MinInterval = 0.0;
+	double MaxInterval = 0.0;
+	sf::Uint32 IntervalCount = 0;
+};
+
+// Offscreen color image in the swapchain format, composited by DrawRenderTarget. Passes into it use the swapchain's
+// depth & sample count through attachments of the target's own size, so every pipeline can draw to it. Kept in shader
+// read layout between passes.
+struct RenderTarget
+{
+	VulkanImage Image = {};
+	vk::ImageView View = {};
+	vk::Extent2D Extent = {};
+	vk::DeviceSize Size = 0; // Including the attachments
+
+	// Made for the depth buffer & sample count enabled at creation, targets have to be recreated after changing them
+	vk::SampleCountFlagBits SampleCount = vk::SampleCountFlagBits::e1;
+	VulkanImage DepthImage = {};
+	vk::ImageView DepthView = {};
+	VulkanImage MultisampleImage = {};
+	vk::ImageView MultisampleView = {};
+
+	// Samples the image, bound by DrawRenderTarget
+	vk::DescriptorSet DescriptorSet = {};
+};
+
+typedef sf::Uint32 FrameCallbackId;
+
+struct DynamicResolutionSettings;
+
 class RenderingDevice
 {
 public:
 	static void Initialize(sf::WindowBase* window);
+
+	// Renders into offscreen images instead of a swapchain, Present() only rotates them. Needs no display.
+	static bool InitializeHeadless(sf::Vector2u extent);
 	static void Terminate();
 
-	static VulkanShader CreateShader(const sf::String& vsFilePath, const sf::String& fsFilePath);
+	static VulkanShader CreateShader(const sf::String& vsFilePath, const sf::String& fsFilePath, DepthMode depthMode = DepthMode::TestAndWrite);
+	static VulkanShader CreateShader(const std::vector<sf::Uint32>& vsCode, const std::vector<sf::Uint32>& fsCode, DepthMode depthMode = DepthMode::TestAndWrite);
 	static void DestroyShader(VulkanShader vulkanShader);
 
 	static VulkanBuffer CreateVertexBuffer(const std::vector<sf::Vector3f>& vertices);
@@ -40,13 +159,126 @@ public:
 
 	static void BindShader(VulkanShader& vulkanShader);
 	static void BindVertexBuffer(VulkanBuffer& vertexBuffer);
+	static void BindDescriptorSet(VulkanShader& vulkanShader, vk::DescriptorSet descriptorSet, sf::Uint32 setIndex = 0);
+	static void PushConstants(VulkanShader& vulkanShader, const void* data, sf::Uint32 size, sf::Uint32 offset = 0);
+
+	static void Draw(sf::Uint32 count, sf::Uint32 instanceCount = 1, sf::Uint32 firstVertex = 0, sf::Uint32 firstInstance = 0);
 
-	static void Draw(sf::Uint32 count);
+	static vk::DescriptorSet AllocateDescriptorSet(vk::DescriptorSetLayout layout);
+	static void FreeDescriptorSet(vk::DescriptorSet descriptorSet);
 
+	// Returns without recreating while the window is minimized, frames begun meanwhile are neither submitted nor presented
 	static void RecreateSwapchain();
-	static void BeginRenderPass();
+	// Coalesces resize events, the swapchain is recreated once before the next acquire
+	static void RequestSwapchainRecreate();
+	static void BeginFrame();
+	static void EndFrame();
+	static void BeginRenderPass(vk::SubpassContents contents = vk::SubpassContents::eInline);
+	static void BeginRenderPass(const RenderPassDesc& desc, vk::SubpassContents contents = vk::SubpassContents::eInline);
 	static void EndRenderPass();
 	static void Present();
+
+	// Passes into render targets go inside a frame, outside of swapchain passes, and always clear or discard the
+	// target. They render the whole target, its depth & multisampled attachments are never shared.
+	static RenderTarget CreateRenderTarget(sf::Uint32 width, sf::Uint32 height);
+	// Whether the target still matches the enabled depth buffer & sample count
+	static bool IsRenderTargetCompatible(const RenderTarget& target);
+	// Destroyed once the frames that may use it completed
+	static void DestroyRenderTarget(const RenderTarget& target);
+	// Same deferral for framebuffers recorded this frame, e.g. ones made for a single execution
+	static void DestroyFramebuffer(vk::Framebuffer framebuffer);
+	static void DestroyRenderPass(vk::RenderPass renderPass);
+	static void DestroyImageView(vk::ImageView imageView);
+	// Deferred DestroyImage/DestroyBuffer, without waiting for the device. A null memory leaves the bound memory
+	// alone, memory shared by several resources is retired on its own.
+	static void RetireImage(VulkanImage image);
+	static void RetireBuffer(VulkanBuffer buffer);
+	static void RetireMemory(vk::DeviceMemory memory);
+	static void BeginRenderTargetPass(const RenderTarget& target, const RenderPassDesc& desc = {});
+	static void EndRenderTargetPass();
+
+	// Draws the target as a textured quad blended over the pass (premultiplied alpha), clipped like any other draw.
+	// Main thread only, inside a swapchain pass with inline contents. Not captured by traces. Leaves its own shader,
+	// viewport & scissors bound, set them again before drawing on.
+	static void DrawRenderTarget(const RenderTarget& target, sf::Vector2i position, sf::Vector2i size);
+
+	// Incremented by every BeginFrame
+	static sf::Uint64 GetFrameNumber();
+
+	// Run in registration order at the end of every frame that rendered to the swapchain, after its last pass and
+	// before the readback copies are recorded. Lets higher level systems (e.g. VideoCapture) hook into the frame.
+	static FrameCallbackId AddFrameEndCallback(const std::function<void()>& callback);
+	static void RemoveFrameEndCallback(FrameCallbackId id);
+
+	// Applied by the swapchain recreation before the next acquire. Headless there is nothing to present to and
+	// only the intervals are measured.
+	static void SetPresentSettings(const PresentSettings& settings);
+	static PresentSettings GetPresentSettings();
+	static PresentStats GetPresentStats();
+
+	// For mostly static content: passes keep what the acquired image already shows and render only inside the area
+	// damaged since that image was last rendered, render area & scissors are clipped to it. Damage is reported
+	// before the first pass of the frame and handed to the present through VK_KHR_incremental_present when
+	// supported. With MSAA or dynamic resolution every frame is rendered in full.
+	static void SetDamageTrackingEnabled(bool enabled);
+	static bool IsDamageTrackingEnabled();
+	static bool SupportsIncrementalPresent();
+	static void AddDamage(sf::Vector2i offset, sf::Vector2i extent);
+	// Render area of the frame's passes, the whole image unless damage tracking restricts it
+	static vk::Rect2D GetDamageArea();
+
+	// Worker threads record into secondary command buffers from their own per-frame pool.
+	// Call between BeginRenderPass(eSecondaryCommandBuffers) and ExecuteSecondaryCommandBuffers().
+	static void SetRecordingThreadCount(sf::Uint32 threadCount);
+	static void BeginSecondaryCommandBuffer(sf::Uint32 threadIndex);
+	static void EndSecondaryCommandBuffer();
+	static void ExecuteSecondaryCommandBuffers();
+
+	static vk::Device GetDevice();
+	static vk::PhysicalDevice GetPhysicalDevice();
+	static vk::CommandBuffer GetCommandBuffer();
+	static vk::Image GetSwapchainImage();
+	static vk::ImageView GetSwapchainImageView();
+	static vk::Format GetSwapchainFormat();
+	static vk::Extent2D GetSwapchainExtent();
+
+	static const vk::PhysicalDeviceFeatures& GetEnabledFeatures();
+	static bool SupportsSynchronization2();
+	// Required for commands that are core in 1.3, they resolve to the KHR extension entry points on older devices
+	static const vk::DispatchLoaderDynamic& GetDispatch();
+
+	// Chosen at Initialize when the device supports VK_KHR_dynamic_rendering (core in 1.3): pipelines are built
+	// against attachment formats only and swapchain recreation creates no render pass or framebuffer objects
+	static bool UsesDynamicRendering();
+	static bool IsHeadless();
+
+	// Adds a depth attachment to the render pass. Pipelines are tied to the render pass layout, so this has to be
+	// set before creating shaders.
+	static void SetDepthBufferEnabled(bool enabled);
+	static bool IsDepthBufferEnabled();
+	static vk::Format GetDepthFormat();
+
+	// Renders into a multisampled transient attachment resolved at the end of the subpass. Clamped to the counts
+	// the device supports, returns the count used. Like the depth buffer, set before creating shaders.
+	static vk::SampleCountFlagBits SetSampleCount(vk::SampleCountFlagBits sampleCount);
+	static vk::SampleCountFlagBits GetSampleCount();
+	static TransientAttachmentStats GetTransientAttachmentStats();
+
+	// Renders into an offscreen target scaled by DynamicResolution, upscaled to the swapchain at the end of the
+	// render pass. Viewports & scissors stay in swapchain coordinates. False when the swapchain cannot be blitted to.
+	static bool EnableDynamicResolution(const DynamicResolutionSettings& settings);
+	static void DisableDynamicResolution();
+	static vk::Extent2D GetRenderExtent();
+	static RedundantStateStats GetRedundantStateStats();
+	static FrameStatsReport GetFrameStats();
+
+	// For systems recording through the device without going through its functions (BarrierTracker, RenderGraph)
+	static void AddFrameStats(const FrameStats& stats);
+
+	static sf::Uint32 FindMemoryType(sf::Uint32 suitableTypes, vk::MemoryPropertyFlags properties);
+
+	// UINT32_MAX when none of the suitable types is lazily allocated (most desktop GPUs)
+	static sf::Uint32 FindLazilyAllocatedMemoryType(sf::Uint32 suitableTypes);
 private:
 	RenderingDevice();
 	RenderingDevice(const RenderingDevice&);
@@ -55,12 +287,35 @@ private:
 	static void CreateSurface();
 	static vk::PhysicalDevice FindPhysicalDevice();
 	static sf::Uint32 FindQueueFamily(vk::QueueFlags queueFlags);
+	static vk::Format FindDepthFormat();
+	static void InitializeDevice();
 	static void CreateDevice();
-	static void CreateSwapchain();
-	static void CreateRenderPass();
+	static void CreateSwapchain(vk::SwapchainKHR oldSwapchain = nullptr);
+	static void CreateOffscreenImages();
+	static vk::RenderPass CreateRenderPass(const RenderPassDesc& desc = {});
+	static vk::RenderPass GetRenderPass(const RenderPassDesc& desc);
+	static void UpdateDamageArea();
+	static void CreateTransientTargets();
+	// Render targets' own attachments are not shared, so they are left out of the transient attachment stats
+	static VulkanImage CreateTransientImage(sf::Uint32 width, sf::Uint32 height, vk::Format format, vk::ImageUsageFlags usage, bool shared = true);
+	static void CreateSceneTargets();
+	static void DestroySceneTargets();
+	static void UpdateRenderExtent();
+	static void UpscaleSceneTarget();
+	static void BeginDynamicRendering(const RenderPassDesc& desc, vk::SubpassContents contents);
+	static void EndDynamicRendering();
+	static void TransitionPassAttachments(vk::Image target, vk::Image depth, vk::Image multisample, bool keep);
+	static void CreateCompositeLayout();
+	static void CreateCompositeShader();
 	static void CreateCommandPool();
+	static void CreateDescriptorPool();
 	static void CreateSynchronization();
+	static void DestroyThreadCommandPools();
+	static void InvalidateStateCache();
+	static void FlushThreadStats();
 
+	static void RetireSwapchain();
+	static void ReleaseRetiredResources(bool deviceIdle);
 	static void DestroySwapchain();
 	static void DestroyAll();
 
@@ -73,10 +328,7 @@ private:
 	static VulkanImage CreateImage(sf::Uint32 width, sf::Uint32 height, vk::Format format, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties);
 	static void DestroyImage(VulkanImage image);
 
-	static vk::ImageView CreateImageView(vk::Image image, vk::Format format);
-	static vk::Framebuffer CreateFramebuffer(vk::ImageView imageView, sf::Uint32 width, sf::Uint32 height);
+	static vk::ImageView CreateImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor);
+	static vk::Framebuffer CreateFramebuffer(vk::ImageView imageView, vk::ImageView depthView, vk::ImageView multisampleView, sf::Uint32 width, sf::Uint32 height);
 	static vk::CommandBuffer AllocateCommandBuffer();
-
-	static sf::Uint32 FindMemoryType(sf::Uint32 suitableTypes, vk::MemoryPropertyFlags properties);
-	static void ChangeImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
 };
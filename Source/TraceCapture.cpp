@@ -0,0 +1,298 @@
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#include "TraceCapture.hpp"
+#include "Profiler.hpp"
+
+// Main stream is written to the file at every Present so memory stays bounded
+static std::atomic<bool>	s_Capturing = {};
+static std::mutex			s_Mutex = {};
+static std::ofstream		s_File = {};
+static std::vector<sf::Uint8> s_Buffer = {};
+static sf::Uint64			s_StartTime = {};
+
+// Record being built, and the block of the secondary command buffer this thread records
+static thread_local std::vector<sf::Uint8>	t_Record = {};
+static thread_local std::vector<sf::Uint8>	t_SecondaryBuffer = {};
+static thread_local bool					t_InSecondary = {};
+static thread_local bool					t_Suspended = {};
+
+// The build only targets x86_64, values are written in native (little endian) order
+template<typename T>
+static void Write(const T& value)
+{
+	const sf::Uint8* bytes = reinterpret_cast<const sf::Uint8*>(&value);
+	t_Record.insert(t_Record.end(), bytes, bytes + sizeof(T));
+}
+
+static void WriteBytes(const void* data, size_t size)
+{
+	const sf::Uint8* bytes = static_cast<const sf::Uint8*>(data);
+	t_Record.insert(t_Record.end(), bytes, bytes + size);
+}
+
+template<typename Handle>
+static sf::Uint64 GetId(Handle handle)
+{
+	return (sf::Uint64)(typename Handle::CType)handle;
+}
+
+static void BeginRecord(TraceOp op)
+{
+	t_Record.clear();
+	Write(op);
+}
+
+static void CommitRecord()
+{
+	if (t_InSecondary)
+	{
+		t_SecondaryBuffer.insert(t_SecondaryBuffer.end(), t_Record.begin(), t_Record.end());
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	s_Buffer.insert(s_Buffer.end(), t_Record.begin(), t_Record.end());
+}
+
+static void FlushToFile()
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	s_File.write(reinterpret_cast<const char*>(s_Buffer.data()), s_Buffer.size());
+	s_Buffer.clear();
+}
+
+bool TraceCapture::Begin(const std::string& filePath)
+{
+	if (s_Capturing)
+		End();
+
+	s_File.open(filePath, std::ios::binary | std::ios::trunc);
+	if (!s_File)
+		return false;
+
+	vk::Extent2D extent = RenderingDevice::GetSwapchainExtent();
+
+	t_Record.clear();
+	Write(TRACE_MAGIC);
+	Write(TRACE_VERSION);
+	Write(extent.width);
+	Write(extent.height);
+	s_File.write(reinterpret_cast<const char*>(t_Record.data()), t_Record.size());
+
+	s_StartTime = Profiler::GetTime();
+	s_Capturing = true;
+	return true;
+}
+
+void TraceCapture::End()
+{
+	if (!s_Capturing)
+		return;
+
+	s_Capturing = false;
+	FlushToFile();
+	s_File.close();
+}
+
+bool TraceCapture::IsCapturing()
+{
+	return s_Capturing.load(std::memory_order_relaxed) && !t_Suspended;
+}
+
+void TraceCapture::Suspend()
+{
+	t_Suspended = true;
+}
+
+void TraceCapture::Resume()
+{
+	t_Suspended = false;
+}
+
+void TraceCapture::CreateShader(vk::Pipeline pipeline, const std::vector<sf::Uint32>& vsCode, const std::vector<sf::Uint32>& fsCode, DepthMode depthMode, vk::SampleCountFlagBits sampleCount)
+{
+	BeginRecord(TraceOp::CreateShader);
+	Write(GetId(pipeline));
+	Write((sf::Uint32)vsCode.size());
+	WriteBytes(vsCode.data(), vsCode.size() * sizeof(sf::Uint32));
+	Write((sf::Uint32)fsCode.size());
+	WriteBytes(fsCode.data(), fsCode.size() * sizeof(sf::Uint32));
+	Write((sf::Uint8)RenderingDevice::IsDepthBufferEnabled());
+	Write((sf::Uint8)depthMode);
+	Write((sf::Uint8)sampleCount);
+	CommitRecord();
+}
+
+void TraceCapture::DestroyShader(vk::Pipeline pipeline)
+{
+	BeginRecord(TraceOp::DestroyShader);
+	Write(GetId(pipeline));
+	CommitRecord();
+}
+
+void TraceCapture::CreateVertexBuffer(vk::Buffer buffer, const std::vector<sf::Vector3f>& vertices)
+{
+	BeginRecord(TraceOp::CreateVertexBuffer);
+	Write(GetId(buffer));
+	Write((sf::Uint32)vertices.size());
+	for (const sf::Vector3f& vertex : vertices)
+	{
+		Write(vertex.x);
+		Write(vertex.y);
+		Write(vertex.z);
+	}
+	CommitRecord();
+}
+
+void TraceCapture::DestroyVertexBuffer(vk::Buffer buffer)
+{
+	BeginRecord(TraceOp::DestroyVertexBuffer);
+	Write(GetId(buffer));
+	CommitRecord();
+}
+
+void TraceCapture::SetViewport(sf::Vector2f position, sf::Vector2f size)
+{
+	BeginRecord(TraceOp::SetViewport);
+	Write(position.x);
+	Write(position.y);
+	Write(size.x);
+	Write(size.y);
+	CommitRecord();
+}
+
+void TraceCapture::SetScissors(sf::Vector2i offset, sf::Vector2i extent)
+{
+	BeginRecord(TraceOp::SetScissors);
+	Write((sf::Int32)offset.x);
+	Write((sf::Int32)offset.y);
+	Write((sf::Int32)extent.x);
+	Write((sf::Int32)extent.y);
+	CommitRecord();
+}
+
+void TraceCapture::BindShader(vk::Pipeline pipeline)
+{
+	BeginRecord(TraceOp::BindShader);
+	Write(GetId(pipeline));
+	CommitRecord();
+}
+
+void TraceCapture::BindVertexBuffer(vk::Buffer buffer)
+{
+	BeginRecord(TraceOp::BindVertexBuffer);
+	Write(GetId(buffer));
+	CommitRecord();
+}
+
+void TraceCapture::BindDescriptorSet(vk::Pipeline pipeline, vk::DescriptorSet descriptorSet, sf::Uint32 setIndex)
+{
+	BeginRecord(TraceOp::BindDescriptorSet);
+	Write(GetId(pipeline));
+	Write(GetId(descriptorSet));
+	Write(setIndex);
+	CommitRecord();
+}
+
+void TraceCapture::PushConstants(vk::Pipeline pipeline, const void* data, sf::Uint32 size, sf::Uint32 offset)
+{
+	BeginRecord(TraceOp::PushConstants);
+	Write(GetId(pipeline));
+	Write(offset);
+	Write(size);
+	WriteBytes(data, size);
+	CommitRecord();
+}
+
+void TraceCapture::Draw(sf::Uint32 count, sf::Uint32 instanceCount, sf::Uint32 firstVertex, sf::Uint32 firstInstance)
+{
+	BeginRecord(TraceOp::Draw);
+	Write(count);
+	Write(instanceCount);
+	Write(firstVertex);
+	Write(firstInstance);
+	CommitRecord();
+}
+
+void TraceCapture::BeginFrame()
+{
+	BeginRecord(TraceOp::BeginFrame);
+	Write(Profiler::GetTime() - s_StartTime);
+	CommitRecord();
+}
+
+void TraceCapture::EndFrame()
+{
+	BeginRecord(TraceOp::EndFrame);
+	CommitRecord();
+}
+
+void TraceCapture::BeginRenderPass(const RenderPassDesc& desc, vk::SubpassContents contents)
+{
+	BeginRecord(TraceOp::BeginRenderPass);
+	Write((sf::Uint32)contents);
+	Write((sf::Uint32)desc.ColorLoadOp);
+	Write((sf::Uint32)desc.ColorStoreOp);
+	WriteBytes(desc.ClearColor.float32.data(), 4 * sizeof(float));
+	Write(desc.ClearDepth.depth);
+	CommitRecord();
+}
+
+void TraceCapture::EndRenderPass()
+{
+	BeginRecord(TraceOp::EndRenderPass);
+	CommitRecord();
+}
+
+void TraceCapture::Present()
+{
+	BeginRecord(TraceOp::Present);
+	Write(Profiler::GetTime() - s_StartTime);
+	CommitRecord();
+
+	FlushToFile();
+}
+
+void TraceCapture::SetRecordingThreadCount(sf::Uint32 threadCount)
+{
+	BeginRecord(TraceOp::SetRecordingThreadCount);
+	Write(threadCount);
+	CommitRecord();
+}
+
+void TraceCapture::BeginSecondaryCommandBuffer(sf::Uint32 threadIndex)
+{
+	t_SecondaryBuffer.clear();
+	t_InSecondary = true;
+
+	BeginRecord(TraceOp::BeginSecondaryCommandBuffer);
+	Write(threadIndex);
+	CommitRecord();
+}
+
+void TraceCapture::EndSecondaryCommandBuffer()
+{
+	// Began before the capture started
+	if (!t_InSecondary)
+		return;
+
+	BeginRecord(TraceOp::EndSecondaryCommandBuffer);
+	CommitRecord();
+
+	// Append the whole block at once so blocks of different threads never interleave
+	t_InSecondary = false;
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		s_Buffer.insert(s_Buffer.end(), t_SecondaryBuffer.begin(), t_SecondaryBuffer.end());
+	}
+	t_SecondaryBuffer.clear();
+}
+
+void TraceCapture::ExecuteSecondaryCommandBuffers()
+{
+	BeginRecord(TraceOp::ExecuteSecondaryCommandBuffers);
+	CommitRecord();
+}
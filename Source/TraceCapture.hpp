@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+static constexpr sf::Uint32 TRACE_MAGIC = 0x52545653; // "SVTR"
+static constexpr sf::Uint32 TRACE_VERSION = 3;
+
+// One byte opcode followed by its fixed payload, little endian, resources are identified by their Vulkan handle
+enum class TraceOp : sf::Uint8
+{
+	CreateShader,				// u64 id, u32 vsWords, u32[vsWords], u32 fsWords, u32[fsWords], u8 depthBuffer, u8 depthMode, u8 sampleCount
+	DestroyShader,				// u64 id
+	CreateVertexBuffer,			// u64 id, u32 vertexCount, f32[3 * vertexCount]
+	DestroyVertexBuffer,		// u64 id
+	SetViewport,				// f32 x, y, width, height
+	SetScissors,				// i32 x, y, width, height
+	BindShader,					// u64 id
+	BindVertexBuffer,			// u64 id
+	BindDescriptorSet,			// u64 shader, u64 set, u32 setIndex
+	PushConstants,				// u64 shader, u32 offset, u32 size, u8[size]
+	Draw,						// u32 count, instanceCount, firstVertex, firstInstance
+	BeginFrame,					// u64 time since capture start in ns
+	EndFrame,
+	BeginRenderPass,			// u32 subpass contents, u32 colorLoadOp, u32 colorStoreOp, f32 clearColor[4], f32 clearDepth
+	EndRenderPass,
+	Present,					// u64 time since capture start in ns
+	SetRecordingThreadCount,	// u32 threadCount
+	BeginSecondaryCommandBuffer,// u32 threadIndex
+	EndSecondaryCommandBuffer,
+	ExecuteSecondaryCommandBuffers
+};
+
+// Serializes every RenderingDevice call into a binary trace that TraceReplay drives headless.
+// Start the capture before creating resources, binds of resources created earlier cannot be replayed.
+// Calls recorded inside a secondary command buffer are kept per thread and appended as one block when it ends.
+class TraceCapture
+{
+public:
+	static bool Begin(const std::string& filePath);
+	static void End();
+
+	static bool IsCapturing();
+
+	// Calls of this thread in between are not captured, e.g. render target passes the replay knows nothing about
+	static void Suspend();
+	static void Resume();
+
+	static void CreateShader(vk::Pipeline pipeline, const std::vector<sf::Uint32>& vsCode, const std::vector<sf::Uint32>& fsCode, DepthMode depthMode, vk::SampleCountFlagBits sampleCount);
+	static void DestroyShader(vk::Pipeline pipeline);
+	static void CreateVertexBuffer(vk::Buffer buffer, const std::vector<sf::Vector3f>& vertices);
+	static void DestroyVertexBuffer(vk::Buffer buffer);
+
+	static void SetViewport(sf::Vector2f position, sf::Vector2f size);
+	static void SetScissors(sf::Vector2i offset, sf::Vector2i extent);
+	static void BindShader(vk::Pipeline pipeline);
+	static void BindVertexBuffer(vk::Buffer buffer);
+	static void BindDescriptorSet(vk::Pipeline pipeline, vk::DescriptorSet descriptorSet, sf::Uint32 setIndex);
+	static void PushConstants(vk::Pipeline pipeline, const void* data, sf::Uint32 size, sf::Uint32 offset);
+	static void Draw(sf::Uint32 count, sf::Uint32 instanceCount, sf::Uint32 firstVertex, sf::Uint32 firstInstance);
+
+	static void BeginFrame();
+	static void EndFrame();
+	static void BeginRenderPass(const RenderPassDesc& desc, vk::SubpassContents contents);
+	static void EndRenderPass();
+	static void Present();
+
+	static void SetRecordingThreadCount(sf::Uint32 threadCount);
+	static void BeginSecondaryCommandBuffer(sf::Uint32 threadIndex);
+	static void EndSecondaryCommandBuffer();
+	static void ExecuteSecondaryCommandBuffers();
+private:
+	TraceCapture();
+	TraceCapture(const TraceCapture&);
+};
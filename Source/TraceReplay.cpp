@@ -0,0 +1,504 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "TraceReplay.hpp"
+#include "TraceCapture.hpp"
+#include "Profiler.hpp"
+
+static constexpr size_t TRACE_HEADER_SIZE = 4 * sizeof(sf::Uint32);
+
+static std::vector<sf::Uint8> s_Trace = {};
+
+struct TraceReader
+{
+	size_t Offset = TRACE_HEADER_SIZE;
+	bool Failed = false;
+
+	bool AtEnd() const
+	{
+		return Offset >= s_Trace.size();
+	}
+
+	template<typename T>
+	T Read()
+	{
+		T value = {};
+		ReadBytes(&value, sizeof(T));
+		return value;
+	}
+
+	void ReadBytes(void* data, size_t size)
+	{
+		if (Failed || s_Trace.size() - Offset < size)
+		{
+			Failed = true;
+			return;
+		}
+
+		std::memcpy(data, s_Trace.data() + Offset, size);
+		Offset += size;
+	}
+};
+
+// Recording state is thread local, so secondary blocks run on a worker kept for their thread index for the whole run,
+// like the capturing application's recording threads
+class ReplayWorker
+{
+public:
+	ReplayWorker()
+	{
+		m_Thread = std::thread([this]() { Work(); });
+	}
+
+	~ReplayWorker()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_Wake.notify_one();
+		m_Thread.join();
+	}
+
+	// Blocks until the worker ran the job, the trace reader is shared so blocks replay one after another
+	void Run(const std::function<void()>& job)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Jobs.push_back(job);
+		m_Wake.notify_one();
+		m_Done.wait(lock, [this]() { return m_Jobs.empty() && !m_Busy; });
+	}
+private:
+	void Work()
+	{
+		PROFILE_THREAD("Replay worker");
+
+		while (true)
+		{
+			std::function<void()> job = {};
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [this]() { return m_Stop || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+					return;
+
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+				m_Busy = true;
+			}
+
+			job();
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Busy = false;
+			}
+			m_Done.notify_one();
+		}
+	}
+private:
+	std::mutex m_Mutex = {};
+	std::condition_variable m_Wake = {};
+	std::condition_variable m_Done = {};
+	std::deque<std::function<void()>> m_Jobs = {};
+	bool m_Busy = false;
+	bool m_Stop = false;
+	std::thread m_Thread = {};
+};
+
+struct ReplayState
+{
+	ReplayTiming Timing = ReplayTiming::Fast;
+	ReplayStats* Stats = nullptr;
+	std::string Error = {};
+
+	// Capture ids to the resources recreated by the replay
+	std::unordered_map<sf::Uint64, VulkanShader> Shaders = {};
+	std::unordered_map<sf::Uint64, VulkanBuffer> VertexBuffers = {};
+
+	std::unordered_map<sf::Uint32, std::unique_ptr<ReplayWorker>> Workers = {};
+
+	sf::Uint64 RunStart = 0;
+	sf::Uint64 LastPresent = 0;
+	sf::Uint64 FirstTimestamp = 0;
+	bool HasTimestamp = false;
+};
+
+static std::vector<sf::Uint32> ReadCode(TraceReader& reader)
+{
+	sf::Uint32 words = reader.Read<sf::Uint32>();
+	if (reader.Failed || words > (s_Trace.size() - reader.Offset) / sizeof(sf::Uint32))
+	{
+		reader.Failed = true;
+		return {};
+	}
+
+	std::vector<sf::Uint32> code(words);
+	reader.ReadBytes(code.data(), words * sizeof(sf::Uint32));
+	return code;
+}
+
+template<typename Resource>
+static Resource* FindResource(ReplayState& state, std::unordered_map<sf::Uint64, Resource>& resources, sf::Uint64 id)
+{
+	auto it = resources.find(id);
+	if (it != resources.end())
+		return &it->second;
+
+	state.Error = "trace uses a resource created before the capture started";
+	return nullptr;
+}
+
+static void WaitForTimestamp(ReplayState& state, sf::Uint64 timestamp)
+{
+	if (!state.HasTimestamp)
+	{
+		state.FirstTimestamp = timestamp;
+		state.HasTimestamp = true;
+	}
+
+	if (state.Timing != ReplayTiming::Original)
+		return;
+
+	sf::Uint64 target = state.RunStart + (timestamp - state.FirstTimestamp);
+	sf::Uint64 now = Profiler::GetTime();
+	if (target > now)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(target - now));
+}
+
+// Replays until the end of the trace, or until the EndSecondaryCommandBuffer closing the current block
+static bool ReplayOps(TraceReader& reader, ReplayState& state, bool inSecondary)
+{
+	while (!reader.AtEnd())
+	{
+		TraceOp op = reader.Read<TraceOp>();
+
+		switch (op)
+		{
+		case TraceOp::CreateShader:
+		{
+			sf::Uint64 id = reader.Read<sf::Uint64>();
+			std::vector<sf::Uint32> vsCode = ReadCode(reader);
+			std::vector<sf::Uint32> fsCode = ReadCode(reader);
+			bool depthBuffer = reader.Read<sf::Uint8>() != 0;
+			DepthMode depthMode = (DepthMode)reader.Read<sf::Uint8>();
+			vk::SampleCountFlagBits sampleCount = (vk::SampleCountFlagBits)reader.Read<sf::Uint8>();
+			if (reader.Failed)
+				break;
+
+			// The pipeline has to match the render pass layout it was captured with
+			if (depthBuffer != RenderingDevice::IsDepthBufferEnabled())
+				RenderingDevice::SetDepthBufferEnabled(depthBuffer);
+			if (sampleCount != RenderingDevice::GetSampleCount())
+				RenderingDevice::SetSampleCount(sampleCount);
+
+			state.Shaders[id] = RenderingDevice::CreateShader(vsCode, fsCode, depthMode);
+			break;
+		}
+		case TraceOp::DestroyShader:
+		{
+			sf::Uint64 id = reader.Read<sf::Uint64>();
+			VulkanShader* shader = FindResource(state, state.Shaders, id);
+			if (!shader)
+				return false;
+
+			RenderingDevice::DestroyShader(*shader);
+			state.Shaders.erase(id);
+			break;
+		}
+		case TraceOp::CreateVertexBuffer:
+		{
+			sf::Uint64 id = reader.Read<sf::Uint64>();
+			sf::Uint32 vertexCount = reader.Read<sf::Uint32>();
+			if (reader.Failed || vertexCount > (s_Trace.size() - reader.Offset) / sizeof(sf::Vector3f))
+			{
+				reader.Failed = true;
+				break;
+			}
+
+			std::vector<sf::Vector3f> vertices(vertexCount);
+			for (sf::Vector3f& vertex : vertices)
+			{
+				vertex.x = reader.Read<float>();
+				vertex.y = reader.Read<float>();
+				vertex.z = reader.Read<float>();
+			}
+			state.VertexBuffers[id] = RenderingDevice::CreateVertexBuffer(vertices);
+			break;
+		}
+		case TraceOp::DestroyVertexBuffer:
+		{
+			sf::Uint64 id = reader.Read<sf::Uint64>();
+			VulkanBuffer* vertexBuffer = FindResource(state, state.VertexBuffers, id);
+			if (!vertexBuffer)
+				return false;
+
+			RenderingDevice::DestroyVertexBuffer(*vertexBuffer);
+			state.VertexBuffers.erase(id);
+			break;
+		}
+		case TraceOp::SetViewport:
+		{
+			sf::Vector2f position = {};
+			sf::Vector2f size = {};
+			position.x = reader.Read<float>();
+			position.y = reader.Read<float>();
+			size.x = reader.Read<float>();
+			size.y = reader.Read<float>();
+			if (!reader.Failed)
+				RenderingDevice::SetViewport(position, size);
+			break;
+		}
+		case TraceOp::SetScissors:
+		{
+			sf::Vector2i offset = {};
+			sf::Vector2i extent = {};
+			offset.x = reader.Read<sf::Int32>();
+			offset.y = reader.Read<sf::Int32>();
+			extent.x = reader.Read<sf::Int32>();
+			extent.y = reader.Read<sf::Int32>();
+			if (!reader.Failed)
+				RenderingDevice::SetScissors(offset, extent);
+			break;
+		}
+		case TraceOp::BindShader:
+		{
+			VulkanShader* shader = FindResource(state, state.Shaders, reader.Read<sf::Uint64>());
+			if (!shader)
+				return false;
+
+			RenderingDevice::BindShader(*shader);
+			break;
+		}
+		case TraceOp::BindVertexBuffer:
+		{
+			VulkanBuffer* vertexBuffer = FindResource(state, state.VertexBuffers, reader.Read<sf::Uint64>());
+			if (!vertexBuffer)
+				return false;
+
+			RenderingDevice::BindVertexBuffer(*vertexBuffer);
+			break;
+		}
+		case TraceOp::BindDescriptorSet:
+		{
+			// The images and writes behind the set are not captured, drawing without them would not match the capture
+			state.Error = "trace binds descriptor sets, their contents cannot be replayed";
+			return false;
+		}
+		case TraceOp::PushConstants:
+		{
+			sf::Uint64 id = reader.Read<sf::Uint64>();
+			sf::Uint32 offset = reader.Read<sf::Uint32>();
+			sf::Uint32 size = reader.Read<sf::Uint32>();
+			if (reader.Failed || size > s_Trace.size() - reader.Offset)
+			{
+				reader.Failed = true;
+				break;
+			}
+
+			std::vector<sf::Uint8> data(size);
+			reader.ReadBytes(data.data(), size);
+
+			VulkanShader* shader = FindResource(state, state.Shaders, id);
+			if (!shader)
+				return false;
+
+			RenderingDevice::PushConstants(*shader, data.data(), size, offset);
+			break;
+		}
+		case TraceOp::Draw:
+		{
+			sf::Uint32 count = reader.Read<sf::Uint32>();
+			sf::Uint32 instanceCount = reader.Read<sf::Uint32>();
+			sf::Uint32 firstVertex = reader.Read<sf::Uint32>();
+			sf::Uint32 firstInstance = reader.Read<sf::Uint32>();
+			if (reader.Failed)
+				break;
+
+			RenderingDevice::Draw(count, instanceCount, firstVertex, firstInstance);
+			state.Stats->Draws++;
+			break;
+		}
+		case TraceOp::BeginFrame:
+		{
+			reader.Read<sf::Uint64>();
+			RenderingDevice::BeginFrame();
+			break;
+		}
+		case TraceOp::EndFrame:
+			RenderingDevice::EndFrame();
+			break;
+		case TraceOp::BeginRenderPass:
+		{
+			sf::Uint32 contents = reader.Read<sf::Uint32>();
+			RenderPassDesc desc = {};
+			desc.ColorLoadOp = (vk::AttachmentLoadOp)reader.Read<sf::Uint32>();
+			desc.ColorStoreOp = (vk::AttachmentStoreOp)reader.Read<sf::Uint32>();
+			for (float& channel : desc.ClearColor.float32)
+				channel = reader.Read<float>();
+			desc.ClearDepth.depth = reader.Read<float>();
+			if (!reader.Failed)
+				RenderingDevice::BeginRenderPass(desc, (vk::SubpassContents)contents);
+			break;
+		}
+		case TraceOp::EndRenderPass:
+			RenderingDevice::EndRenderPass();
+			break;
+		case TraceOp::Present:
+		{
+			sf::Uint64 timestamp = reader.Read<sf::Uint64>();
+			if (reader.Failed)
+				break;
+
+			WaitForTimestamp(state, timestamp);
+			RenderingDevice::Present();
+
+			sf::Uint64 now = Profiler::GetTime();
+			state.Stats->FrameTimes.push_back((now - state.LastPresent) / 1e6);
+			state.Stats->Frames++;
+			state.LastPresent = now;
+			break;
+		}
+		case TraceOp::SetRecordingThreadCount:
+		{
+			sf::Uint32 threadCount = reader.Read<sf::Uint32>();
+			if (!reader.Failed)
+				RenderingDevice::SetRecordingThreadCount(threadCount);
+			break;
+		}
+		case TraceOp::BeginSecondaryCommandBuffer:
+		{
+			sf::Uint32 threadIndex = reader.Read<sf::Uint32>();
+			if (reader.Failed || inSecondary)
+			{
+				reader.Failed = true;
+				break;
+			}
+
+			std::unique_ptr<ReplayWorker>& worker = state.Workers[threadIndex];
+			if (!worker)
+				worker = std::make_unique<ReplayWorker>();
+
+			bool result = false;
+			worker->Run([&]()
+			{
+				RenderingDevice::BeginSecondaryCommandBuffer(threadIndex);
+				result = ReplayOps(reader, state, true);
+			});
+
+			if (!result)
+				return false;
+			break;
+		}
+		case TraceOp::EndSecondaryCommandBuffer:
+		{
+			if (!inSecondary)
+			{
+				reader.Failed = true;
+				break;
+			}
+
+			RenderingDevice::EndSecondaryCommandBuffer();
+			return true;
+		}
+		case TraceOp::ExecuteSecondaryCommandBuffers:
+			RenderingDevice::ExecuteSecondaryCommandBuffers();
+			break;
+		default:
+			reader.Failed = true;
+			break;
+		}
+
+		if (reader.Failed)
+		{
+			state.Error = "trace is truncated or corrupt at offset " + std::to_string(reader.Offset);
+			return false;
+		}
+	}
+
+	if (inSecondary)
+	{
+		state.Error = "trace ends inside a secondary command buffer";
+		return false;
+	}
+
+	return true;
+}
+
+bool TraceReplay::Load(const std::string& filePath, sf::Vector2u& extent, std::string& error)
+{
+	PROFILE_FUNCTION();
+
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		error = "cannot open " + filePath;
+		return false;
+	}
+
+	s_Trace.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	sf::Uint32 header[4] = {};
+	if (s_Trace.size() < TRACE_HEADER_SIZE)
+	{
+		error = "not a trace file";
+		return false;
+	}
+
+	std::memcpy(header, s_Trace.data(), TRACE_HEADER_SIZE);
+	if (header[0] != TRACE_MAGIC)
+	{
+		error = "not a trace file";
+		return false;
+	}
+
+	if (header[1] != TRACE_VERSION)
+	{
+		error = "unsupported trace version " + std::to_string(header[1]);
+		return false;
+	}
+
+	extent = sf::Vector2u(header[2], header[3]);
+	return true;
+}
+
+void TraceReplay::Unload()
+{
+	s_Trace.clear();
+	s_Trace.shrink_to_fit();
+}
+
+bool TraceReplay::Run(ReplayTiming timing, ReplayStats& stats, std::string& error)
+{
+	PROFILE_FUNCTION();
+
+	ReplayState state = {};
+	state.Timing = timing;
+	state.Stats = &stats;
+	state.RunStart = Profiler::GetTime();
+	state.LastPresent = state.RunStart;
+
+	TraceReader reader = {};
+	bool result = ReplayOps(reader, state, false);
+	state.Workers.clear();
+
+	// Captures usually stop before the application destroys its resources
+	for (auto& [id, shader] : state.Shaders)
+		RenderingDevice::DestroyShader(shader);
+	for (auto& [id, vertexBuffer] : state.VertexBuffers)
+		RenderingDevice::DestroyVertexBuffer(vertexBuffer);
+
+	if (!result)
+		error = state.Error;
+
+	return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+enum class ReplayTiming
+{
+	Fast,		// Submit frames back to back
+	Original	// Wait until each Present's capture timestamp
+};
+
+struct ReplayStats
+{
+	sf::Uint64 Frames = 0;
+	sf::Uint64 Draws = 0;
+	std::vector<double> FrameTimes = {}; // Present to present in ms
+};
+
+// Drives RenderingDevice from a trace written by TraceCapture. The device has to be initialized with the
+// extent returned by Load. Resources are created by the replay and destroyed at the end of every Run.
+// Descriptor sets are not part of the trace, a run fails at the first bind of one.
+class TraceReplay
+{
+public:
+	static bool Load(const std::string& filePath, sf::Vector2u& extent, std::string& error);
+	static void Unload();
+
+	static bool Run(ReplayTiming timing, ReplayStats& stats, std::string& error);
+private:
+	TraceReplay();
+	TraceReplay(const TraceReplay&);
+};
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "VideoCapture.hpp"
+#include "FrameReadback.hpp"
+#include "FrameScheduler.hpp"
+#include "Profiler.hpp"
+
+// Frames waiting for their readback or for the encoder, keeps one readback buffer free for other requests
+static constexpr size_t MAX_QUEUED_FRAMES = 3;
+
+static std::atomic<bool>						s_Capturing = {};
+static VideoFormat								s_Format = {};
+static std::string								s_FilePath = {};
+static sf::Uint32								s_FramesPerSecond = {};
+static std::atomic<sf::Uint64>					s_FramesWritten = {};
+static std::atomic<sf::Uint64>					s_FramesDropped = {};
+static FrameCallbackId							s_FrameCallback = {};
+
+static std::thread								s_Encoder = {};
+static std::mutex								s_QueueMutex = {};
+static std::condition_variable					s_QueueCondition = {};
+static std::deque<std::future<ReadbackImage>>	s_Queue = {};
+static bool										s_Stop = {};
+
+// Encoder thread only
+static std::ofstream							s_File = {};
+static sf::Vector2u								s_FrameSize = {};
+static std::vector<sf::Uint8>					s_FrameBuffer = {};
+
+static bool WriteY4MFrame(const ReadbackImage& image)
+{
+	// Stream parameters are fixed by the first frame
+	if (s_FrameSize == sf::Vector2u())
+	{
+		s_FrameSize = image.Size;
+
+		char header[128] = {};
+		int length = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", image.Size.x, image.Size.y, s_FramesPerSecond);
+		s_File.write(header, length);
+	}
+
+	if (image.Size != s_FrameSize)
+		return false;
+
+	size_t lumaSize = (size_t)image.Size.x * image.Size.y;
+	size_t chromaSize = (size_t)((image.Size.x + 1) / 2) * ((image.Size.y + 1) / 2);
+	s_FrameBuffer.resize(lumaSize + chromaSize * 2);
+
+	sf::Uint8* y = s_FrameBuffer.data();
+	VideoCapture::ConvertRgbaToYuv420(image.Pixels.data(), image.Size.x, image.Size.y, y, y + lumaSize, y + lumaSize + chromaSize);
+
+	s_File.write("FRAME\n", 6);
+	s_File.write(reinterpret_cast<const char*>(s_FrameBuffer.data()), s_FrameBuffer.size());
+	return (bool)s_File;
+}
+
+static bool WritePpmFrame(const ReadbackImage& image, sf::Uint64 frameNumber)
+{
+	char suffix[32] = {};
+	std::snprintf(suffix, sizeof(suffix), "_%06llu.ppm", (unsigned long long)frameNumber);
+
+	std::ofstream file(s_FilePath + suffix, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	char header[64] = {};
+	int length = std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n", image.Size.x, image.Size.y);
+	file.write(header, length);
+
+	// Drop alpha
+	size_t pixelCount = (size_t)image.Size.x * image.Size.y;
+	s_FrameBuffer.resize(pixelCount * 3);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		s_FrameBuffer[i * 3 + 0] = image.Pixels[i * 4 + 0];
+		s_FrameBuffer[i * 3 + 1] = image.Pixels[i * 4 + 1];
+		s_FrameBuffer[i * 3 + 2] = image.Pixels[i * 4 + 2];
+	}
+
+	file.write(reinterpret_cast<const char*>(s_FrameBuffer.data()), s_FrameBuffer.size());
+	return (bool)file;
+}
+
+static void EncoderLoop()
+{
+	PROFILE_THREAD("Video Encoder");
+
+	while (true)
+	{
+		std::future<ReadbackImage> future = {};
+		{
+			std::unique_lock<std::mutex> lock(s_QueueMutex);
+			s_QueueCondition.wait(lock, []() { return s_Stop || !s_Queue.empty(); });
+			if (s_Queue.empty())
+				break;
+
+			future = std::move(s_Queue.front());
+		}
+
+		// Frames resolve in order, MAX_FRAMES_IN_FLIGHT frames after they were requested
+		ReadbackImage image = future.get();
+		{
+			PROFILE_SCOPE("EncodeFrame");
+
+			bool written = false;
+			if (!image.Pixels.empty())
+			{
+				if (s_Format == VideoFormat::Y4M)
+					written = WriteY4MFrame(image);
+				else
+					written = WritePpmFrame(image, s_FramesWritten);
+			}
+
+			if (written)
+				s_FramesWritten++;
+			else
+				s_FramesDropped++;
+		}
+
+		// Popped only now so the queue length bounds the frames held in memory
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
+		s_Queue.pop_front();
+	}
+
+	s_File.close();
+}
+
+bool VideoCapture::Begin(const std::string& filePath, VideoFormat format, sf::Uint32 framesPerSecond)
+{
+	if (s_Capturing)
+		End();
+
+	if (format == VideoFormat::Y4M)
+	{
+		s_File.open(filePath, std::ios::binary | std::ios::trunc);
+		if (!s_File)
+			return false;
+	}
+
+	s_Format = format;
+	s_FilePath = filePath;
+	s_FramesPerSecond = framesPerSecond;
+	s_FramesWritten = 0;
+	s_FramesDropped = 0;
+	s_FrameSize = {};
+	s_Stop = false;
+
+	s_Encoder = std::thread(EncoderLoop);
+	s_Capturing = true;
+	s_FrameCallback = RenderingDevice::AddFrameEndCallback(CaptureFrame);
+
+	// A fixed frame rate stream needs a frame every iteration, on-demand rendering would shorten it
+	FrameScheduler::BeginAnimation();
+	return true;
+}
+
+void VideoCapture::End()
+{
+	if (!s_Capturing)
+		return;
+
+	PROFILE_FUNCTION();
+
+	s_Capturing = false;
+	RenderingDevice::RemoveFrameEndCallback(s_FrameCallback);
+	FrameScheduler::EndAnimation();
+
+	// Every queued frame either has its copy recorded or was dropped, resolve them without rendering more frames
+	FrameReadback::Flush();
+
+	{
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
+		s_Stop = true;
+	}
+	s_QueueCondition.notify_one();
+	s_Encoder.join();
+}
+
+bool VideoCapture::IsCapturing()
+{
+	return s_Capturing.load(std::memory_order_relaxed);
+}
+
+VideoCaptureStats VideoCapture::GetStats()
+{
+	VideoCaptureStats stats = {};
+	stats.FramesWritten = s_FramesWritten;
+	stats.FramesDropped = s_FramesDropped;
+	return stats;
+}
+
+void VideoCapture::CaptureFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(s_QueueMutex);
+		if (s_Queue.size() >= MAX_QUEUED_FRAMES)
+		{
+			s_FramesDropped++;
+			return;
+		}
+
+		s_Queue.push_back(FrameReadback::RequestReadback({}, true));
+	}
+	s_QueueCondition.notify_one();
+}
+
+// BT.601 limited range, chroma is the rounded average of each 2x2 block (averaged vertically, then horizontally)
+static inline sf::Uint8 AverageRound(sf::Uint32 a, sf::Uint32 b)
+{
+	return (sf::Uint8)((a + b + 1) >> 1);
+}
+
+static inline sf::Uint8 LumaFromRgb(sf::Int32 r, sf::Int32 g, sf::Int32 b)
+{
+	return (sf::Uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline sf::Uint8 ChromaUFromRgb(sf::Int32 r, sf::Int32 g, sf::Int32 b)
+{
+	return (sf::Uint8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline sf::Uint8 ChromaVFromRgb(sf::Int32 r, sf::Int32 g, sf::Int32 b)
+{
+	return (sf::Uint8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+// Each 32 bit lane holds one RGBA pixel, channels are widened in place so 16 bit multiplies stay exact
+static inline void SplitChannels(__m128i pixels, __m128i& r, __m128i& g, __m128i& b)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	r = _mm_and_si128(pixels, mask);
+	g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+	b = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+}
+
+static inline __m128i WeightedSum(__m128i r, __m128i g, __m128i b, sf::Int32 wr, sf::Int32 wg, sf::Int32 wb)
+{
+	__m128i sum = _mm_mullo_epi16(r, _mm_set1_epi32(wr & 0xFFFF));
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(g, _mm_set1_epi32(wg & 0xFFFF)));
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi32(wb & 0xFFFF)));
+	return _mm_add_epi16(sum, _mm_set1_epi32(128));
+}
+
+static inline __m128i Luma4(__m128i pixels)
+{
+	__m128i r, g, b;
+	SplitChannels(pixels, r, g, b);
+
+	// Unsigned, the sum stays below 2^16
+	__m128i sum = WeightedSum(r, g, b, 66, 129, 25);
+	return _mm_add_epi32(_mm_srli_epi16(sum, 8), _mm_set1_epi32(16));
+}
+
+static inline __m128i Chroma4(__m128i r, __m128i g, __m128i b, sf::Int32 wr, sf::Int32 wg, sf::Int32 wb)
+{
+	// Signed, the sum stays within +-2^15
+	__m128i sum = WeightedSum(r, g, b, wr, wg, wb);
+	sum = _mm_and_si128(_mm_srai_epi16(sum, 8), _mm_set1_epi32(0xFFFF));
+	return _mm_and_si128(_mm_add_epi16(sum, _mm_set1_epi32(128)), _mm_set1_epi32(0xFF));
+}
+
+static inline sf::Uint32 PackLow4(__m128i lanes)
+{
+	__m128i packed = _mm_packs_epi32(lanes, lanes);
+	return (sf::Uint32)_mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+}
+#endif
+
+void VideoCapture::ConvertRgbaToYuv420(const sf::Uint8* rgba, sf::Uint32 width, sf::Uint32 height, sf::Uint8* y, sf::Uint8* u, sf::Uint8* v)
+{
+	PROFILE_FUNCTION();
+
+	size_t stride = (size_t)width * 4;
+
+	for (sf::Uint32 row = 0; row < height; row++)
+	{
+		const sf::Uint8* source = rgba + row * stride;
+		sf::Uint8* destination = y + (size_t)row * width;
+		sf::Uint32 x = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+		for (; x + 4 <= width; x += 4)
+		{
+			sf::Uint32 luma = PackLow4(Luma4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 4))));
+			std::memcpy(destination + x, &luma, 4);
+		}
+#endif
+
+		for (; x < width; x++)
+			destination[x] = LumaFromRgb(source[x * 4 + 0], source[x * 4 + 1], source[x * 4 + 2]);
+	}
+
+	sf::Uint32 chromaWidth = (width + 1) / 2;
+	sf::Uint32 chromaHeight = (height + 1) / 2;
+
+	for (sf::Uint32 row = 0; row < chromaHeight; row++)
+	{
+		// Odd sizes repeat the last row / column
+		const sf::Uint8* top = rgba + (size_t)(row * 2) * stride;
+		const sf::Uint8* bottom = rgba + (size_t)std::min(row * 2 + 1, height - 1) * stride;
+		sf::Uint8* destinationU = u + (size_t)row * chromaWidth;
+		sf::Uint8* destinationV = v + (size_t)row * chromaWidth;
+		sf::Uint32 x = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+		// 4 pixels give 2 chroma samples, in lanes 0 and 2 after averaging neighbours
+		for (; x * 2 + 8 <= width; x += 4)
+		{
+			__m128i blocks[2] = {};
+			for (sf::Uint32 half = 0; half < 2; half++)
+			{
+				size_t offset = (size_t)(x * 2 + half * 4) * 4;
+				__m128i vertical = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + offset)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + offset)));
+				__m128i horizontal = _mm_avg_epu8(vertical, _mm_srli_si128(vertical, 4));
+				blocks[half] = _mm_shuffle_epi32(horizontal, _MM_SHUFFLE(2, 0, 2, 0));
+			}
+
+			__m128i r, g, b;
+			SplitChannels(_mm_unpacklo_epi64(blocks[0], blocks[1]), r, g, b);
+
+			sf::Uint32 chromaU = PackLow4(Chroma4(r, g, b, -38, -74, 112));
+			sf::Uint32 chromaV = PackLow4(Chroma4(r, g, b, 112, -94, -18));
+			std::memcpy(destinationU + x, &chromaU, 4);
+			std::memcpy(destinationV + x, &chromaV, 4);
+		}
+#endif
+
+		for (; x < chromaWidth; x++)
+		{
+			sf::Uint32 left = x * 2;
+			sf::Uint32 right = std::min(left + 1, width - 1);
+
+			sf::Int32 channels[3] = {};
+			for (sf::Uint32 channel = 0; channel < 3; channel++)
+			{
+				sf::Uint8 leftAverage = AverageRound(top[left * 4 + channel], bottom[left * 4 + channel]);
+				sf::Uint8 rightAverage = AverageRound(top[right * 4 + channel], bottom[right * 4 + channel]);
+				channels[channel] = AverageRound(leftAverage, rightAverage);
+			}
+
+			destinationU[x] = ChromaUFromRgb(channels[0], channels[1], channels[2]);
+			destinationV[x] = ChromaVFromRgb(channels[0], channels[1], channels[2]);
+		}
+	}
+}
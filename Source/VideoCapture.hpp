@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RenderingDevice.hpp"
+
+enum class VideoFormat
+{
+	Y4M,			// Single file, YUV 4:2:0 (BT.601, limited range)
+	PpmSequence		// One binary PPM per frame, path_000000.ppm, path_000001.ppm, ...
+};
+
+struct VideoCaptureStats
+{
+	sf::Uint64 FramesWritten = 0;
+	sf::Uint64 FramesDropped = 0;
+};
+
+// Streams every rendered swapchain frame to disk through FrameReadback. Conversion & writing happen on an
+// encoder thread; when the readback ring or the encoder queue is full the frame is dropped, Present never waits.
+// Frames whose size differs from the first one (after a resize) are dropped as well.
+// End before RenderingDevice::Terminate, the last frames are flushed through the device.
+class VideoCapture
+{
+public:
+	static bool Begin(const std::string& filePath, VideoFormat format, sf::Uint32 framesPerSecond = 60);
+	static void End();
+
+	static bool IsCapturing();
+	static VideoCaptureStats GetStats();
+
+	// Y plane of width * height, U and V planes of ((width + 1) / 2) * ((height + 1) / 2)
+	static void ConvertRgbaToYuv420(const sf::Uint8* rgba, sf::Uint32 width, sf::Uint32 height, sf::Uint8* y, sf::Uint8* u, sf::Uint8* v);
+private:
+	VideoCapture();
+	VideoCapture(const VideoCapture&);
+
+	// Frame end callback, while capturing
+	static void CaptureFrame();
+};
@@ -0,0 +1,234 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "Json.hpp"
+
+struct JsonReader
+{
+	const char* Current = {};
+	const char* End = {};
+	std::string Error = {};
+
+	void SkipWhitespace()
+	{
+		while (Current < End && (*Current == ' ' || *Current == '\t' || *Current == '\n' || *Current == '\r'))
+			Current++;
+	}
+
+	bool Fail(const char* message)
+	{
+		if (Error.empty())
+			Error = message;
+		return false;
+	}
+
+	bool Expect(const char* literal)
+	{
+		size_t length = std::strlen(literal);
+		if ((size_t)(End - Current) < length || std::strncmp(Current, literal, length) != 0)
+			return Fail("Unexpected token");
+
+		Current += length;
+		return true;
+	}
+
+	bool ReadString(std::string& string)
+	{
+		if (Current >= End || *Current != '"')
+			return Fail("Expected string");
+
+		Current++;
+		while (Current < End && *Current != '"')
+		{
+			char c = *Current++;
+			if (c != '\\')
+			{
+				string += c;
+				continue;
+			}
+
+			if (Current >= End)
+				return Fail("Unterminated escape");
+
+			char escape = *Current++;
+			switch (escape)
+			{
+				case 'n': string += '\n'; break;
+				case 't': string += '\t'; break;
+				case 'r': string += '\r'; break;
+				case 'b': string += '\b'; break;
+				case 'f': string += '\f'; break;
+				case 'u':
+				{
+					if (End - Current < 4)
+						return Fail("Invalid unicode escape");
+
+					unsigned long code = std::strtoul(std::string(Current, 4).c_str(), nullptr, 16);
+					string += code < 0x80 ? (char)code : '?';
+					Current += 4;
+					break;
+				}
+				default: string += escape; break;
+			}
+		}
+
+		if (Current >= End)
+			return Fail("Unterminated string");
+
+		Current++;
+		return true;
+	}
+
+	bool ReadValue(JsonValue& value)
+	{
+		SkipWhitespace();
+		if (Current >= End)
+			return Fail("Unexpected end of input");
+
+		switch (*Current)
+		{
+			case '{':
+			{
+				value.Type = JsonType::Object;
+				Current++;
+				SkipWhitespace();
+				if (Current < End && *Current == '}')
+				{
+					Current++;
+					return true;
+				}
+
+				while (true)
+				{
+					std::pair<std::string, JsonValue> member = {};
+					SkipWhitespace();
+					if (!ReadString(member.first))
+						return false;
+
+					SkipWhitespace();
+					if (!Expect(":") || !ReadValue(member.second))
+						return false;
+
+					value.Object.push_back(std::move(member));
+
+					SkipWhitespace();
+					if (Current < End && *Current == ',')
+					{
+						Current++;
+						continue;
+					}
+
+					return Expect("}");
+				}
+			}
+			case '[':
+			{
+				value.Type = JsonType::Array;
+				Current++;
+				SkipWhitespace();
+				if (Current < End && *Current == ']')
+				{
+					Current++;
+					return true;
+				}
+
+				while (true)
+				{
+					value.Array.emplace_back();
+					if (!ReadValue(value.Array.back()))
+						return false;
+
+					SkipWhitespace();
+					if (Current < End && *Current == ',')
+					{
+						Current++;
+						continue;
+					}
+
+					return Expect("]");
+				}
+			}
+			case '"':
+				value.Type = JsonType::String;
+				return ReadString(value.String);
+			case 't':
+				value.Type = JsonType::Bool;
+				value.Bool = true;
+				return Expect("true");
+			case 'f':
+				value.Type = JsonType::Bool;
+				value.Bool = false;
+				return Expect("false");
+			case 'n':
+				value.Type = JsonType::Null;
+				return Expect("null");
+			default:
+			{
+				// strtod needs a terminated string, numbers are short so copy them out
+				const char* begin = Current;
+				while (Current < End && std::strchr("+-0123456789.eE", *Current))
+					Current++;
+
+				if (begin == Current)
+					return Fail("Unexpected character");
+
+				std::string number(begin, Current);
+				char* parsedEnd = nullptr;
+				value.Type = JsonType::Number;
+				value.Number = std::strtod(number.c_str(), &parsedEnd);
+				if (parsedEnd != number.c_str() + number.size())
+					return Fail("Invalid number");
+
+				return true;
+			}
+		}
+	}
+};
+
+const JsonValue* JsonValue::Find(const std::string& key) const
+{
+	for (const std::pair<std::string, JsonValue>& member : Object)
+	{
+		if (member.first == key)
+			return &member.second;
+	}
+
+	return nullptr;
+}
+
+bool Json::Parse(const std::string& text, JsonValue& value, std::string& error)
+{
+	JsonReader reader = {};
+	reader.Current = text.data();
+	reader.End = text.data() + text.size();
+
+	value = {};
+	bool success = reader.ReadValue(value);
+	if (success)
+	{
+		reader.SkipWhitespace();
+		if (reader.Current != reader.End)
+			success = reader.Fail("Trailing characters");
+	}
+
+	if (!success)
+		error = reader.Error + " at offset " + std::to_string(reader.Current - text.data());
+
+	return success;
+}
+
+bool Json::ParseFile(const std::string& filePath, JsonValue& value, std::string& error)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+	{
+		error = "Failed to open " + filePath;
+		return false;
+	}
+
+	std::stringstream stream = {};
+	stream << file.rdbuf();
+	return Parse(stream.str(), value, error);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class JsonType
+{
+	Null,
+	Bool,
+	Number,
+	String,
+	Array,
+	Object
+};
+
+struct JsonValue
+{
+	JsonType Type = JsonType::Null;
+	bool Bool = false;
+	double Number = 0.0;
+	std::string String = {};
+	std::vector<JsonValue> Array = {};
+	std::vector<std::pair<std::string, JsonValue>> Object = {};
+
+	// Member of an object, nullptr when missing or not an object
+	const JsonValue* Find(const std::string& key) const;
+};
+
+// Minimal reader for the benchmark result files, \uXXXX escapes outside ASCII are replaced by '?'
+class Json
+{
+public:
+	static bool Parse(const std::string& text, JsonValue& value, std::string& error);
+	static bool ParseFile(const std::string& filePath, JsonValue& value, std::string& error);
+private:
+	Json();
+	Json(const Json&);
+};
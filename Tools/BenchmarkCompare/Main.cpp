@@ -0,0 +1,149 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "Json.hpp"
+#include "Statistics.hpp"
+
+static constexpr sf::Uint32 BOOTSTRAP_RESAMPLES = 2000;
+static constexpr sf::Uint32 BOOTSTRAP_SEED = 1234;
+static constexpr double BOOTSTRAP_CONFIDENCE = 0.95;
+
+struct ScenarioSamples
+{
+	std::string Unit = {};
+	std::vector<double> Samples = {};
+};
+
+static void PrintUsage()
+{
+	std::cout << "Usage: BenchmarkCompare <baseline.json> <current.json> [options]\n"
+		<< "  --threshold <fraction>  Median slowdown that counts as a regression (default 0.05)\n"
+		<< "  --alpha <p>             Significance level of the Mann-Whitney test (default 0.01)\n"
+		<< "Exit code is 1 when a scenario regressed significantly, 2 on invalid input.\n";
+}
+
+static bool LoadResults(const std::string& filePath, std::map<std::string, ScenarioSamples>& scenarios)
+{
+	JsonValue root = {};
+	std::string error = {};
+	if (!Json::ParseFile(filePath, root, error))
+	{
+		std::cerr << filePath << ": " << error << "\n";
+		return false;
+	}
+
+	const JsonValue* results = root.Find("results");
+	if (!results || results->Type != JsonType::Array)
+	{
+		std::cerr << filePath << ": missing \"results\" array\n";
+		return false;
+	}
+
+	for (const JsonValue& result : results->Array)
+	{
+		const JsonValue* name = result.Find("name");
+		const JsonValue* unit = result.Find("unit");
+		const JsonValue* samples = result.Find("samples");
+		if (!name || name->Type != JsonType::String || !samples || samples->Type != JsonType::Array)
+		{
+			std::cerr << filePath << ": result without name or samples\n";
+			return false;
+		}
+
+		ScenarioSamples& scenario = scenarios[name->String];
+		scenario.Unit = unit && unit->Type == JsonType::String ? unit->String : "ms";
+		for (const JsonValue& sample : samples->Array)
+		{
+			if (sample.Type == JsonType::Number)
+				scenario.Samples.push_back(sample.Number);
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> paths = {};
+	double threshold = 0.05;
+	double alpha = 0.01;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = std::strtod(argv[++i], nullptr);
+		else if (std::strcmp(argv[i], "--alpha") == 0 && i + 1 < argc)
+			alpha = std::strtod(argv[++i], nullptr);
+		else if (argv[i][0] != '-')
+			paths.push_back(argv[i]);
+		else
+		{
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if (paths.size() != 2)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	std::map<std::string, ScenarioSamples> baseline = {};
+	std::map<std::string, ScenarioSamples> current = {};
+	if (!LoadResults(paths[0], baseline) || !LoadResults(paths[1], current))
+		return 2;
+
+	sf::Uint32 regressions = 0;
+
+	std::printf("%-32s %12s %12s %9s %21s %10s  %s\n", "Scenario", "Base p50", "New p50", "Change", "95% CI", "p-value", "Result");
+
+	// All result units are times, lower is better
+	for (const auto& [name, base] : baseline)
+	{
+		auto it = current.find(name);
+		if (it == current.end())
+		{
+			std::printf("%-32s %12s %12s %9s %21s %10s  %s\n", name.c_str(), "", "", "", "", "", "missing");
+			continue;
+		}
+
+		const ScenarioSamples& next = it->second;
+
+		double baseMedian = Statistics::Median(base.Samples);
+		double nextMedian = Statistics::Median(next.Samples);
+		double change = baseMedian != 0.0 ? nextMedian / baseMedian - 1.0 : 0.0;
+		double pValue = Statistics::MannWhitneyPValue(base.Samples, next.Samples);
+		ConfidenceInterval interval = Statistics::BootstrapMedianChange(base.Samples, next.Samples, BOOTSTRAP_RESAMPLES, BOOTSTRAP_CONFIDENCE, BOOTSTRAP_SEED);
+
+		// Significant by rank test, beyond the threshold, and the whole interval on the same side
+		const char* verdict = "unchanged";
+		if (pValue < alpha && change > threshold && interval.Lower > 0.0)
+		{
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if (pValue < alpha && change < -threshold && interval.Upper < 0.0)
+		{
+			verdict = "improved";
+		}
+
+		char intervalText[32] = {};
+		std::snprintf(intervalText, sizeof(intervalText), "[%+.1f%%, %+.1f%%]", interval.Lower * 100.0, interval.Upper * 100.0);
+
+		std::printf("%-32s %9.3f %-2s %9.3f %-2s %+8.1f%% %21s %10.2g  %s\n", name.c_str(), baseMedian, base.Unit.c_str(), nextMedian, next.Unit.c_str(), change * 100.0, intervalText, pValue, verdict);
+	}
+
+	for (const auto& [name, next] : current)
+	{
+		if (baseline.find(name) == baseline.end())
+			std::printf("%-32s %12s %12s %9s %21s %10s  %s\n", name.c_str(), "", "", "", "", "", "new");
+	}
+
+	std::printf("\n%u regression(s), threshold %.1f%%, alpha %g\n", regressions, threshold * 100.0, alpha);
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "Statistics.hpp"
+
+struct RankedSample
+{
+	double Value = 0.0;
+	bool First = false;
+};
+
+double Statistics::MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b)
+{
+	if (a.empty() || b.empty())
+		return 1.0;
+
+	std::vector<RankedSample> samples = {};
+	for (double value : a)
+		samples.push_back({ value, true });
+	for (double value : b)
+		samples.push_back({ value, false });
+
+	std::sort(samples.begin(), samples.end(), [](const RankedSample& x, const RankedSample& y) { return x.Value < y.Value; });
+
+	// Ties share the average of their ranks
+	double n1 = (double)a.size();
+	double n2 = (double)b.size();
+	double n = n1 + n2;
+	double rankSumA = 0.0;
+	double tieCorrection = 0.0;
+
+	for (size_t i = 0; i < samples.size();)
+	{
+		size_t j = i;
+		while (j < samples.size() && samples[j].Value == samples[i].Value)
+			j++;
+
+		double rank = (i + 1 + j) / 2.0;
+		for (size_t k = i; k < j; k++)
+		{
+			if (samples[k].First)
+				rankSumA += rank;
+		}
+
+		double ties = (double)(j - i);
+		tieCorrection += ties * ties * ties - ties;
+		i = j;
+	}
+
+	double u = rankSumA - n1 * (n1 + 1.0) / 2.0;
+	double mean = n1 * n2 / 2.0;
+	double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+	if (variance <= 0.0)
+		return 1.0;
+
+	double difference = std::abs(u - mean) - 0.5;
+	double z = std::max(difference, 0.0) / std::sqrt(variance);
+
+	return std::erfc(z / std::sqrt(2.0));
+}
+
+ConfidenceInterval Statistics::BootstrapMedianChange(const std::vector<double>& a, const std::vector<double>& b, sf::Uint32 resamples, double confidence, sf::Uint32 seed)
+{
+	ConfidenceInterval interval = {};
+	if (a.empty() || b.empty() || resamples == 0)
+		return interval;
+
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<size_t> pickA(0, a.size() - 1);
+	std::uniform_int_distribution<size_t> pickB(0, b.size() - 1);
+
+	std::vector<double> resampleA(a.size());
+	std::vector<double> resampleB(b.size());
+	std::vector<double> changes = {};
+
+	for (sf::Uint32 i = 0; i < resamples; i++)
+	{
+		for (double& value : resampleA)
+			value = a[pickA(random)];
+		for (double& value : resampleB)
+			value = b[pickB(random)];
+
+		double medianA = Median(resampleA);
+		if (medianA != 0.0)
+			changes.push_back(Median(resampleB) / medianA - 1.0);
+	}
+
+	if (changes.empty())
+		return interval;
+
+	std::sort(changes.begin(), changes.end());
+
+	double tail = (1.0 - confidence) / 2.0;
+	interval.Lower = changes[(size_t)(tail * (changes.size() - 1))];
+	interval.Upper = changes[(size_t)((1.0 - tail) * (changes.size() - 1))];
+	return interval;
+}
+
+double Statistics::Median(std::vector<double> samples)
+{
+	if (samples.empty())
+		return 0.0;
+
+	size_t middle = samples.size() / 2;
+	std::nth_element(samples.begin(), samples.begin() + middle, samples.end());
+	if (samples.size() % 2 == 1)
+		return samples[middle];
+
+	double upper = samples[middle];
+	double lower = *std::max_element(samples.begin(), samples.begin() + middle);
+	return (lower + upper) / 2.0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include <SFML/Config.hpp>
+
+struct ConfidenceInterval
+{
+	double Lower = 0.0;
+	double Upper = 0.0;
+};
+
+class Statistics
+{
+public:
+	// Two-sided p-value of the Mann-Whitney U test, normal approximation with tie & continuity correction
+	static double MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b);
+
+	// Percentile bootstrap of median(b) / median(a) - 1
+	static ConfidenceInterval BootstrapMedianChange(const std::vector<double>& a, const std::vector<double>& b, sf::Uint32 resamples, double confidence, sf::Uint32 seed);
+
+	static double Median(std::vector<double> samples);
+private:
+	Statistics();
+	Statistics(const Statistics&);
+};
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+#include "RenderingDevice.hpp"
+#include "TraceReplay.hpp"
+
+static void PrintUsage()
+{
+	std::cout << "Usage: TraceReplay <trace> [options]\n"
+		<< "  --timing <fast|original>  Submit back to back, or keep the captured frame pacing (default fast)\n"
+		<< "  --loops <n>               Replay the trace n times (default 1)\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string tracePath = {};
+	ReplayTiming timing = ReplayTiming::Fast;
+	sf::Uint32 loops = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(argv[i], "--timing") == 0 && hasValue)
+		{
+			const char* value = argv[++i];
+			if (std::strcmp(value, "fast") == 0)
+				timing = ReplayTiming::Fast;
+			else if (std::strcmp(value, "original") == 0)
+				timing = ReplayTiming::Original;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--loops") == 0 && hasValue)
+			loops = (sf::Uint32)std::strtoul(argv[++i], nullptr, 10);
+		else if (argv[i][0] != '-' && tracePath.empty())
+			tracePath = argv[i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (tracePath.empty() || loops == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	sf::Vector2u extent = {};
+	std::string error = {};
+	if (!TraceReplay::Load(tracePath, extent, error))
+	{
+		std::cerr << tracePath << ": " << error << "\n";
+		return 1;
+	}
+
+	if (!RenderingDevice::InitializeHeadless(extent))
+		return 1;
+
+	ReplayStats stats = {};
+	bool result = true;
+	for (sf::Uint32 i = 0; i < loops && result; i++)
+		result = TraceReplay::Run(timing, stats, error);
+
+	RenderingDevice::Terminate();
+	TraceReplay::Unload();
+
+	if (!result)
+	{
+		std::cerr << tracePath << ": " << error << "\n";
+		return 1;
+	}
+
+	std::printf("%llu frames, %llu draws at %ux%u\n", (unsigned long long)stats.Frames, (unsigned long long)stats.Draws, extent.x, extent.y);
+
+	if (!stats.FrameTimes.empty())
+	{
+		std::vector<double> frameTimes = stats.FrameTimes;
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		double mean = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / frameTimes.size();
+		double median = frameTimes[(frameTimes.size() - 1) / 2];
+		double p99 = frameTimes[(size_t)(0.99 * (frameTimes.size() - 1))];
+
+		std::printf("Frame time: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, min %.3f ms, max %.3f ms\n", mean, median, p99, frameTimes.front(), frameTimes.back());
+	}
+
+	return 0;
+}